@@ -1,8 +1,24 @@
 #include <iostream>
+#ifdef HAVE_LIMESUITE
 #include <LimeSuite.h>
+#endif
 #include <vector>
 #include <cmath>
 #include <complex>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "../sharedMemoryVisuals/duplexEngine.h"
+#include "../sharedMemoryVisuals/loopbackDevice.h"
+#include "../sharedMemoryVisuals/matchedFilter.h"
+#include "../sharedMemoryVisuals/multitoneProbe.h"
+#include "../sharedMemoryVisuals/threadAffinity.h"
+#include "../sharedMemoryVisuals/waveform.h"
+#ifdef HAVE_LIMESUITE
+#include "../sharedMemoryVisuals/limeRxSource.h"
+#include "../sharedMemoryVisuals/limeTxSink.h"
+#endif
 
 
 // 100 kHz sine wave // baseband frequency // message content frequency
@@ -15,6 +31,7 @@ const double sampling_rate = 2e6;
 const short channel = 0;
 
 
+#ifdef HAVE_LIMESUITE
 int configure(lms_device_t* device) {
     // Set center frequency (e.g., 2.4 GHz)
     if (LMS_SetLOFrequency(device, LMS_CH_TX, 0, carrier_frequency) != 0) {
@@ -52,85 +69,210 @@ int configure(lms_device_t* device) {
 
     return 0;
 }
+#endif
 
-int transmit(lms_device_t* device) {
+// probe bursts are 1024 samples of the baseband tone
+const size_t burst_samples = 1024;
 
-    // generate sine wave
-    const int no_of_samples = 1024;
-    // samples to transmit
-    std::vector<std::complex<float>> tx_samples(no_of_samples);
-    for (int i=0; i < no_of_samples; ++i) {
-        double time = i / sampling_rate;
-        tx_samples[i] = std::complex<float>(std::sin(2 * M_PI * baseband_frequency * time), 0.0f);
-    }
+// TX and RX run together: a burst every 10 ms, queued 5 ms ahead on the RX
+// timestamp, and searched for in the 2 ms of RX that follow it
+DuplexConfig duplex_config() {
+    DuplexConfig config;
+    config.sampleRate = sampling_rate;
+    config.periodSamples = uint32_t(0.010 * sampling_rate);
+    config.leadSamples = uint32_t(0.005 * sampling_rate);
+    config.windowSamples = uint32_t(0.002 * sampling_rate);
+    return config;
+}
 
-    // prepare transmit stream params
-    lms_stream_t stream_tx;
-    stream_tx.channel = channel;
-    stream_tx.isTx = true;
-    stream_tx.dataFmt = lms_stream_t::LMS_FMT_F32;    
-    lms_stream_meta_t meta_tx;
+// multitone probe: 100 Schroeder-phased tones every 2nd bin of a 1024 point
+// FFT (~3.9 kHz apart, +-195 kHz, delays up to 256 samples tell apart), one
+// guard period then 4 analysed periods per burst
+const size_t multitone_fft = 1024;
+const uint32_t multitone_guard = 1;
+const uint32_t multitone_periods = 4;
 
-    // setup sending stream
-    if (LMS_SetupStream(device, &stream_tx) != 0) {
-        std::cerr << "LMS_SetupStream failed (Tx)" << std::endl;
-        LMS_Close(device);
+int run_duplex(RxSource* rx, TxSink* tx, double seconds, bool multitone, bool iq_correct, bool matched) {
+    DuplexConfig config = duplex_config();
+    // bursts on period boundaries, so the receiver finds the FFT periods and
+    // the matched filter the burst starts by timestamp
+    config.alignBursts = multitone || matched;
+    DuplexEngine engine(rx, tx, config);
+    // DC and IQ imbalance out of the RX stream before anything measures it
+    IqCorrector corrector;
+    if (iq_correct) {
+        engine.setRxCorrection(&corrector);
+    }
+    // NCO tone, phase continuous from one burst to the next
+    WaveformGenerator waveform(sampling_rate, burst_samples);
+    MultitoneProbe probe(multitone_fft, MultitoneProbe::comb(-100, 100, 2));
+    MultitoneEstimator estimator(probe, config.periodSamples, multitone_guard, multitone_periods);
+    // the burst as sent, for the matched filter; the tone's phase moves from
+    // burst to burst, which only turns the correlation's phase
+    std::vector<std::complex<float>> reference;
+    if (multitone) {
+        reference = probe.burst(multitone_guard + multitone_periods);
+        engine.setBurst(reference);
+        std::cout << "Multitone probe: " << probe.tones() << " tones, crest factor " << probe.crestDb() << " dB"
+                  << std::endl;
+    } else {
+        WaveformGenerator tone(sampling_rate, burst_samples);
+        tone.setTone(baseband_frequency);
+        reference.resize(burst_samples);
+        tone.fill(reference.data(), reference.size());
+        waveform.setTone(baseband_frequency);
+        engine.setWaveform(&waveform, burst_samples);
+    }
+    // echo lag and strength of every burst, correlated on the spare cores;
+    // a full job ring holds up the RX tap until a worker catches up
+    MatchedFilter filter(reference, MatchedFilter::sizeFor(reference.size(), config.periodSamples));
+    EchoTracker echoes(config.periodSamples, filter.referenceSamples());
+    std::unique_ptr<ParallelMatchedFilter> correlator;
+    if (matched) {
+        unsigned workers = unsigned(std::max(1, onlineCpus() - 2));
+        correlator.reset(new ParallelMatchedFilter(filter, workers, [&](const CorrelationPeak& peak) {
+            echoes.add(peak);
+        }));
+        std::cout << "Matched filter: " << filter.referenceSamples() << " sample reference, FFT " << filter.fftSize()
+                  << ", " << workers << " workers" << std::endl;
+    }
+    if (multitone || matched) {
+        engine.setRxTap([&](const std::complex<float>* samples, size_t count, uint64_t timestamp) {
+            if (multitone) estimator.push(samples, count, timestamp);
+            if (correlator) correlator->push(samples, count, timestamp);
+        });
+    }
+    StatsPage stats;
+    if (stats.create() == 0) {
+        engine.setStats(&stats);
+    }
+    if (engine.start() != 0) {
+        std::cerr << "Duplex engine failed to start: " << engine.error() << std::endl;
+        return 1;
+    }
+    std::cout << "Duplex running for " << seconds << " s" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    while (engine.running() && std::chrono::steady_clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    engine.stop();
+    engine.report(std::cout);
+    if (correlator) {
+        correlator->flush();
+        echoes.finish();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const MatchedStats& ms = correlator->stats();
+        EchoStats es = echoes.stats();
+        std::cout << "matched filter: " << es.echoes << " echoes, lag " << es.meanLag << " +- " << es.lagStd
+                  << " samples (" << es.meanLag / sampling_rate * 1e6 << " us), gain " << es.meanGain
+                  << ", coefficient " << es.meanCoefficient << ", " << ms.lags / elapsed / 1e6
+                  << " M correlations/s" << std::endl;
+    }
+    if (iq_correct) {
+        IqImbalance imb = corrector.estimate();
+        std::cout << "iq correction (" << corrector.kernelName() << "): DC " << imb.dcI << ", " << imb.dcQ
+                  << ", gain " << imb.gainDb << " dB, phase " << imb.phaseDeg << " deg, image rejection "
+                  << imb.imageRejectionDb << " dB uncorrected" << std::endl;
+    }
+    if (multitone) {
+        const MultitoneStats& mt = estimator.stats();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "multitone: " << mt.estimates << " channel estimates, " << mt.periods << " periods ("
+                  << mt.rejected << " rejected), " << mt.estimates * probe.tones() / elapsed
+                  << " points/s, delay " << estimator.delaySamples() << " samples" << std::endl;
+        double bin_hz = sampling_rate / multitone_fft;
+        const std::vector<ToneEstimate>& tones = estimator.estimates();
+        for (size_t i = 0; i < tones.size(); i += 14) {
+            std::cout << "  " << tones[i].bin * bin_hz / 1e3 << " kHz: " << tones[i].gainDb << " dB, phase "
+                      << tones[i].phase << " rad, SNR " << tones[i].snrDb << " dB" << std::endl;
+        }
+    }
+    if (!engine.error().empty()) {
+        std::cerr << "Duplex stream failed: " << engine.error() << std::endl;
         return 1;
     }
-    std::cout << "LMS_SetupStream successful (Tx)" << std::endl;
-
-    //transmit the data
-    int tx_sent = LMS_SendStream(&stream_tx, tx_samples.data(), no_of_samples, &meta_tx, 1000);
-    std::cerr << "LMS_SendStream sent " << tx_sent << " of " << no_of_samples << std::endl;
-
-    // stop tranmission
-    LMS_StopStream(&stream_tx);
-    LMS_DestroyStream(device, &stream_tx);
-
     return 0;
 }
 
-int receive(lms_device_t* device) {
+#ifdef HAVE_LIMESUITE
+int duplex(lms_device_t* device, double seconds, bool multitone, bool iq_correct, bool matched) {
 
-    // prepare receive stream params
-    const int no_of_samples = 1024;
-    std::vector<std::complex<float>> rx_samples(no_of_samples);
-    lms_stream_t stream_rx;
-    stream_rx.channel = channel;
+    // prepare both stream params, F32 as before
+    lms_stream_t stream_tx = {};
+    stream_tx.channel = channel;
+    stream_tx.isTx = true;
+    stream_tx.fifoSize = 256 * 1024;
+    stream_tx.throughputVsLatency = 0.5;
+    stream_tx.dataFmt = lms_stream_t::LMS_FMT_F32;
+    lms_stream_t stream_rx = stream_tx;
     stream_rx.isTx = false;
-    stream_rx.dataFmt = lms_stream_t::LMS_FMT_F32;    
-    lms_stream_meta_t meta_rx;
 
-    // setup receiving stream
-    if(LMS_SetupStream(device, &stream_rx) != 0) {
+    if (LMS_SetupStream(device, &stream_tx) != 0) {
+        std::cerr << "LMS_SetupStream failed (Tx)" << std::endl;
+        return 1;
+    }
+    if (LMS_SetupStream(device, &stream_rx) != 0) {
         std::cerr << "LMS_SetupStream failed (Rx)" << std::endl;
-        LMS_Close(device);
+        LMS_DestroyStream(device, &stream_tx);
         return 1;
     }
+    std::cout << "LMS_SetupStream successful (Tx, Rx)" << std::endl;
 
-    // receive some data
-    int rx_received = LMS_RecvStream(&stream_rx, rx_samples.data(), no_of_samples, &meta_rx, 1000);
-    if (rx_received > 0) {
-        std::cout << "Received " << rx_received << " samples" << std::endl;
-        // Process received samples (e.g., calculate RSSI)
-        std::cout << rx_samples.data() << std::endl;
-    } else {
-        std::cerr << "LMS_RecvStream failed (Rx)" << std::endl;
-        std::cerr << LMS_GetLastErrorMessage() << std::endl;
-    }
-    
-    // stop reception
+    // both streams run for the whole measurement
+    LMS_StartStream(&stream_rx);
+    LMS_StartStream(&stream_tx);
+    LimeRxSource rx(&stream_rx);
+    LimeTxSink tx(&stream_tx);
+    int ret = run_duplex(&rx, &tx, seconds, multitone, iq_correct, matched);
+
+    LMS_StopStream(&stream_tx);
     LMS_StopStream(&stream_rx);
+    LMS_DestroyStream(device, &stream_tx);
     LMS_DestroyStream(device, &stream_rx);
 
-    return 0;
+    return ret;
 }
+#endif
 
-int main() {
+// usage: step1 [seconds] [--loopback] [--multitone] [--iq-correct] [--impair] [--matched]
+// --loopback runs the duplex engine against a simulated TX -> RX cable, the
+// only mode of a build without LimeSuite
+// --multitone sends the multitone probe instead of the single tone
+// --iq-correct takes DC offset and IQ imbalance out of the RX stream
+// --impair gives the loopback's receiver a DC offset and IQ imbalance
+// --matched correlates the RX stream against the burst for its echo delay
+int main(int argc, char** argv) {
+    double seconds = 2.0;
+    bool loopback = false;
+    bool multitone = false;
+    bool iq_correct = false;
+    bool impair = false;
+    bool matched = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--loopback") == 0) loopback = true;
+        else if (strcmp(argv[i], "--multitone") == 0) multitone = true;
+        else if (strcmp(argv[i], "--iq-correct") == 0) iq_correct = true;
+        else if (strcmp(argv[i], "--impair") == 0) impair = true;
+        else if (strcmp(argv[i], "--matched") == 0) matched = true;
+        else seconds = atof(argv[i]);
+    }
+    if (loopback) {
+        // 75 us through the cable and converters, up to 2 samples of jitter
+        LoopbackDevice loop(sampling_rate, 150, 0.5f, 0.01f, 2);
+        if (impair) {
+            loop.setFrontEnd(0.05f, -0.03f, 1.06f, 4.0f);
+        }
+        return run_duplex(&loop.rx, &loop.tx, seconds, multitone, iq_correct, matched);
+    }
+
+#ifndef HAVE_LIMESUITE
+    std::cerr << "Built without LimeSuite, only --loopback runs" << std::endl;
+    return -1;
+#else
     lms_device_t* device = nullptr;
     int ret;
     lms_info_str_t list[8];
-    lms_dev_info_t* devInfo;
 
     int numDevices = LMS_GetDeviceList(list);
 
@@ -160,16 +302,9 @@ int main() {
             return -1;
         }
 
-        // tx
-        if(transmit(device)!=0) {
-            std::cout << "Transmit failed" <<std::endl;
-            LMS_Close(device);
-            return -1;
-        }
-
-        // rx
-        if(receive(device)!=0) {
-            std::cout << "Receipt failed" <<std::endl;
+        // tx and rx together
+        if(duplex(device, seconds, multitone, iq_correct, matched)!=0) {
+            std::cout << "Duplex measurement failed" <<std::endl;
             LMS_Close(device);
             return -1;
         }
@@ -184,4 +319,5 @@ int main() {
     }
 
     return 0;
+#endif
 }
\ No newline at end of file
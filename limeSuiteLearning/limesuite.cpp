@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include "../sharedMemoryVisuals/asyncLog.h"
 
 int main()
 {
@@ -13,8 +14,6 @@ int main()
     int ret;
     // Declare an array to hold the device information strings
     lms_info_str_t list[8];
-    // Declare a pointer to hold the device information structure
-    lms_dev_info_t *devInfo;
 
     // Get the list of available LimeSDR devices
     // The function returns the number of devices found
@@ -58,7 +57,7 @@ int main()
     int numTXChannels = LMS_GetNumChannels(device, LMS_CH_TX);
     int numRXChannels = LMS_GetNumChannels(device, LMS_CH_RX);
     std::cout << "max TX Channels :" << numTXChannels << std::endl;
-    std::cout << "max RX Channels :" << numTXChannels << std::endl;
+    std::cout << "max RX Channels :" << numRXChannels << std::endl;
 
     // lets try out RX functionalities
     // enable RX channel 0
@@ -214,7 +213,8 @@ int main()
             LMS_Close(device);
             return -1;
         }
-        std::cout << "Received samples successfully." << std::endl;
+        // per-block progress goes through the async logger, once a second at most
+        ALOG_RATE(LOG_INFO, 1, "Received {} samples, timestamp {}", 1024, meta.timestamp);
 
         // Write samples to FIFO
         ssize_t bytes_written = write(fifo_fd, samples, sizeof(samples));
@@ -222,7 +222,7 @@ int main()
             std::cerr << "Failed to write samples to FIFO" << std::endl;
             break; // Exit the loop on error
         }
-        std::cout << "Wrote " << bytes_written << " bytes to FIFO." << std::endl;
+        ALOG_RATE(LOG_INFO, 1, "Wrote {} bytes to FIFO.", bytes_written);
         
         // Sleep for a while to simulate processing
         usleep(100000); // Sleep for 100 ms
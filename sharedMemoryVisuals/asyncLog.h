@@ -0,0 +1,326 @@
+#pragma once
+// asynchronous logger for the capture and processing threads
+//
+// a log call stores a fixed 128-byte record (timestamp, call site, up to 4
+// numeric or short string arguments) into a per-thread single-producer ring
+// and returns; it never formats, locks or enters the kernel. a background
+// thread drains every ring a few hundred times a second, formats the "{}"
+// placeholders and writes each batch with a single fwrite + fflush. a full
+// ring drops the record (counted and reported) rather than blocking capture.
+//
+// ALOG_RATE sites pass at most perSecond records per second, the rest are
+// counted and the next record that passes says how many were suppressed.
+// times print relative to program start. threads that must not allocate
+// call logAttachThread() when they start, else their ring is created by
+// their first log call.
+//
+//   ALOG(LOG_WARN, "capture: recv failed ({})", code);
+//   ALOG_RATE(LOG_WARN, 1, "stage {}: lost {} blocks", name.c_str(), lost);
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define LOG_RING_RECORDS 1024        // per thread, power of two
+#define LOG_MAX_ARGS 4
+#define LOG_TEXT_SIZE 64             // inline bytes shared by string arguments
+#define LOG_DRAIN_US 2000
+
+enum LogLevel : uint8_t {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR,
+};
+
+enum LogArgType : uint8_t {
+    LOG_ARG_I64,
+    LOG_ARG_U64,
+    LOG_ARG_F64,
+    LOG_ARG_STR,                     // value is an offset into LogRecord::text
+};
+
+inline uint64_t logNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// taken with the other statics before main
+inline const uint64_t logStartNs = logNowNs();
+
+// one per call site, a static inside the ALOG macros
+struct LogSite {
+    const char *fmt;
+    LogLevel level;
+    uint32_t perSecond;              // 0: no limit
+    std::atomic<uint64_t> window{0}; // second the counts below belong to
+    std::atomic<uint32_t> passed{0};
+    std::atomic<uint32_t> suppressed{0};
+
+    constexpr LogSite(const char *f, LogLevel l, uint32_t rate) : fmt(f), level(l), perSecond(rate) {}
+};
+
+struct LogRecord {
+    uint64_t ns;
+    const LogSite *site;
+    uint32_t suppressed;             // records of this site dropped by the rate limit
+    uint8_t nargs;
+    uint8_t types[LOG_MAX_ARGS];
+    uint8_t textUsed;
+    uint8_t pad[2];
+    uint64_t args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+};
+
+static_assert(sizeof(LogRecord) == 128, "LogRecord is two cache lines");
+
+// single producer (the owning thread), single consumer (the log thread)
+struct LogRing {
+    alignas(64) std::atomic<uint64_t> head{0};   // next record to write
+    alignas(64) std::atomic<uint64_t> tail{0};   // next record to format
+    alignas(64) std::atomic<uint64_t> dropped{0};
+    uint32_t threadIndex = 0;
+    LogRecord records[LOG_RING_RECORDS];
+
+    LogRecord *claim()
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == LOG_RING_RECORDS) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &records[h & (LOG_RING_RECORDS - 1)];
+    }
+
+    void commit() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
+
+class AsyncLogger {
+public:
+    static AsyncLogger &instance()
+    {
+        static AsyncLogger logger;
+        return logger;
+    }
+
+    ~AsyncLogger()
+    {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+        drain();
+    }
+
+    // where formatted lines go, stderr by default
+    void setOutput(FILE *out)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out_ = out;
+    }
+
+    // the calling thread's ring, registered on its first log call
+    LogRing *threadRing()
+    {
+        thread_local LogRing *ring = nullptr;
+        if (!ring) ring = registerThread();
+        return ring;
+    }
+
+    // format everything logged so far, e.g. before printing a report
+    void flush() { drain(); }
+
+    uint64_t dropped() const { return droppedReported_; }
+
+private:
+    AsyncLogger() : startNs_(logStartNs) {}
+
+    LogRing *registerThread()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.emplace_back(new LogRing);
+        rings_.back()->threadIndex = uint32_t(rings_.size() - 1);
+        if (!thread_.joinable()) {
+            running_ = true;
+            thread_ = std::thread([this] { run(); });
+        }
+        return rings_.back().get();
+    }
+
+    void run()
+    {
+        while (running_.load(std::memory_order_relaxed)) {
+            drain();
+            std::this_thread::sleep_for(std::chrono::microseconds(LOG_DRAIN_US));
+        }
+    }
+
+    // copy out every ring, merge by time, format and write the batch
+    void drain()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch_.clear();
+        uint64_t dropped = 0;
+        for (auto &ring : rings_) {
+            uint64_t t = ring->tail.load(std::memory_order_relaxed);
+            uint64_t h = ring->head.load(std::memory_order_acquire);
+            for (; t != h; ++t)
+                batch_.push_back({ring->records[t & (LOG_RING_RECORDS - 1)], ring->threadIndex});
+            ring->tail.store(t, std::memory_order_release);
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+        std::stable_sort(batch_.begin(), batch_.end(),
+                         [](const Pending &a, const Pending &b) { return a.record.ns < b.record.ns; });
+        line_.clear();
+        for (const Pending &p : batch_)
+            format(p.record, p.thread);
+        if (dropped != droppedReported_) {
+            line_ += "log: dropped " + std::to_string(dropped - droppedReported_) + " records, ring full\n";
+            droppedReported_ = dropped;
+        }
+        if (line_.empty()) return;
+        fwrite(line_.data(), 1, line_.size(), out_);
+        fflush(out_);
+    }
+
+    void format(const LogRecord &r, uint32_t thread)
+    {
+        static const char levels[] = "DIWE";
+        char buf[64];
+        snprintf(buf, sizeof(buf), "[%12.6f] %c t%u ", (r.ns - std::min(startNs_, r.ns)) * 1e-9, levels[r.site->level], thread);
+        line_ += buf;
+        const char *f = r.site->fmt;
+        unsigned arg = 0;
+        while (*f) {
+            if (f[0] == '{' && f[1] == '}' && arg < r.nargs) {
+                appendArg(r, arg++);
+                f += 2;
+            } else {
+                line_ += *f++;
+            }
+        }
+        if (r.suppressed) line_ += " (" + std::to_string(r.suppressed) + " similar suppressed)";
+        line_ += '\n';
+    }
+
+    void appendArg(const LogRecord &r, unsigned i)
+    {
+        char buf[32];
+        switch (r.types[i]) {
+        case LOG_ARG_I64: snprintf(buf, sizeof(buf), "%lld", (long long)int64_t(r.args[i])); break;
+        case LOG_ARG_U64: snprintf(buf, sizeof(buf), "%llu", (unsigned long long)r.args[i]); break;
+        case LOG_ARG_F64: {
+            double d;
+            memcpy(&d, &r.args[i], sizeof(d));
+            snprintf(buf, sizeof(buf), "%g", d);
+            break;
+        }
+        default:
+            line_ += r.text + r.args[i];
+            return;
+        }
+        line_ += buf;
+    }
+
+    struct Pending {
+        LogRecord record;
+        uint32_t thread;
+    };
+
+    std::mutex mutex_;                   // rings_ and the formatter state
+    std::vector<std::unique_ptr<LogRing>> rings_;
+    std::vector<Pending> batch_;
+    std::string line_;
+    FILE *out_ = stderr;
+    uint64_t startNs_;                   // timestamps print relative to this
+    uint64_t droppedReported_ = 0;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+// argument packing, numbers go in as 64-bit words, strings are copied
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value>::type logPack(LogRecord &r, T v)
+{
+    r.types[r.nargs] = std::is_signed<T>::value ? LOG_ARG_I64 : LOG_ARG_U64;
+    r.args[r.nargs++] = std::is_signed<T>::value ? uint64_t(int64_t(v)) : uint64_t(v);
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type logPack(LogRecord &r, T v)
+{
+    double d = v;
+    r.types[r.nargs] = LOG_ARG_F64;
+    memcpy(&r.args[r.nargs++], &d, sizeof(d));
+}
+
+// truncated to what is left of the record's text area
+inline void logPack(LogRecord &r, const char *s)
+{
+    size_t room = LOG_TEXT_SIZE - r.textUsed;
+    size_t n = room ? strnlen(s, room - 1) : 0;
+    if (room) {
+        memcpy(r.text + r.textUsed, s, n);
+        r.text[r.textUsed + n] = '\0';
+    }
+    r.types[r.nargs] = LOG_ARG_STR;
+    r.args[r.nargs++] = room ? r.textUsed : LOG_TEXT_SIZE - 1;
+    r.textUsed = uint8_t(r.textUsed + (room ? n + 1 : 0));
+}
+
+// false while the site is over its per-second budget
+inline bool logRateAllow(LogSite &site, uint64_t now)
+{
+    if (!site.perSecond) return true;
+    uint64_t second = now / 1000000000ull;
+    if (site.window.load(std::memory_order_relaxed) != second) {
+        site.window.store(second, std::memory_order_relaxed);
+        site.passed.store(0, std::memory_order_relaxed);
+    }
+    if (site.passed.fetch_add(1, std::memory_order_relaxed) < site.perSecond) return true;
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+template <typename... Args>
+inline void asyncLog(LogSite &site, Args... args)
+{
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+    LogRing *ring = AsyncLogger::instance().threadRing();
+    uint64_t now = logNowNs();
+    if (!logRateAllow(site, now)) return;
+    LogRecord *r = ring->claim();
+    if (!r) return;
+    r->ns = now;
+    r->site = &site;
+    r->suppressed = site.perSecond ? site.suppressed.exchange(0, std::memory_order_relaxed) : 0;
+    r->nargs = 0;
+    r->textUsed = 0;
+    r->text[LOG_TEXT_SIZE - 1] = '\0';
+    int unused[] = {0, (logPack(*r, args), 0)...};
+    (void)unused;
+    ring->commit();
+}
+
+// create the logger and the calling thread's ring now, at thread start,
+// rather than in the thread's first log call
+inline void logAttachThread()
+{
+    AsyncLogger::instance().threadRing();
+}
+
+#define ALOG_RATE(level, perSecond, fmt, ...)                          \
+    do {                                                               \
+        static LogSite alogSite_(fmt, level, perSecond);               \
+        asyncLog(alogSite_, ##__VA_ARGS__);                            \
+    } while (0)
+
+#define ALOG(level, fmt, ...) ALOG_RATE(level, 0, fmt, ##__VA_ARGS__)
@@ -0,0 +1,356 @@
+#pragma once
+// single-producer broadcast queue of fixed-size entries in POSIX shared memory
+//
+// layout: [BqHeader][slot 0]...[slot N-1], each slot a sequence word and one T.
+// the producer publishes entries under a monotonically increasing sequence
+// (hdr->cursor) and every consumer keeps its own read cursor in the header, so
+// any number of processes read the same stream without taking a lock and
+// without removing entries from under each other (Disruptor style).
+//
+// what happens when a consumer falls behind is the producer's policy:
+//   BQ_BLOCK        the producer waits until the slowest live consumer has
+//                   read the slot it is about to reuse; nothing is lost
+//   BQ_DROP_OLDEST  the producer never waits; a lapped consumer resumes at the
+//                   oldest entry still intact and counts what it missed
+//   BQ_SAMPLE       the producer never waits; a consumer that is behind jumps
+//                   straight to the newest entry, seeing a decimated stream
+//
+// slots use the same seqlock as the IQ ring: 2*n+1 while entry n is written,
+// 2*n+2 once it is published, so a torn read is detected and retried.
+// consumers that have caught up sleep on a futex (shmNotify.h) instead of
+// polling, and a blocked producer sleeps on a second one until a consumer
+// frees a slot.
+
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <new>
+#include <signal.h>
+#include "shmSegment.h"
+#include "shmNotify.h"
+
+#define BQ_MAGIC 0x51434242u // "BBCQ"
+#define BQ_VERSION 2
+#define BQ_MAX_CONSUMERS 16
+#define BQ_ALIGN 64
+
+enum BqPolicy : uint32_t {
+    BQ_BLOCK = 0,
+    BQ_DROP_OLDEST = 1,
+    BQ_SAMPLE = 2,
+};
+
+inline const char *bqPolicyName(BqPolicy p)
+{
+    return p == BQ_BLOCK ? "block" : p == BQ_DROP_OLDEST ? "drop-oldest" : "sample";
+}
+
+// one entry per attached consumer, a cache line each
+struct alignas(BQ_ALIGN) BqConsumerInfo {
+    std::atomic<uint32_t> pid;       // 0 when the entry is free
+    uint32_t reserved;
+    std::atomic<uint64_t> cursor;    // next sequence this consumer will read
+    std::atomic<uint64_t> dropped;   // entries it never got to see
+};
+
+struct BqHeader {
+    std::atomic<uint32_t> magic;     // written last by the producer
+    uint32_t version;
+    uint32_t headerSize;             // offset of slot 0
+    uint32_t capacity;               // slots, power of two
+    uint32_t entrySize;              // sizeof(T)
+    uint32_t slotStride;
+    uint32_t policy;                 // BqPolicy
+    uint32_t reserved;
+    alignas(BQ_ALIGN) std::atomic<uint64_t> cursor; // entries published so far
+    ShmNotifier notify;              // consumers sleep here for new entries
+    ShmNotifier space;               // a blocked producer sleeps here for free slots
+    BqConsumerInfo consumers[BQ_MAX_CONSUMERS];
+};
+
+template <typename T>
+struct BqSlot {
+    std::atomic<uint64_t> seq;
+    T value;
+};
+
+// what a consumer gets back alongside the entry
+struct BqReadInfo {
+    uint64_t sequence;
+    uint64_t lost;                   // entries skipped since the previous read
+};
+
+inline bool bqPidAlive(uint32_t pid)
+{
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+template <typename T>
+class BroadcastProducer {
+    static_assert(std::is_trivially_copyable<T>::value, "queue entries are copied between processes");
+
+public:
+    ~BroadcastProducer() { close(); }
+
+    int create(const char *name, uint32_t capacity, BqPolicy policy)
+    {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+            std::cerr << "broadcastQueue: capacity must be a power of two" << std::endl;
+            return -1;
+        }
+        size_t headerSize = (sizeof(BqHeader) + BQ_ALIGN - 1) & ~size_t(BQ_ALIGN - 1);
+        size_ = headerSize + sizeof(BqSlot<T>) * capacity;
+        void *base = shmCreate(name, size_);
+        if (!base) return -1;
+        name_ = name;
+        base_ = static_cast<uint8_t *>(base);
+        hdr_ = new (base_) BqHeader();
+        hdr_->version = BQ_VERSION;
+        hdr_->headerSize = headerSize;
+        hdr_->capacity = capacity;
+        hdr_->entrySize = sizeof(T);
+        hdr_->slotStride = sizeof(BqSlot<T>);
+        hdr_->policy = policy;
+        for (uint32_t i = 0; i < capacity; ++i)
+            new (slot(i)) BqSlot<T>();
+        next_ = 0;
+        gate_ = 0;
+        notifier_.attach(&hdr_->notify);
+        hdr_->magic.store(BQ_MAGIC, std::memory_order_release);
+        return 0;
+    }
+
+    // publish one entry; under BQ_BLOCK waits for room unless stop is set
+    // returns false only when it gave up waiting
+    bool publish(const T &value, const std::atomic<bool> *stop = nullptr)
+    {
+        if (hdr_->policy == BQ_BLOCK && next_ - gate_ >= hdr_->capacity && !waitForRoom(stop)) return false;
+        BqSlot<T> *s = slot(next_);
+        s->seq.store(2 * next_ + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&s->value, &value, sizeof(T));
+        s->seq.store(2 * next_ + 2, std::memory_order_release);
+        hdr_->cursor.store(++next_, std::memory_order_release);
+        notifier_.notify();
+        return true;
+    }
+
+    // wake sleeping consumers at most once per batch entries
+    void setWakeBatch(uint32_t batch) { notifier_.setWakeBatch(batch); }
+    void wakeConsumers() { if (hdr_) notifier_.flush(); }
+
+    // live consumers attached right now
+    unsigned consumers() const
+    {
+        unsigned n = 0;
+        for (const BqConsumerInfo &c : hdr_->consumers)
+            if (c.pid.load(std::memory_order_relaxed) != 0) ++n;
+        return n;
+    }
+
+    uint64_t published() const { return next_; }
+    uint64_t stalls() const { return stalls_; }
+    uint64_t wakes() const { return notifier_.wakes(); }
+    BqHeader *header() const { return hdr_; }
+
+    void close()
+    {
+        if (base_) {
+            munmap(base_, size_);
+            shm_unlink(name_.c_str());
+            base_ = nullptr;
+            hdr_ = nullptr;
+        }
+    }
+
+private:
+    BqSlot<T> *slot(uint64_t seq) const
+    {
+        return reinterpret_cast<BqSlot<T> *>(base_ + hdr_->headerSize + (seq & (hdr_->capacity - 1)) * sizeof(BqSlot<T>));
+    }
+
+    // lowest cursor of the live consumers, reclaiming entries of dead ones
+    uint64_t slowestConsumer()
+    {
+        uint64_t slowest = next_;
+        for (BqConsumerInfo &c : hdr_->consumers) {
+            uint32_t pid = c.pid.load(std::memory_order_acquire);
+            if (pid == 0) continue;
+            if (!bqPidAlive(pid)) {
+                c.pid.compare_exchange_strong(pid, 0);
+                continue;
+            }
+            uint64_t cursor = c.cursor.load(std::memory_order_acquire);
+            if (cursor < slowest) slowest = cursor;
+        }
+        return slowest;
+    }
+
+    bool waitForRoom(const std::atomic<bool> *stop)
+    {
+        auto room = [this] {
+            gate_ = slowestConsumer();
+            return next_ - gate_ < hdr_->capacity;
+        };
+        if (room()) return true;
+        stalls_++;
+        // the timeout bounds how long a consumer that died mid-read holds us up
+        while (!notifyWait(&hdr_->space, room, 100)) {
+            if (stop && stop->load(std::memory_order_relaxed)) return false;
+        }
+        return true;
+    }
+
+    std::string name_;
+    uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    BqHeader *hdr_ = nullptr;
+    uint64_t next_ = 0;
+    uint64_t gate_ = 0;      // cached slowest consumer cursor
+    uint64_t stalls_ = 0;
+    NotifyPublisher notifier_;
+};
+
+template <typename T>
+class BroadcastConsumer {
+    static_assert(std::is_trivially_copyable<T>::value, "queue entries are copied between processes");
+
+public:
+    ~BroadcastConsumer() { close(); }
+
+    // attach to an existing queue; starts at the newest entry unless fromOldest
+    int open(const char *name, bool fromOldest = false)
+    {
+        base_ = static_cast<uint8_t *>(shmOpen(name, &size_, true));
+        if (!base_) {
+            std::cerr << "broadcastQueue: cannot open " << name << ": " << strerror(errno) << std::endl;
+            return -1;
+        }
+        hdr_ = reinterpret_cast<BqHeader *>(base_);
+        if (size_ < sizeof(BqHeader) || hdr_->magic.load(std::memory_order_acquire) != BQ_MAGIC ||
+            hdr_->version != BQ_VERSION || hdr_->entrySize != sizeof(T)) {
+            std::cerr << "broadcastQueue: " << name << " is not a version " << BQ_VERSION
+                      << " queue of " << sizeof(T) << "-byte entries" << std::endl;
+            munmap(base_, size_);
+            base_ = nullptr;
+            hdr_ = nullptr;
+            return -1;
+        }
+
+        uint64_t wc = hdr_->cursor.load(std::memory_order_acquire);
+        if (fromOldest)
+            cursor_ = wc > hdr_->capacity ? wc - hdr_->capacity : 0;
+        else
+            cursor_ = wc;
+
+        // claim a consumer entry; under BQ_BLOCK it gates the producer from now on
+        uint32_t self = getpid();
+        for (BqConsumerInfo &c : hdr_->consumers) {
+            uint32_t pid = c.pid.load(std::memory_order_relaxed);
+            if (pid != 0 && bqPidAlive(pid)) continue;
+            // publish the cursor before the pid so the producer never sees a stale one
+            c.cursor.store(cursor_, std::memory_order_relaxed);
+            c.dropped.store(0, std::memory_order_relaxed);
+            if (c.pid.compare_exchange_strong(pid, self, std::memory_order_release)) {
+                me_ = &c;
+                break;
+            }
+        }
+        if (!me_) std::cerr << "broadcastQueue: no free consumer entry, reading without gating the producer" << std::endl;
+        space_.attach(&hdr_->space);
+        return 0;
+    }
+
+    // copy the next entry into out; returns 1 when one was read, 0 when there is nothing new
+    int poll(T *out, BqReadInfo *info = nullptr)
+    {
+        uint64_t lost = 0;
+        while (true) {
+            uint64_t wc = hdr_->cursor.load(std::memory_order_acquire);
+            if (cursor_ >= wc) {
+                if (lost) commit(lost);
+                return 0;
+            }
+            if (hdr_->policy == BQ_SAMPLE && wc - cursor_ > 1) {
+                lost += wc - 1 - cursor_;
+                cursor_ = wc - 1;
+            } else if (wc - cursor_ > hdr_->capacity) {
+                lost += wc - hdr_->capacity - cursor_;
+                cursor_ = wc - hdr_->capacity;
+            }
+            BqSlot<T> *s = slot(cursor_);
+            uint64_t expected = 2 * cursor_ + 2;
+            uint64_t seq1 = s->seq.load(std::memory_order_acquire);
+            if (seq1 == expected) {
+                memcpy(out, &s->value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s->seq.load(std::memory_order_relaxed) == seq1) {
+                    if (info) {
+                        info->sequence = cursor_;
+                        info->lost = lost;
+                    }
+                    ++cursor_;
+                    commit(lost);
+                    return 1;
+                }
+            }
+            // overwritten while we looked at it
+            ++lost;
+            ++cursor_;
+        }
+    }
+
+    // sleep until an entry arrives or timeoutMs passes; 0 on timeout
+    int wait(T *out, unsigned timeoutMs, BqReadInfo *info = nullptr)
+    {
+        if (poll(out, info)) return 1;
+        notifyWait(&hdr_->notify, [this] { return hdr_->cursor.load(std::memory_order_acquire) > cursor_; },
+                   timeoutMs);
+        return poll(out, info);
+    }
+
+    // entries published but not yet read by this consumer
+    uint64_t lag() const { return hdr_->cursor.load(std::memory_order_acquire) - cursor_; }
+    uint64_t dropped() const { return dropped_; }
+    BqPolicy policy() const { return BqPolicy(hdr_->policy); }
+    BqHeader *header() const { return hdr_; }
+
+    void close()
+    {
+        if (base_) {
+            if (me_) me_->pid.store(0, std::memory_order_release);
+            munmap(base_, size_);
+            base_ = nullptr;
+            hdr_ = nullptr;
+            me_ = nullptr;
+        }
+    }
+
+private:
+    BqSlot<T> *slot(uint64_t seq) const
+    {
+        return reinterpret_cast<BqSlot<T> *>(base_ + hdr_->headerSize + (seq & (hdr_->capacity - 1)) * hdr_->slotStride);
+    }
+
+    // release: under BQ_BLOCK the producer may reuse the slot once it sees this
+    void commit(uint64_t lost)
+    {
+        dropped_ += lost;
+        if (me_) {
+            me_->cursor.store(cursor_, std::memory_order_release);
+            if (lost) me_->dropped.store(dropped_, std::memory_order_relaxed);
+            if (hdr_->policy == BQ_BLOCK) space_.notify();
+        }
+    }
+
+    uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    BqHeader *hdr_ = nullptr;
+    BqConsumerInfo *me_ = nullptr;
+    uint64_t cursor_ = 0;
+    uint64_t dropped_ = 0;
+    NotifyPublisher space_;
+};
@@ -0,0 +1,222 @@
+#pragma once
+// on-disk cache of calibrated chip configurations, so a restart can load the
+// register state a previous run calibrated instead of running LMS_Calibrate
+// again
+//
+// entries are keyed by board serial, LO, LPF bandwidth, gain and a
+// temperature bucket (calibration drifts with die temperature) and expire
+// after maxAgeHours. each entry is one LMS_SaveConfig file in the cache
+// directory; the index is a text file with one line per entry, rewritten
+// through a rename so a crash never leaves it half written.
+//
+// the device side is the CalibrationDevice interface: limeCalibration.h for
+// the board, fakeCalibrationDevice.h to exercise the cache without one.
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+class CalibrationDevice {
+public:
+    virtual ~CalibrationDevice() {}
+    virtual std::string serial() = 0;
+    virtual int temperature(double *celsius) = 0;
+    // the slow path: set the LPF bandwidth and calibrate at the current settings
+    virtual int calibrate(double bandwidthHz) = 0;
+    virtual int saveConfig(const std::string &path) = 0;
+    virtual int loadConfig(const std::string &path) = 0;
+    virtual const char *lastError() const { return ""; }
+};
+
+struct CalKey {
+    std::string serial;
+    int64_t loKhz;
+    int64_t bandwidthKhz;
+    unsigned gainDb;
+    int tempBucket;
+
+    bool operator==(const CalKey &o) const
+    {
+        return serial == o.serial && loKhz == o.loKhz && bandwidthKhz == o.bandwidthKhz && gainDb == o.gainDb &&
+               tempBucket == o.tempBucket;
+    }
+};
+
+struct CalEntry {
+    CalKey key;
+    int64_t created;                     // unix seconds
+    std::string file;                    // config file name inside the cache directory
+};
+
+enum CalOutcome {
+    CAL_HIT,                             // cached config loaded
+    CAL_MISS,                            // calibrated and stored
+    CAL_UNCACHED,                        // calibrated, but storing it failed
+};
+
+inline const char *calOutcomeName(CalOutcome o)
+{
+    return o == CAL_HIT ? "cache hit" : o == CAL_MISS ? "cache miss" : "not cached";
+}
+
+class CalibrationCache {
+public:
+    // tempStepC wide temperature buckets, entries older than maxAgeHours are recalibrated
+    int open(const std::string &dir, double tempStepC = 5.0, double maxAgeHours = 24 * 7)
+    {
+        dir_ = dir;
+        tempStep_ = tempStepC;
+        maxAge_ = int64_t(maxAgeHours * 3600);
+        // mkdir -p
+        for (size_t slash = dir.find('/', 1);; slash = dir.find('/', slash + 1)) {
+            std::string part = dir.substr(0, slash);
+            if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) {
+                std::cerr << "calibrationCache: cannot create " << part << ": " << strerror(errno) << std::endl;
+                return -1;
+            }
+            if (slash == std::string::npos) break;
+        }
+        loadIndex();
+        return 0;
+    }
+
+    // recalibrate even when a valid entry exists (the fresh result replaces it)
+    void setForce(bool force) { force_ = force; }
+
+    // read serial and temperature off the device and build the key for these settings
+    int key(CalibrationDevice &dev, double loHz, double bandwidthHz, unsigned gainDb, CalKey *out) const
+    {
+        double celsius = 0;
+        if (dev.temperature(&celsius) != 0) return -1;
+        *out = {dev.serial(), std::llround(loHz / 1e3), std::llround(bandwidthHz / 1e3), gainDb,
+                int(std::floor(celsius / tempStep_))};
+        return 0;
+    }
+
+    // load the cached configuration for key, or calibrate and store the result
+    int apply(CalibrationDevice &dev, const CalKey &key, double bandwidthHz, CalOutcome *outcome)
+    {
+        const CalEntry *entry = force_ ? nullptr : find(key);
+        if (entry && dev.loadConfig(path(entry->file)) == 0) {
+            *outcome = CAL_HIT;
+            return 0;
+        }
+        if (entry) std::cerr << "calibrationCache: loading " << entry->file << " failed: " << dev.lastError() << std::endl;
+        if (dev.calibrate(bandwidthHz) != 0) return -1;
+        *outcome = store(dev, key) == 0 ? CAL_MISS : CAL_UNCACHED;
+        return 0;
+    }
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    std::string path(const std::string &file) const { return dir_ + "/" + file; }
+
+    const CalEntry *find(const CalKey &key) const
+    {
+        int64_t now = int64_t(time(nullptr));
+        for (const CalEntry &e : entries_) {
+            if (!(e.key == key) || now - e.created > maxAge_) continue;
+            if (access(path(e.file).c_str(), R_OK) != 0) continue;
+            return &e;
+        }
+        return nullptr;
+    }
+
+    int store(CalibrationDevice &dev, const CalKey &key)
+    {
+        std::ostringstream name;
+        name << key.serial << "_" << key.loKhz << "k_" << key.bandwidthKhz << "k_" << key.gainDb << "dB_t"
+             << key.tempBucket << ".ini";
+        if (dev.saveConfig(path(name.str())) != 0) {
+            std::cerr << "calibrationCache: saving " << name.str() << " failed: " << dev.lastError() << std::endl;
+            return -1;
+        }
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            if (entries_[i].key == key) {
+                entries_.erase(entries_.begin() + i);
+                break;
+            }
+        }
+        entries_.push_back({key, int64_t(time(nullptr)), name.str()});
+        return saveIndex();
+    }
+
+    // serial lo_khz bw_khz gain_db temp_bucket created file
+    void loadIndex()
+    {
+        entries_.clear();
+        std::ifstream in(path("index.txt"));
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            CalEntry e;
+            if (fields >> e.key.serial >> e.key.loKhz >> e.key.bandwidthKhz >> e.key.gainDb >> e.key.tempBucket >>
+                e.created >> e.file)
+                entries_.push_back(e);
+        }
+    }
+
+    int saveIndex()
+    {
+        std::string tmp = path("index.txt.tmp");
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            for (const CalEntry &e : entries_)
+                out << e.key.serial << " " << e.key.loKhz << " " << e.key.bandwidthKhz << " " << e.key.gainDb << " "
+                    << e.key.tempBucket << " " << e.created << " " << e.file << "\n";
+            if (!out) {
+                std::cerr << "calibrationCache: cannot write " << tmp << std::endl;
+                return -1;
+            }
+        }
+        if (rename(tmp.c_str(), path("index.txt").c_str()) != 0) {
+            std::cerr << "calibrationCache: rename failed: " << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    std::string dir_;
+    double tempStep_ = 5.0;
+    int64_t maxAge_ = 0;
+    bool force_ = false;
+    std::vector<CalEntry> entries_;
+};
+
+// wall time of each startup phase, printed once the stream runs
+class StartupReport {
+public:
+    StartupReport() : start_(std::chrono::steady_clock::now()), last_(start_) {}
+
+    // close the phase that started at the previous mark
+    void mark(const std::string &phase)
+    {
+        auto now = std::chrono::steady_clock::now();
+        phases_.push_back({phase, std::chrono::duration<double, std::milli>(now - last_).count()});
+        last_ = now;
+    }
+
+    void report(std::ostream &os) const
+    {
+        os << "startup: " << std::chrono::duration<double, std::milli>(last_ - start_).count() << " ms (";
+        for (size_t i = 0; i < phases_.size(); ++i)
+            os << (i ? ", " : "") << phases_[i].first << " " << phases_[i].second << " ms";
+        os << ")" << std::endl;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point last_;
+    std::vector<std::pair<std::string, double>> phases_;
+};
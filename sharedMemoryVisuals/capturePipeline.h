@@ -0,0 +1,385 @@
+#pragma once
+// capture thread + processing stages around the shared memory ring
+//
+// the capture thread does nothing but drain the source into ring slots. the
+// ring is the lock-free hand-off: every stage runs on its own worker thread
+// with its own ring reader, so a slow stage falls behind (and counts the
+// blocks it lost) without ever stalling capture or the other stages.
+//
+// with a StatsPage attached, the receive call, the copy, the publish and
+// every stage are timed into its histograms, and a monitor thread samples
+// the source's stream status into it ten times a second.
+//
+// the capture and stage threads only log through asyncLog.h, rate limited.
+//
+// setRealtime() runs capture under SCHED_FIFO and the stages one priority
+// below it, each pinned where asked, with their stacks prefaulted before the
+// first block (see realtime.h).
+//
+// every block's timestamp goes through a ContinuityChecker before it is
+// published: gaps, counter restarts and short reads are tagged in the slot
+// flags, and with GAP_ZERO_FILL the gap is covered with zero blocks.
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "iqCorrection.h"
+#include "iqRing.h"
+#include "rxSource.h"
+#include "asyncLog.h"
+#include "continuity.h"
+#include "sampleConvert.h"
+#include "statsPage.h"
+#include "realtime.h"
+#include "threadAffinity.h"
+
+// a stage sees every block it keeps up with: samples are interleaved IQ in
+// the ring's sample format, info.count pairs long
+typedef std::function<void(const void *samples, const IqBlockInfo &info)> StageFn;
+// same, for stages that need interleaved floats in [-1, 1)
+typedef std::function<void(const float *samples, const IqBlockInfo &info)> FloatStageFn;
+
+struct CaptureStats {
+    std::atomic<uint64_t> blocks{0};
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> shortReads{0}; // returned fewer samples than asked for
+    std::atomic<uint64_t> timeouts{0};   // returned nothing within the receive timeout
+    std::atomic<uint64_t> errors{0};
+};
+
+// hardware timestamp and host arrival time of the first published block,
+// for lining up streams whose sample counters started at different times
+struct FirstBlock {
+    std::atomic<uint64_t> timestamp{0};
+    std::atomic<uint64_t> hostNs{0};     // statsNowNs() clock, 0 until the first block
+};
+
+struct StageStats {
+    std::atomic<uint64_t> blocks{0};
+    std::atomic<uint64_t> dropped{0};    // blocks overwritten before the stage read them
+    std::atomic<uint64_t> backlog{0};    // published blocks not yet processed
+    std::atomic<uint64_t> maxBacklog{0};
+};
+
+class CapturePipeline {
+public:
+    // ringName must name the ring that ring was created with
+    CapturePipeline(RxSource *source, IqRingWriter *ring, const char *ringName)
+        : source_(source), ring_(ring), ringName_(ringName) {}
+
+    ~CapturePipeline() { stop(); }
+
+    void addStage(const std::string &name, StageFn fn)
+    {
+        std::unique_ptr<Stage> stage(new Stage);
+        stage->name = name;
+        stage->fn = fn;
+        stages_.push_back(std::move(stage));
+    }
+
+    // integer rings are converted per stage, only for the stages that ask.
+    // with a corrector the stage sees DC and IQ imbalance taken out, in the
+    // same pass as the conversion; the corrector is used on the stage's
+    // thread only
+    void addFloatStage(const std::string &name, FloatStageFn fn, IqCorrector *corrector = nullptr)
+    {
+        IqRingHeader *hdr = ring_->header();
+        if (corrector) {
+            float fullScale = hdr->fullScale;
+            bool i16 = hdr->sampleFormat == IQ_FMT_I16;
+            auto floats = std::make_shared<std::vector<float>>(2 * size_t(hdr->slotSamples));
+            addStage(name, [fn, corrector, fullScale, i16, floats](const void *samples, const IqBlockInfo &info) {
+                if (i16)
+                    corrector->process(static_cast<const int16_t *>(samples), floats->data(), info.count, fullScale);
+                else
+                    corrector->process(static_cast<const float *>(samples), floats->data(), info.count);
+                fn(floats->data(), info);
+            });
+            return;
+        }
+        if (hdr->sampleFormat == IQ_FMT_F32) {
+            addStage(name, [fn](const void *samples, const IqBlockInfo &info) {
+                fn(static_cast<const float *>(samples), info);
+            });
+            return;
+        }
+        float fullScale = hdr->fullScale;
+        auto floats = std::make_shared<std::vector<float>>(2 * size_t(hdr->slotSamples));
+        addStage(name, [fn, fullScale, floats](const void *samples, const IqBlockInfo &info) {
+            i16ToF32(static_cast<const int16_t *>(samples), floats->data(), 2 * size_t(info.count), fullScale);
+            fn(floats->data(), info);
+        });
+    }
+
+    // receive into a local buffer and copy into the ring instead of
+    // receiving straight into the claimed slot
+    void setCopyMode(bool copy) { copyMode_ = copy; }
+
+    // what to do about samples missing between blocks; gaps longer than
+    // maxFillSamples are only tagged even under GAP_ZERO_FILL
+    void setGapPolicy(GapPolicy policy, uint64_t maxFillSamples = 1 << 20)
+    {
+        gapPolicy_ = policy;
+        maxFill_ = maxFillSamples;
+    }
+
+    // pin the capture thread to a CPU, -1 leaves it to the scheduler
+    void setCpu(int cpu) { cpu_ = cpu; }
+
+    // SCHED_FIFO priority for the capture thread (stages get one less), and
+    // the CPUs the stages are pinned to round robin; call before start()
+    void setRealtime(int priority, const std::vector<int> &stageCpus = std::vector<int>())
+    {
+        priority_ = priority;
+        stageCpus_ = stageCpus;
+    }
+
+    // export per-step timings and stream status, call before start()
+    void setStats(StatsPage *stats) { stats_ = stats; }
+
+    int start()
+    {
+        // attach every reader before the first block is published
+        for (auto &stage : stages_) {
+            if (stage->reader.open(ringName_.c_str()) != 0) return -1;
+        }
+        if (stats_) {
+            recvMetric_ = stats_->addMetric("recv");
+            if (copyMode_) copyMetric_ = stats_->addMetric("copy");
+            publishMetric_ = stats_->addMetric("publish");
+            for (auto &stage : stages_)
+                stage->metric = stats_->addMetric("stage:" + stage->name);
+        }
+        running_ = true;
+        if (stats_) monitor_ = std::thread([this] { monitorLoop(); });
+        for (size_t i = 0; i < stages_.size(); ++i) {
+            Stage *s = stages_[i].get();
+            s->cpu = stageCpus_.empty() ? -1 : stageCpus_[i % stageCpus_.size()];
+            s->thread = std::thread([this, s] { stageLoop(s); });
+        }
+        capture_ = std::thread([this] { captureLoop(); });
+        return 0;
+    }
+
+    void stop()
+    {
+        running_ = false;
+        if (capture_.joinable()) capture_.join();
+        if (ring_->header()) ring_->wakeReaders();
+        if (monitor_.joinable()) monitor_.join();
+        for (auto &stage : stages_) {
+            if (stage->thread.joinable()) stage->thread.join();
+            stage->reader.close();
+        }
+        AsyncLogger::instance().flush();
+    }
+
+    bool running() const { return running_; }
+    // set by the capture thread, read from anywhere
+    std::string error() const
+    {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        return error_;
+    }
+
+    // one line for capture and the device FIFO, one per stage
+    void report(std::ostream &os)
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t samples = capture.samples.load();
+        double seconds = std::chrono::duration<double>(now - lastReport_).count();
+        double rate = lastReport_.time_since_epoch().count() ? (samples - lastSamples_) / seconds : 0.0;
+        lastReport_ = now;
+        lastSamples_ = samples;
+
+        os << "capture: " << capture.blocks.load() << " blocks, " << rate / 1e6 << " MS/s, "
+           << capture.shortReads.load() << " short, " << capture.timeouts.load() << " timeouts, "
+           << capture.errors.load() << " errors";
+        RxStatus status;
+        if (source_->status(&status) == 0) {
+            os << " | fifo " << status.fifoFilledCount << "/" << status.fifoSize
+               << ", overrun " << status.overrun << ", dropped " << status.droppedPackets
+               << ", link " << status.linkRate / 1e6 << " MB/s";
+        }
+        os << "\n  ";
+        continuity.report(os);
+        for (auto &stage : stages_) {
+            os << "  " << stage->name << ": " << stage->stats.blocks.load() << " blocks, backlog "
+               << stage->stats.backlog.load() << " (max " << stage->stats.maxBacklog.load() << "), dropped "
+               << stage->stats.dropped.load() << "\n";
+        }
+        os.flush();
+    }
+
+    CaptureStats capture;
+    ContinuityChecker continuity;
+    FirstBlock first;
+
+private:
+    struct Stage {
+        std::string name;
+        StageFn fn;
+        IqRingReader reader;
+        StageStats stats;
+        StatsMetric *metric = nullptr;
+        int cpu = -1;
+        std::thread thread;
+    };
+
+    // the first error is the one that stopped capture
+    void setError(const std::string &error)
+    {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        if (error_.empty()) error_ = error;
+    }
+
+    void captureLoop()
+    {
+        uint32_t blockSamples = ring_->slotSamples();
+        std::vector<uint8_t> local(copyMode_ ? size_t(blockSamples) * ring_->header()->bytesPerSample : 0);
+        RxMeta meta;
+        if (cpu_ >= 0) pinThisThread(cpu_);
+        goRealtime("capture", priority_);
+        while (running_) {
+            void *dst = copyMode_ ? local.data() : ring_->claim();
+            uint64_t t0 = recvMetric_ ? statsNowNs() : 0;
+            int received = source_->recv(dst, blockSamples, &meta, 1000);
+            if (recvMetric_) recvMetric_->record(statsNowNs() - t0, received > 0 ? received : 0);
+            if (received < 0) {
+                capture.errors++;
+                if (recvMetric_) recvMetric_->drop();
+                setError(source_->lastError());
+                ALOG(LOG_ERROR, "capture: receive failed after {} blocks", capture.blocks.load(std::memory_order_relaxed));
+                running_ = false;
+                break;
+            }
+            if (received == 0) {
+                capture.timeouts++;
+                ALOG_RATE(LOG_WARN, 1, "capture: no samples within the receive timeout");
+                continue;
+            }
+            if (uint32_t(received) < blockSamples) {
+                capture.shortReads++;
+                ALOG_RATE(LOG_WARN, 1, "capture: short read, {} of {} samples", received, blockSamples);
+                if (recvMetric_) recvMetric_->drop();
+            }
+            uint64_t gap;
+            uint32_t flags = continuity.check(meta.timestamp, received, blockSamples, &gap);
+            if (gap) {
+                ALOG_RATE(LOG_WARN, 1, "capture: {} samples missing before timestamp {}", gap, meta.timestamp);
+                if (gapPolicy_ == GAP_ZERO_FILL && gap <= maxFill_) {
+                    // the fill blocks reuse the slot this block was received into
+                    size_t bytes = size_t(received) * ring_->header()->bytesPerSample;
+                    if (!copyMode_) local.assign(static_cast<uint8_t *>(dst), static_cast<uint8_t *>(dst) + bytes);
+                    fillGap(meta.timestamp - gap, gap);
+                    if (!copyMode_) memcpy(ring_->claim(), local.data(), local.size());
+                }
+            }
+            if (copyMode_) {
+                StatsTimer timer(copyMetric_, received);
+                memcpy(ring_->claim(), local.data(), size_t(received) * ring_->header()->bytesPerSample);
+            }
+            {
+                StatsTimer timer(publishMetric_, received);
+                ring_->publish(received, meta.timestamp, flags);
+            }
+            if (!first.hostNs.load(std::memory_order_relaxed)) {
+                first.timestamp.store(meta.timestamp, std::memory_order_relaxed);
+                first.hostNs.store(statsNowNs(), std::memory_order_release);
+            }
+            capture.blocks.fetch_add(1, std::memory_order_relaxed);
+            capture.samples.fetch_add(received, std::memory_order_relaxed);
+        }
+    }
+
+    // zero blocks over [timestamp, timestamp + samples)
+    void fillGap(uint64_t timestamp, uint64_t samples)
+    {
+        uint32_t blockSamples = ring_->slotSamples();
+        size_t bytesPerSample = ring_->header()->bytesPerSample;
+        continuity.filled(samples);
+        while (samples) {
+            uint32_t n = uint32_t(std::min<uint64_t>(samples, blockSamples));
+            memset(ring_->claim(), 0, n * bytesPerSample);
+            ring_->publish(n, timestamp, IQ_BLOCK_FILLED);
+            timestamp += n;
+            samples -= n;
+        }
+    }
+
+    void stageLoop(Stage *stage)
+    {
+        IqRingHeader *hdr = stage->reader.header();
+        std::vector<uint8_t> block(size_t(hdr->slotSamples) * hdr->bytesPerSample);
+        IqBlockInfo info;
+        if (stage->cpu >= 0) pinThisThread(stage->cpu);
+        goRealtime(stage->name.c_str(), priority_ > 1 ? priority_ - 1 : priority_);
+        while (running_) {
+            // caught up: sleep until the capture thread publishes again
+            if (!stage->reader.wait(block.data(), hdr->slotSamples, &info, 100)) continue;
+            {
+                StatsTimer timer(stage->metric, info.count);
+                stage->fn(block.data(), info);
+            }
+            if (stage->metric && info.lost) stage->metric->drop(info.lost);
+            uint64_t backlog = stage->reader.lag();
+            stage->stats.blocks.fetch_add(1, std::memory_order_relaxed);
+            stage->stats.backlog.store(backlog, std::memory_order_relaxed);
+            if (backlog > stage->stats.maxBacklog.load(std::memory_order_relaxed))
+                stage->stats.maxBacklog.store(backlog, std::memory_order_relaxed);
+            if (info.lost) {
+                stage->stats.dropped.fetch_add(info.lost, std::memory_order_relaxed);
+                ALOG_RATE(LOG_WARN, 1, "stage {}: overrun, lost {} blocks before block {}", stage->name.c_str(), info.lost,
+                          info.block);
+            }
+        }
+    }
+
+    // every pipeline thread starts here, its log ring is set up first
+    void goRealtime(const char *who, int priority)
+    {
+        logAttachThread();
+        if (priority <= 0) return;
+        int err = setThreadPriority(priority);
+        if (err) ALOG(LOG_WARN, "{}: SCHED_FIFO {} refused, errno {}", who, priority, err);
+        prefaultStack();
+    }
+
+    // stream status into the stats page, away from the capture thread
+    void monitorLoop()
+    {
+        RxStatus status;
+        while (running_) {
+            if (source_->status(&status) == 0) stats_->publishStream(status);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    RxSource *source_;
+    IqRingWriter *ring_;
+    std::string ringName_;
+    bool copyMode_ = false;
+    GapPolicy gapPolicy_ = GAP_MARK;
+    uint64_t maxFill_ = 1 << 20;
+    int cpu_ = -1;
+    int priority_ = 0;
+    std::vector<int> stageCpus_;
+    std::atomic<bool> running_{false};
+    mutable std::mutex errorMutex_;
+    std::string error_;
+    std::thread capture_;
+    std::thread monitor_;
+    StatsPage *stats_ = nullptr;
+    StatsMetric *recvMetric_ = nullptr;
+    StatsMetric *copyMetric_ = nullptr;
+    StatsMetric *publishMetric_ = nullptr;
+    std::vector<std::unique_ptr<Stage>> stages_;
+    std::chrono::steady_clock::time_point lastReport_;
+    uint64_t lastSamples_ = 0;
+};
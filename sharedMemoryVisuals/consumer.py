@@ -3,13 +3,18 @@ import ctypes
 import time
 import os
 import sys
-import posix_ipc
+from shmNotify import ShmNotifier
 
 SHM_NAME = "/live_data"
-SEM_NAME = "/semCtrl"
 QUEUE_SIZE = 1024
 TEXT_SIZE = 64
 
+# broadcast queue layout, mirrors broadcastQueue.h
+BQ_MAGIC = 0x51434242
+BQ_VERSION = 2
+BQ_MAX_CONSUMERS = 16
+BQ_POLICIES = {0: "block", 1: "drop-oldest", 2: "sample"}
+
 # Define structures using ctypes
 class QueueEntry(ctypes.Structure):
     _fields_ = [
@@ -17,12 +22,39 @@ class QueueEntry(ctypes.Structure):
         ("text", ctypes.c_char * TEXT_SIZE)
     ]
 
-class SharedQueue(ctypes.Structure):
+class BqSlot(ctypes.Structure):
+    _fields_ = [
+        ("seq", ctypes.c_uint64),
+        ("value", QueueEntry)
+    ]
+
+class BqConsumerInfo(ctypes.Structure):
+    _fields_ = [
+        ("pid", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+        ("cursor", ctypes.c_uint64),
+        ("dropped", ctypes.c_uint64),
+        ("pad", ctypes.c_uint8 * 40)
+    ]
+
+class BqHeader(ctypes.Structure):
     _fields_ = [
-        ("head", ctypes.c_size_t),
-        ("tail", ctypes.c_size_t),
-        ("count", ctypes.c_size_t),
-        ("entries", QueueEntry * QUEUE_SIZE)
+        ("magic", ctypes.c_uint32),
+        ("version", ctypes.c_uint32),
+        ("headerSize", ctypes.c_uint32),
+        ("capacity", ctypes.c_uint32),
+        ("entrySize", ctypes.c_uint32),
+        ("slotStride", ctypes.c_uint32),
+        ("policy", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+        ("pad", ctypes.c_uint8 * 32),
+        ("cursor", ctypes.c_uint64),
+        ("notifySeq", ctypes.c_uint32),
+        ("notifyWaiters", ctypes.c_uint32),
+        ("spaceSeq", ctypes.c_uint32),
+        ("spaceWaiters", ctypes.c_uint32),
+        ("pad2", ctypes.c_uint8 * 40),
+        ("consumers", BqConsumerInfo * BQ_MAX_CONSUMERS)
     ]
 
 def main():
@@ -31,7 +63,7 @@ def main():
     shm_fd = None
     for _ in range(10):  # Retry up to 10 times
         try:
-            shm_fd = os.open(f"/dev/shm{SHM_NAME}", os.O_RDWR)
+            shm_fd = os.open(f"/dev/shm{SHM_NAME}", os.O_RDONLY)
             break
         except FileNotFoundError:
             print(f"Waiting for shared memory {SHM_NAME} to be created...")
@@ -42,64 +74,63 @@ def main():
     if shm_fd is None:
         print(f"Failed to open shared memory {SHM_NAME} after retries.")
         sys.exit(1)
-    
-    # Map shared memory
-    shm = mmap.mmap(shm_fd, ctypes.sizeof(SharedQueue), mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
-
-    # Access shared memory as a structure
-    queue = SharedQueue.from_buffer(shm)
 
-    # Open semaphore
-    sem = None
-    for _ in range(10):  # Retry up to 10 times
-        try:
-            sem = posix_ipc.Semaphore(SEM_NAME, 0)
-            break
-        except posix_ipc.BusyError:
-            print(f"Waiting for semaphore {SEM_NAME} to be created...")
-            time.sleep(0.5)
-        except posix_ipc.ExistentialError:
-            print(f"Semaphore {SEM_NAME} does not exist.")
-            time.sleep(0.5)
-    
-    if sem is None:
-        print(f"Failed to open semaphore {SEM_NAME} after retries.")
-        shm.close()
-        os.close(shm_fd)
+    # Map shared memory read-only: this reader never modifies the queue, so
+    # any number of copies can run next to the C++ consumers. it does not
+    # register a cursor either, so it never holds back a blocking producer.
+    # only the waiter count next to notifySeq is written, to sleep on it
+    size = os.fstat(shm_fd).st_size
+    shm = mmap.mmap(shm_fd, size, mmap.MAP_SHARED, mmap.PROT_READ)
+    header = BqHeader.from_buffer_copy(shm, 0)
+    if header.magic != BQ_MAGIC or header.version != BQ_VERSION or header.entrySize != ctypes.sizeof(QueueEntry):
+        print(f"{SHM_NAME} is not a version {BQ_VERSION} queue of {ctypes.sizeof(QueueEntry)}-byte entries.")
         sys.exit(1)
-        
+    capacity = header.capacity
+
+    def cursor():
+        return ctypes.c_uint64.from_buffer_copy(shm, BqHeader.cursor.offset).value
+
+    notifier = ShmNotifier(f"/dev/shm{SHM_NAME}", BqHeader.notifySeq.offset)
+
+    def slot_offset(seq):
+        return header.headerSize + (seq % capacity) * header.slotStride
+
     print(f"Consumer started. PID: {os.getpid()}")
-    print(f"Shared memory {SHM_NAME} opened with size {ctypes.sizeof(SharedQueue)} bytes.")
-    print(f"Semaphore {SEM_NAME} opened.")
-    print(f"Queue size: {QUEUE_SIZE}, Text size: {TEXT_SIZE}")
-    print(f"Head: {queue.head}, Tail: {queue.tail}, Count: {queue.count}")
+    print(f"Shared memory {SHM_NAME} opened with size {size} bytes.")
+    print(f"Queue size: {capacity}, policy: {BQ_POLICIES.get(header.policy, header.policy)}")
     print("Waiting for data...")
 
-    # Continuously read from shared memory
+    # Continuously read from shared memory, starting at the newest entry
+    next_seq = cursor()
+    missed = 0
     try:
-        while queue.count > 0:
-            # Wait for semaphore
-            sem.acquire()
-
-            entry = queue.entries[queue.head]
+        while True:
+            published = cursor()
+            if next_seq >= published:
+                # sleep until the producer publishes, as the C++ consumers do
+                notifier.wait(lambda: cursor() > next_seq, 100)
+                continue
+            if published - next_seq > capacity:
+                missed += published - capacity - next_seq
+                next_seq = published - capacity
+            # copy the slot, then check its sequence did not move (seqlock)
+            offset = slot_offset(next_seq)
+            slot = BqSlot.from_buffer_copy(shm, offset)
+            seq_after = ctypes.c_uint64.from_buffer_copy(shm, offset).value
+            if slot.seq != 2 * next_seq + 2 or seq_after != slot.seq:
+                missed += 1
+                next_seq += 1
+                continue
+            entry = slot.value
             print(f"Timestamp: {entry.timestamp}, Text: {entry.text.decode('utf-8').rstrip(chr(0))}")
-            # Update head and count
-            queue.head = (queue.head + 1) % QUEUE_SIZE
-            queue.count -= 1
-
-            # Release semaphore
-            sem.release()
-            time.sleep(0.1)  # Avoid busy-waiting
+            next_seq += 1
     except KeyboardInterrupt:
-        print("Stopping consumer...")
-        shm.close()
-        os.close(shm_fd)
-        sem.close()
+        print(f"Stopping consumer, missed {missed} entries...")
     finally:
         # Cleanup
+        notifier.close()
         shm.close()
         os.close(shm_fd)
-        sem.close()
 
 if __name__ == "__main__":
-    main()
\ No newline at end of file
+    main()
@@ -0,0 +1,102 @@
+#pragma once
+// sample continuity on the capture path: every received block's timestamp is
+// checked against the previous block's timestamp plus its sample count
+//
+// a jump forward means samples never reached us (FIFO overrun, dropped USB
+// packets); a jump back means the device's counter restarted. either way the
+// block is tagged in its ring slot flags so stages doing coherent work can
+// restart their state, and the gap is counted. the check is one compare per
+// block; the counters are single writer (the capture thread) with relaxed
+// stores, read by the report whenever it likes.
+//
+// with GAP_ZERO_FILL the capture loop publishes zero blocks, tagged
+// IQ_BLOCK_FILLED, over a forward gap, so the ring's timeline has no holes
+// and sample n of a stage's input is still sample n of the stream. gaps
+// longer than maxFillSamples are only tagged: filling them would overwrite
+// the whole ring with zeros.
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// IqSlotHeader::flags
+#define IQ_BLOCK_GAP 0x1u                // samples missing right before this block
+#define IQ_BLOCK_SHORT 0x2u              // receive returned fewer samples than asked for
+#define IQ_BLOCK_RESTART 0x4u            // timestamp went backwards
+#define IQ_BLOCK_FILLED 0x8u             // zeros standing in for lost samples
+
+enum GapPolicy {
+    GAP_MARK,                            // tag the block after the gap
+    GAP_ZERO_FILL,                       // tag it and publish zeros over the gap
+};
+
+struct ContinuityStats {
+    std::atomic<uint64_t> blocks{0};
+    std::atomic<uint64_t> samples{0};    // received
+    std::atomic<uint64_t> gaps{0};
+    std::atomic<uint64_t> lostSamples{0}; // covered by forward gaps
+    std::atomic<uint64_t> maxGap{0};     // samples
+    std::atomic<uint64_t> restarts{0};
+    std::atomic<uint64_t> filledSamples{0};
+};
+
+class ContinuityChecker {
+public:
+    // flags for a block of count samples (asked for: asked) at timestamp;
+    // *gap is the number of samples missing in front of it
+    uint32_t check(uint64_t timestamp, uint32_t count, uint32_t asked, uint64_t *gap)
+    {
+        uint32_t flags = 0;
+        *gap = 0;
+        if (started_ && timestamp != next_) {
+            if (timestamp > next_) {
+                *gap = timestamp - next_;
+                flags |= IQ_BLOCK_GAP;
+                bump(stats.gaps, 1);
+                bump(stats.lostSamples, *gap);
+                if (*gap > stats.maxGap.load(std::memory_order_relaxed))
+                    stats.maxGap.store(*gap, std::memory_order_relaxed);
+            } else {
+                flags |= IQ_BLOCK_RESTART;
+                bump(stats.restarts, 1);
+            }
+        }
+        if (count < asked) flags |= IQ_BLOCK_SHORT;
+        started_ = true;
+        next_ = timestamp + count;
+        bump(stats.blocks, 1);
+        bump(stats.samples, count);
+        return flags;
+    }
+
+    void filled(uint64_t samples) { bump(stats.filledSamples, samples); }
+
+    // fraction of the stream's samples that never arrived
+    double lossRate() const
+    {
+        double lost = double(stats.lostSamples.load(std::memory_order_relaxed));
+        double total = lost + double(stats.samples.load(std::memory_order_relaxed));
+        return total > 0 ? lost / total : 0.0;
+    }
+
+    void report(std::ostream &os) const
+    {
+        os << "continuity: " << stats.gaps.load() << " gaps (" << stats.lostSamples.load() << " samples, max "
+           << stats.maxGap.load() << ", " << lossRate() * 1e6 << " ppm lost), " << stats.restarts.load()
+           << " restarts";
+        if (stats.filledSamples.load()) os << ", " << stats.filledSamples.load() << " samples zero-filled";
+        os << "\n";
+    }
+
+    ContinuityStats stats;
+
+private:
+    // single writer: relaxed load+store instead of a locked add
+    static void bump(std::atomic<uint64_t> &c, uint64_t n)
+    {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    bool started_ = false;
+    uint64_t next_ = 0;
+};
@@ -0,0 +1,86 @@
+// int16 -> float conversion throughput per kernel, and the relay path carrying
+// int16 versus float samples end to end (source -> ring -> reader -> floats)
+//
+// usage: convertBench [blocks]
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include "iqRing.h"
+#include "sampleConvert.h"
+#include "syntheticRxSource.h"
+
+#define BENCH_SHM_NAME "/limesuite_convert_bench"
+#define BLOCK_SAMPLES 1024
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void benchKernels(uint64_t blocks)
+{
+    std::vector<int16_t> in(2 * BLOCK_SAMPLES);
+    std::vector<float> out(2 * BLOCK_SAMPLES);
+    for (size_t i = 0; i < in.size(); ++i)
+        in[i] = int16_t((i * 37) % 4096 - 2048);
+
+    size_t count;
+    const I16ToF32Kernel *kernels = i16ToF32Kernels(&count);
+    for (size_t k = 0; k < count; ++k) {
+        if (!kernels[k].supported) continue;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t b = 0; b < blocks; ++b) {
+            kernels[k].fn(in.data(), out.data(), in.size(), 1.0f / LMS_I12_FULL_SCALE);
+            asm volatile("" : : "r"(out.data()) : "memory");
+        }
+        double seconds = secondsSince(start);
+        std::cout << "  " << kernels[k].name << ": " << double(blocks) * BLOCK_SAMPLES / seconds / 1e6
+                  << " MS/s, " << double(blocks) * in.size() * sizeof(int16_t) / seconds / 1e9 << " GB/s in" << std::endl;
+    }
+}
+
+// relay blocks through the ring and hand floats to a trivial consumer
+static void benchRelay(IqSampleFormat fmt, uint64_t blocks)
+{
+    float fullScale = fmt == IQ_FMT_I16 ? LMS_I12_FULL_SCALE : 1.0f;
+    IqRingWriter ring;
+    if (ring.create(BENCH_SHM_NAME, 256, BLOCK_SAMPLES, fmt, 30.72e6, fullScale) != 0) exit(1);
+    IqRingReader reader;
+    if (reader.open(BENCH_SHM_NAME) != 0) exit(1);
+    SyntheticRxSource source(30.72e6, 100e3, 0.5f, 0.01f, false, 1 << 16, fmt);
+
+    std::vector<uint8_t> block(BLOCK_SAMPLES * iqBytesPerSample(fmt));
+    std::vector<float> floats(2 * BLOCK_SAMPLES);
+    RxMeta meta;
+    IqBlockInfo info = {};
+    float sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t b = 0; b < blocks; ++b) {
+        int received = source.recv(ring.claim(), BLOCK_SAMPLES, &meta, 1000);
+        ring.publish(received, meta.timestamp);
+        reader.read(block.data(), BLOCK_SAMPLES, &info);
+        const float *f = reinterpret_cast<const float *>(block.data());
+        if (fmt == IQ_FMT_I16) {
+            i16ToF32(reinterpret_cast<const int16_t *>(block.data()), floats.data(), 2 * info.count, fullScale);
+            f = floats.data();
+        }
+        sink += f[b % (2 * BLOCK_SAMPLES)];
+    }
+    double seconds = secondsSince(start);
+    std::cout << "  " << (fmt == IQ_FMT_I16 ? "int16" : "float") << ": "
+              << double(blocks) * BLOCK_SAMPLES / seconds / 1e6 << " MS/s, "
+              << iqBytesPerSample(fmt) << " bytes/sample through shared memory (sink " << sink << ")" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t blocks = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    std::cout << "int16 -> float kernels (best: " << bestI16ToF32Kernel().name << ")" << std::endl;
+    benchKernels(blocks);
+    std::cout << "relay path" << std::endl;
+    benchRelay(IQ_FMT_F32, blocks);
+    benchRelay(IQ_FMT_I16, blocks);
+    return 0;
+}
@@ -0,0 +1,235 @@
+// offline matched filter: correlates a recorded IQ file (SigMF from
+// IqRecorder, or raw with --rate/--f32) against the probe waveform on every
+// core and lists the echo per burst period, its lag, gain and correlation,
+// then the correlations/s. needs no LimeSDR.
+//
+// the reference is a tone burst (step1's default probe), a linear chirp, the
+// multitone probe of step1 --multitone, or raw cf32 samples from a file.
+// --synthetic builds its own stream instead: bursts of the reference every
+// period with a known fractional delay, gain and noise, and checks that the
+// echoes come back where they were put.
+//
+// usage: correlator <recording> [--rate <Hz>] [--f32] [--tone <Hz>] [--chirp <f0> <f1>] [--multitone]
+//                   [--reference <file.cf32>] [--burst <samples>] [--period <samples>] [--fft <size>]
+//                   [--workers <n>] [--min-coef <c>] [--quiet]
+//        correlator --synthetic [delay samples] [same reference options]
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "matchedFilter.h"
+#include "multitoneProbe.h"
+#include "replayRxSource.h"
+#include "sampleConvert.h"
+#include "threadAffinity.h"
+#include "waveform.h"
+
+#define BLOCK_SAMPLES 16384
+
+struct ReferenceOptions {
+    double toneHz = 100e3;
+    double chirpF0 = 0, chirpF1 = 0;
+    bool chirp = false;
+    bool multitone = false;
+    const char *file = nullptr;
+    size_t burst = 1024;
+};
+
+static std::vector<cfloat> buildReference(const ReferenceOptions &o, double sample_rate)
+{
+    if (o.file) {
+        std::ifstream in(o.file, std::ios::binary);
+        if (!in) {
+            std::cerr << "cannot open reference " << o.file << std::endl;
+            return {};
+        }
+        std::vector<cfloat> ref;
+        cfloat x;
+        while (in.read(reinterpret_cast<char *>(&x), sizeof(x)))
+            ref.push_back(x);
+        return ref;
+    }
+    if (o.multitone) {
+        // step1's probe: 100 tones every 2nd bin of 1024, one guard and 4 analysed periods
+        MultitoneProbe probe(1024, MultitoneProbe::comb(-100, 100, 2));
+        return probe.burst(5);
+    }
+    WaveformGenerator gen(sample_rate, o.burst);
+    if (o.chirp) gen.setChirp(o.chirpF0, o.chirpF1, o.burst / sample_rate, 0.7f);
+    else gen.setTone(o.toneHz, 0.7f);
+    std::vector<cfloat> ref(o.burst);
+    gen.fill(ref.data(), ref.size());
+    return ref;
+}
+
+// bursts of the reference every period, delayed by a fraction of a sample
+// through the FFT, gain 0.5, random phase, complex gaussian noise
+static std::vector<cfloat> syntheticStream(const std::vector<cfloat> &ref, uint64_t period, double delay,
+                                           size_t bursts)
+{
+    const size_t pad = 64;
+    size_t n = 1;
+    while (n < ref.size() + 2 * pad) n *= 2;
+    FftPlan plan(n);
+    std::vector<cfloat> shifted(n, 0.0f);
+    std::copy(ref.begin(), ref.end(), shifted.begin() + pad);
+    double frac = delay - std::floor(delay);
+    plan.execute(shifted.data());
+    for (size_t k = 0; k < n; ++k) {
+        double f = (k < n / 2 ? double(k) : double(k) - double(n)) / double(n);
+        shifted[k] *= std::polar(1.0f / float(n), float(-2 * M_PI * f * frac));
+    }
+    plan.inverse(shifted.data());
+
+    std::vector<cfloat> stream(bursts * period);
+    std::mt19937 rng(11);
+    std::normal_distribution<float> gauss(0.0f, 0.01f);
+    std::uniform_real_distribution<float> angle(-float(M_PI), float(M_PI));
+    for (cfloat &x : stream)
+        x = cfloat(gauss(rng), gauss(rng));
+    for (size_t b = 0; b < bursts; ++b) {
+        cfloat g = std::polar(0.5f, angle(rng));
+        int64_t at = int64_t(b * period) + int64_t(std::floor(delay)) - int64_t(pad);
+        for (size_t i = 0; i < n; ++i)
+            if (at + int64_t(i) >= 0 && at + int64_t(i) < int64_t(stream.size())) stream[at + i] += g * shifted[i];
+    }
+    return stream;
+}
+
+int main(int argc, char **argv)
+{
+    ReferenceOptions ref_opts;
+    const char *path = nullptr;
+    bool synthetic = false, quiet = false, f32 = false;
+    double delay = 150.3;
+    double rate = 30.72e6;
+    uint64_t period = 0;
+    size_t fft_size = 0;
+    unsigned workers = unsigned(onlineCpus());
+    float min_coef = 0.5f;
+    bool period_given = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--synthetic") == 0) {
+            synthetic = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') delay = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--f32") == 0) f32 = true;
+        else if (strcmp(argv[i], "--tone") == 0 && i + 1 < argc) ref_opts.toneHz = atof(argv[++i]);
+        else if (strcmp(argv[i], "--chirp") == 0 && i + 2 < argc) {
+            ref_opts.chirp = true;
+            ref_opts.chirpF0 = atof(argv[++i]);
+            ref_opts.chirpF1 = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--multitone") == 0) ref_opts.multitone = true;
+        else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc) ref_opts.file = argv[++i];
+        else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) ref_opts.burst = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+            period = strtoull(argv[++i], nullptr, 10);
+            period_given = true;
+        }
+        else if (strcmp(argv[i], "--fft") == 0 && i + 1 < argc) fft_size = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) workers = unsigned(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--min-coef") == 0 && i + 1 < argc) min_coef = float(atof(argv[++i]));
+        else if (strcmp(argv[i], "--quiet") == 0) quiet = true;
+        else if (argv[i][0] != '-' && !path) path = argv[i];
+        else {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (!path && !synthetic) {
+        std::cerr << "usage: " << argv[0] << " <recording> [--rate <Hz>] [--f32] [--tone <Hz>] [--chirp <f0> <f1>]"
+                  << " [--multitone] [--reference <file.cf32>] [--burst <samples>] [--period <samples>]"
+                  << " [--fft <size>] [--workers <n>] [--min-coef <c>] [--quiet]" << std::endl
+                  << "       " << argv[0] << " --synthetic [delay samples] [reference options]" << std::endl;
+        return 1;
+    }
+
+    ReplayRxSource replay;
+    std::vector<cfloat> stream;
+    if (synthetic) {
+        // step1's timing: 2 MSPS, a burst every 10 ms
+        rate = 2e6;
+        if (!period_given) period = 20000;
+        if (!period) {
+            std::cerr << "--synthetic needs a period" << std::endl;
+            return 1;
+        }
+    } else {
+        ReplayInfo info = {f32 ? IQ_FMT_F32 : IQ_FMT_I16, rate, 0, 0};
+        if (replay.open(path, info, false, false) != 0) return 1;
+        rate = replay.sampleRate();
+    }
+    std::vector<cfloat> reference = buildReference(ref_opts, rate);
+    if (reference.empty()) return 1;
+    if (synthetic) {
+        stream = syntheticStream(reference, period, delay, 200);
+    }
+
+    MatchedFilter filter(reference, fft_size ? fft_size : MatchedFilter::sizeFor(reference.size(), period));
+    if (period && filter.hop() > period)
+        std::cerr << "warning: segment hop " << filter.hop() << " is longer than the period " << period
+                  << ", bursts sharing a segment are missed; use a smaller --fft" << std::endl;
+    std::cout << "reference " << filter.referenceSamples() << " samples, FFT " << filter.fftSize() << ", hop "
+              << filter.hop() << ", " << workers << " workers, " << rate / 1e6 << " MSPS" << std::endl;
+
+    EchoTracker echoes(period, filter.referenceSamples(), min_coef, [&](const CorrelationPeak &e) {
+        if (!quiet)
+            std::cout << "  segment " << e.segment << ": lag " << e.position << " (" << e.position / rate * 1e6
+                      << " us), gain " << e.gain << ", coefficient " << e.coefficient << ", phase " << e.phase
+                      << std::endl;
+    });
+    ParallelMatchedFilter parallel(filter, workers, [&](const CorrelationPeak &p) { echoes.add(p); });
+
+    uint64_t samples = 0;
+    auto start = std::chrono::steady_clock::now();
+    if (synthetic) {
+        for (size_t i = 0; i < stream.size(); i += BLOCK_SAMPLES) {
+            size_t n = std::min<size_t>(BLOCK_SAMPLES, stream.size() - i);
+            parallel.push(stream.data() + i, n, i);
+            samples += n;
+        }
+    } else {
+        const size_t bytes = replay.format() == IQ_FMT_F32 ? sizeof(cfloat) : 2 * sizeof(int16_t);
+        std::vector<uint8_t> raw(BLOCK_SAMPLES * bytes);
+        std::vector<cfloat> block(BLOCK_SAMPLES);
+        RxMeta meta;
+        for (;;) {
+            int received = replay.recv(raw.data(), BLOCK_SAMPLES, &meta, 1000);
+            if (received <= 0) break;
+            const cfloat *iq = reinterpret_cast<const cfloat *>(raw.data());
+            if (replay.format() == IQ_FMT_I16) {
+                i16ToF32(reinterpret_cast<const int16_t *>(raw.data()), reinterpret_cast<float *>(block.data()),
+                         2 * size_t(received), LMS_I12_FULL_SCALE);
+                iq = block.data();
+            }
+            parallel.push(iq, size_t(received), meta.timestamp);
+            samples += uint64_t(received);
+        }
+    }
+    parallel.flush();
+    echoes.finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const MatchedStats &stats = parallel.stats();
+    EchoStats es = echoes.stats();
+    std::cout << es.echoes << " echoes above " << min_coef << ": lag " << es.meanLag << " +- " << es.lagStd
+              << " samples, gain " << es.meanGain << ", coefficient " << es.meanCoefficient << std::endl;
+    std::cout << samples << " samples in " << seconds << " s (" << samples / seconds / rate << "x real time): "
+              << stats.segments / seconds << " segments/s, " << stats.lags / seconds / 1e6
+              << " M correlations/s, " << stats.lags * double(filter.referenceSamples()) / seconds / 1e9
+              << " G complex MACs/s equivalent" << std::endl;
+    if (!synthetic) return 0;
+
+    bool ok = es.echoes == stream.size() / period && std::fabs(es.meanLag - delay) < 0.1 &&
+              std::fabs(es.meanGain - 0.5) < 0.02;
+    std::cout << (ok ? "echoes as expected" : "FAILED") << " (delay " << delay << ", gain 0.5)" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+// samples/s per core of the decimation chain for a range of total ratios,
+// fed with synthetic 12-bit IQ at 30.72 MSPS
+//
+// usage: decimBench [blocks]
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include "decimator.h"
+#include "syntheticRxSource.h"
+
+#define BLOCK_SAMPLES 1024
+
+int main(int argc, char **argv)
+{
+    uint64_t blocks = argc > 1 ? strtoull(argv[1], nullptr, 10) : 30000;
+    const double sample_rate = 30.72e6;
+    SyntheticRxSource source(sample_rate, 100e3, 0.5f, 0.01f, false, 1 << 16, IQ_FMT_I16);
+    std::vector<int16_t> block(2 * BLOCK_SAMPLES);
+    RxMeta meta;
+
+    for (unsigned ratio : {16u, 64u, 256u, 1024u, 4096u}) {
+        DecimatorConfig config = DecimatorChain::forRatio(sample_rate, 100e3, ratio);
+        DecimatorChain chain(config);
+        std::vector<std::complex<float>> out;
+        out.reserve(BLOCK_SAMPLES);
+        double busy = 0;
+        for (uint64_t b = 0; b < blocks; ++b) {
+            source.recv(block.data(), BLOCK_SAMPLES, &meta, 1000);
+            out.clear();
+            auto start = std::chrono::steady_clock::now();
+            chain.process(block.data(), BLOCK_SAMPLES, LMS_I12_FULL_SCALE, out);
+            busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        double rate = double(blocks) * BLOCK_SAMPLES / busy;
+        std::cout << "ratio " << chain.ratio() << " (CIC " << config.cicRatio << " x " << config.halfbands
+                  << " halfbands): " << rate / 1e6 << " MS/s per core, "
+                  << rate / sample_rate << "x real time at 30.72 MSPS" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,359 @@
+#pragma once
+// narrowband decimation chain for the measurement tone
+//
+//   IQ in -> mix tone to DC -> CIC (decimate by R) -> K halfband FIRs (2 each)
+//
+// the mixer runs 8 phase lanes so it has no serial dependency per sample,
+// the CIC integrates in 64-bit integers (exact, wraparound is harmless) and
+// the halfband stages use the polyphase form: only the even taps and the
+// centre tap are non-zero, so each output costs one short FIR on the even
+// input phase plus one multiply on the odd phase. the even-phase FIR is
+// vectorised across outputs with AVX2 where available.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "sampleConvert.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DECIMATOR_X86 1
+#endif
+
+// y[m] = sum_k taps[k] * x[m + k] for m < outputs
+typedef void (*CorrelateFn)(const float *x, const float *taps, size_t numTaps, float *y, size_t outputs);
+
+inline void correlateScalar(const float *x, const float *taps, size_t numTaps, float *y, size_t outputs)
+{
+    for (size_t m = 0; m < outputs; ++m) {
+        float acc = 0;
+        for (size_t k = 0; k < numTaps; ++k)
+            acc += taps[k] * x[m + k];
+        y[m] = acc;
+    }
+}
+
+#ifdef DECIMATOR_X86
+__attribute__((target("avx2,fma"))) inline void correlateAvx2(const float *x, const float *taps, size_t numTaps, float *y, size_t outputs)
+{
+    size_t m = 0;
+    for (; m + 16 <= outputs; m += 16) {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (size_t k = 0; k < numTaps; ++k) {
+            __m256 h = _mm256_broadcast_ss(taps + k);
+            acc0 = _mm256_fmadd_ps(h, _mm256_loadu_ps(x + m + k), acc0);
+            acc1 = _mm256_fmadd_ps(h, _mm256_loadu_ps(x + m + k + 8), acc1);
+        }
+        _mm256_storeu_ps(y + m, acc0);
+        _mm256_storeu_ps(y + m + 8, acc1);
+    }
+    correlateScalar(x + m, taps, numTaps, y + m, outputs - m);
+}
+#endif
+
+inline CorrelateFn bestCorrelate()
+{
+#ifdef DECIMATOR_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return correlateAvx2;
+#endif
+    return correlateScalar;
+}
+
+// complex mixer e^{-j 2 pi f n / fs}, phase continuous across calls
+class ToneMixer {
+public:
+    ToneMixer(double toneHz, double sampleRate) : step_(-2 * M_PI * toneHz / sampleRate) {}
+
+    // interleaved IQ in, planar re/im out
+    void mix(const float *iq, size_t n, float *re, float *im)
+    {
+        float lr[8], li[8];
+        for (int j = 0; j < 8; ++j) {
+            lr[j] = float(std::cos(phase_ + step_ * j));
+            li[j] = float(std::sin(phase_ + step_ * j));
+        }
+        const float sr = float(std::cos(8 * step_));
+        const float si = float(std::sin(8 * step_));
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            for (int j = 0; j < 8; ++j) {
+                float xr = iq[2 * (i + j)];
+                float xi = iq[2 * (i + j) + 1];
+                re[i + j] = xr * lr[j] - xi * li[j];
+                im[i + j] = xr * li[j] + xi * lr[j];
+                float nr = lr[j] * sr - li[j] * si;
+                li[j] = lr[j] * si + li[j] * sr;
+                lr[j] = nr;
+            }
+        }
+        // the lanes already sit at the phases of the last < 8 samples
+        for (size_t j = 0; i + j < n; ++j) {
+            float xr = iq[2 * (i + j)];
+            float xi = iq[2 * (i + j) + 1];
+            re[i + j] = xr * lr[j] - xi * li[j];
+            im[i + j] = xr * li[j] + xi * lr[j];
+        }
+        // lanes are rebuilt from the double phase every call, so float
+        // rounding in the recurrence never accumulates
+        phase_ = std::remainder(phase_ + step_ * n, 2 * M_PI);
+    }
+
+    // the phase of the sample at stream timestamp, as LockInBank anchors
+    // its references, so the output phase follows the timeline across gaps
+    void reset(uint64_t timestamp) { phase_ = std::remainder(step_ * double(timestamp), 2 * M_PI); }
+
+private:
+    double step_;
+    double phase_ = 0;
+};
+
+// CIC decimator, order N, ratio R, differential delay 1, on planar re/im
+class CicDecimator {
+public:
+    CicDecimator(unsigned ratio, unsigned order = 4)
+        : ratio_(ratio), order_(order), integ_(2 * order, 0), comb_(2 * order, 0)
+    {
+        gain_ = 1.0 / (std::pow(double(ratio), order) * CIC_INPUT_SCALE);
+    }
+
+    // returns the number of outputs written
+    size_t process(const float *re, const float *im, size_t n, float *outRe, float *outIm)
+    {
+        size_t out = 0;
+        int64_t *ir = &integ_[0];
+        int64_t *ii = &integ_[order_];
+        for (size_t i = 0; i < n; ++i) {
+            int64_t vr = int64_t(re[i] * CIC_INPUT_SCALE);
+            int64_t vi = int64_t(im[i] * CIC_INPUT_SCALE);
+            for (unsigned s = 0; s < order_; ++s) {
+                vr = ir[s] = int64_t(uint64_t(ir[s]) + uint64_t(vr));
+                vi = ii[s] = int64_t(uint64_t(ii[s]) + uint64_t(vi));
+            }
+            if (++phase_ < ratio_) continue;
+            phase_ = 0;
+            for (unsigned s = 0; s < order_; ++s) {
+                int64_t dr = int64_t(uint64_t(vr) - uint64_t(comb_[s]));
+                int64_t di = int64_t(uint64_t(vi) - uint64_t(comb_[order_ + s]));
+                comb_[s] = vr;
+                comb_[order_ + s] = vi;
+                vr = dr;
+                vi = di;
+            }
+            outRe[out] = float(vr * gain_);
+            outIm[out] = float(vi * gain_);
+            ++out;
+        }
+        return out;
+    }
+
+    unsigned ratio() const { return ratio_; }
+
+    void reset()
+    {
+        std::fill(integ_.begin(), integ_.end(), 0);
+        std::fill(comb_.begin(), comb_.end(), 0);
+        phase_ = 0;
+    }
+
+    // the largest ratio whose N*log2(R) bit growth fits the headroom
+    static unsigned maxRatio(unsigned order)
+    {
+        return unsigned(std::floor(std::pow(2.0, CIC_GROWTH_BITS / order)));
+    }
+
+private:
+    // inputs are |x| <= ~1.5, 2^24 keeps float precision and leaves
+    // 38 bits of headroom below int64 for the N*log2(R) bit growth
+    static constexpr double CIC_INPUT_SCALE = 16777216.0;
+    static constexpr double CIC_GROWTH_BITS = 38.0;
+
+    unsigned ratio_;
+    unsigned order_;
+    unsigned phase_ = 0;
+    double gain_;
+    std::vector<int64_t> integ_;
+    std::vector<int64_t> comb_;
+};
+
+// windowed-sinc halfband low-pass with 4*L-1 taps, decimating by 2
+class HalfbandDecimator {
+public:
+    explicit HalfbandDecimator(unsigned l = 8) : l_(l), evenTaps_(2 * l), correlate_(bestCorrelate())
+    {
+        // h[n] = 0.5 sinc(n/2) * blackman, n = -(2L-1)..(2L-1): zero at every
+        // even n except the centre. h is symmetric, so the even-phase taps
+        // need no reversal for the correlate kernel
+        int half = 2 * int(l) - 1;
+        double sum = 0;
+        std::vector<double> h(2 * half + 1);
+        for (int n = -half; n <= half; ++n) {
+            double w = 0.42 + 0.5 * std::cos(M_PI * n / (half + 1)) + 0.08 * std::cos(2 * M_PI * n / (half + 1));
+            double sinc = n == 0 ? 1.0 : std::sin(M_PI * n / 2) / (M_PI * n / 2);
+            h[n + half] = (n % 2 == 0 && n != 0) ? 0.0 : 0.5 * sinc * w;
+            sum += h[n + half];
+        }
+        // the odd n (even index into h) feed the even input phase
+        for (unsigned k = 0; k < 2 * l; ++k)
+            evenTaps_[k] = float(h[2 * k] / sum);
+        centre_ = float(h[half] / sum);
+        history_ = 2 * l - 1;
+    }
+
+    // planar in, planar out; returns outputs written (about n/2)
+    size_t process(const float *re, const float *im, size_t n, float *outRe, float *outIm)
+    {
+        size_t total = carried_ + n;
+        size_t outputs = total / 2;
+        reserve(outputs);
+        // split into even/odd phases after the kept history
+        for (size_t i = 0; i < n; ++i) {
+            size_t pos = carried_ + i;
+            size_t idx = history_ + pos / 2;
+            if (pos & 1) {
+                oddRe_[idx] = re[i];
+                oddIm_[idx] = im[i];
+            } else {
+                evenRe_[idx] = re[i];
+                evenIm_[idx] = im[i];
+            }
+        }
+        correlate_(evenRe_.data(), evenTaps_.data(), evenTaps_.size(), outRe, outputs);
+        correlate_(evenIm_.data(), evenTaps_.data(), evenTaps_.size(), outIm, outputs);
+        for (size_t m = 0; m < outputs; ++m) {
+            outRe[m] += centre_ * oddRe_[m + l_ - 1];
+            outIm[m] += centre_ * oddIm_[m + l_ - 1];
+        }
+        // keep the newest history_ pairs (and a dangling even sample)
+        size_t keep = history_ + (total & 1);
+        shift(evenRe_, outputs, keep);
+        shift(evenIm_, outputs, keep);
+        shift(oddRe_, outputs, history_);
+        shift(oddIm_, outputs, history_);
+        carried_ = total & 1;
+        return outputs;
+    }
+
+    // forget the history, the next input starts a new stream
+    void reset()
+    {
+        for (std::vector<float> *v : {&evenRe_, &evenIm_, &oddRe_, &oddIm_})
+            std::fill(v->begin(), v->end(), 0.0f);
+        carried_ = 0;
+    }
+
+private:
+    void reserve(size_t outputs)
+    {
+        size_t need = history_ + outputs + 1;
+        if (evenRe_.size() >= need) return;
+        evenRe_.resize(need);
+        evenIm_.resize(need);
+        oddRe_.resize(need);
+        oddIm_.resize(need);
+    }
+
+    static void shift(std::vector<float> &v, size_t consumed, size_t keep)
+    {
+        memmove(v.data(), v.data() + consumed, keep * sizeof(float));
+    }
+
+    unsigned l_;
+    std::vector<float> evenTaps_;
+    float centre_;
+    size_t history_;
+    size_t carried_ = 0;
+    CorrelateFn correlate_;
+    std::vector<float> evenRe_, evenIm_, oddRe_, oddIm_;
+};
+
+struct DecimatorConfig {
+    double sampleRate;
+    double toneHz;          // shifted to DC before filtering
+    unsigned cicRatio;
+    unsigned cicOrder;
+    unsigned halfbands;     // each halves the rate again
+    unsigned halfbandL;     // halfband length is 4*L-1
+};
+
+// total ratio cicRatio * 2^halfbands
+class DecimatorChain {
+public:
+    explicit DecimatorChain(const DecimatorConfig &config)
+        : config_(config), mixer_(config.toneHz, config.sampleRate), cic_(config.cicRatio, config.cicOrder)
+    {
+        for (unsigned i = 0; i < config.halfbands; ++i)
+            halfbands_.emplace_back(config.halfbandL);
+    }
+
+    // pick CIC ratio and halfband count for a total decimation ratio
+    static DecimatorConfig forRatio(double sampleRate, double toneHz, unsigned ratio, unsigned halfbands = 3)
+    {
+        while (halfbands > 0 && ratio % (1u << halfbands) != 0) --halfbands;
+        unsigned cic = ratio >> halfbands;
+        if (cic < 2 && halfbands > 0) {
+            --halfbands;
+            cic = ratio >> halfbands;
+        }
+        return {sampleRate, toneHz, cic, 4, halfbands, 8};
+    }
+
+    // a ratio the chain can realise: at least 1, with the CIC part left
+    // after the halfbands within its bit growth headroom
+    static bool supports(unsigned ratio, unsigned halfbands = 3)
+    {
+        if (ratio < 1) return false;
+        DecimatorConfig c = forRatio(1, 0, ratio, halfbands);
+        return c.cicRatio <= CicDecimator::maxRatio(c.cicOrder);
+    }
+
+    unsigned ratio() const { return config_.cicRatio << config_.halfbands; }
+    double outputRate() const { return config_.sampleRate / ratio(); }
+
+    // interleaved float IQ in; decimated samples are appended to out
+    void process(const float *iq, size_t n, std::vector<std::complex<float>> &out)
+    {
+        reserve(n);
+        mixer_.mix(iq, n, re_.data(), im_.data());
+        size_t m = cic_.process(re_.data(), im_.data(), n, re_.data(), im_.data());
+        for (auto &hb : halfbands_)
+            m = hb.process(re_.data(), im_.data(), m, re_.data(), im_.data());
+        for (size_t i = 0; i < m; ++i)
+            out.emplace_back(re_[i], im_[i]);
+    }
+
+    // CIC state and halfband history back to a fresh chain and the mixer
+    // to the phase of the next sample's timestamp, at the start of the
+    // stream and after a gap in the input
+    void reset(uint64_t timestamp)
+    {
+        mixer_.reset(timestamp);
+        cic_.reset();
+        for (auto &hb : halfbands_)
+            hb.reset();
+    }
+
+    // int16 IQ in, converted in place of the float path
+    void process(const int16_t *iq, size_t n, float fullScale, std::vector<std::complex<float>> &out)
+    {
+        if (floats_.size() < 2 * n) floats_.resize(2 * n);
+        i16ToF32(iq, floats_.data(), 2 * n, fullScale);
+        process(floats_.data(), n, out);
+    }
+
+private:
+    void reserve(size_t n)
+    {
+        if (re_.size() >= n) return;
+        re_.resize(n);
+        im_.resize(n);
+    }
+
+    DecimatorConfig config_;
+    ToneMixer mixer_;
+    CicDecimator cic_;
+    std::vector<HalfbandDecimator> halfbands_;
+    std::vector<float> re_, im_, floats_;
+};
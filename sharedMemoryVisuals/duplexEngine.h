@@ -0,0 +1,311 @@
+#pragma once
+// full-duplex probe engine: a TX thread sends the same burst every
+// periodSamples, scheduled on the RX sample clock, while an RX thread keeps
+// the receive stream drained and looks for each burst in a window starting
+// at its TX timestamp
+//
+// the RX thread publishes how far the stream has got (rxNow); the TX thread
+// hands each burst to the sink leadSamples ahead of that with
+// waitForTimestamp set, so the hardware starts it on an exact sample and the
+// host's scheduling jitter only eats into the lead. burst timestamps go to
+// the RX thread through a small SPSC queue. there an energy detector (power
+// thresholdDb above a running noise floor) finds the leading edge; edge
+// minus TX timestamp is the TX -> RX latency and its change from one burst
+// to the next the jitter, both kept in HDR histograms (statsPage.h), in the
+// stats page when one is attached.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "asyncLog.h"
+#include "iqCorrection.h"
+#include "rxSource.h"
+#include "statsPage.h"
+#include "txSink.h"
+#include "waveform.h"
+
+#define DUPLEX_QUEUE_SIZE 64             // bursts in flight between TX and RX, power of two
+
+struct DuplexConfig {
+    double sampleRate;
+    uint32_t periodSamples;              // burst start to burst start
+    uint32_t leadSamples;                // how far ahead of the RX clock bursts are queued
+    uint32_t windowSamples;              // RX search window after each TX timestamp
+    uint32_t blockSamples = 1024;        // per receive call
+    float thresholdDb = 15.0f;           // detection level above the noise floor
+    bool alignBursts = false;            // bursts on multiples of periodSamples of the RX clock
+};
+
+// sees every received block on the RX thread, after the detector
+typedef std::function<void(const std::complex<float> *samples, size_t count, uint64_t timestamp)> DuplexRxFn;
+
+struct DuplexStats {
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> skipped{0};    // host fell behind, burst time already passed
+    std::atomic<uint64_t> detected{0};
+    std::atomic<uint64_t> missed{0};     // nothing above threshold in the window
+    std::atomic<uint64_t> rxSamples{0};
+};
+
+class DuplexEngine {
+public:
+    DuplexEngine(RxSource *rx, TxSink *tx, const DuplexConfig &config) : rx_(rx), tx_(tx), cfg_(config) {}
+    ~DuplexEngine() { stop(); }
+
+    // complex float samples sent as each burst
+    void setBurst(const std::vector<std::complex<float>> &burst) { burst_ = burst; }
+
+    // or refill the burst from a generator before every send, so the
+    // waveform carries on from one burst to the next (burstSamples each)
+    void setWaveform(WaveformGenerator *waveform, size_t burstSamples)
+    {
+        waveform_ = waveform;
+        burst_.assign(burstSamples, {});
+    }
+
+    // further RX processing, e.g. channel estimation on the bursts; call before start()
+    void setRxTap(DuplexRxFn fn) { rxTap_ = fn; }
+
+    // take DC and IQ imbalance out of every RX block before the detector and
+    // the tap see it; used on the RX thread only, call before start()
+    void setRxCorrection(IqCorrector *corrector) { corrector_ = corrector; }
+
+    // export the histograms, call before start()
+    void setStats(StatsPage *stats) { page_ = stats; }
+
+    int start()
+    {
+        if (burst_.empty() || cfg_.periodSamples < burst_.size()) {
+            setError("burst empty or longer than the period");
+            return -1;
+        }
+        latency_ = page_ ? page_->addMetric("duplex:tx2rx") : nullptr;
+        jitter_ = page_ ? page_->addMetric("duplex:jitter") : nullptr;
+        slack_ = page_ ? page_->addMetric("duplex:txslack") : nullptr;
+        if (!latency_) latency_ = &local_[0];
+        if (!jitter_) jitter_ = &local_[1];
+        if (!slack_) slack_ = &local_[2];
+        running_ = true;
+        rxThread_ = std::thread([this] { rxLoop(); });
+        txThread_ = std::thread([this] { txLoop(); });
+        return 0;
+    }
+
+    void stop()
+    {
+        running_ = false;
+        if (txThread_.joinable()) txThread_.join();
+        if (rxThread_.joinable()) rxThread_.join();
+    }
+
+    bool running() const { return running_; }
+    // the first error, set by the TX or RX thread
+    std::string error() const
+    {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        return error_;
+    }
+    const DuplexStats &stats() const { return stats_; }
+
+    void report(std::ostream &os) const
+    {
+        double usPerSample = 1e6 / cfg_.sampleRate;
+        auto us = [](uint64_t ns) { return ns * 1e-3; };
+        uint64_t n = stats_.detected.load();
+        double mean = n ? latencySum_ / n : 0;
+        double sd = n ? std::sqrt(std::max(0.0, latencySq_ / n - mean * mean)) : 0;
+        os << "duplex: " << stats_.sent.load() << " bursts sent, " << stats_.skipped.load() << " skipped, "
+           << tx_->late() << " late at the device, " << n << " detected, " << stats_.missed.load() << " missed\n";
+        os << "  tx->rx latency: p50 " << us(statsPercentile(*latency_, 0.5)) << " us, p99 "
+           << us(statsPercentile(*latency_, 0.99)) << " us, max " << us(latency_->latencyMax.load()) << " us, mean "
+           << mean * usPerSample << " us (" << mean << " samples), sd " << sd << " samples\n";
+        os << "  burst to burst jitter: p50 " << us(statsPercentile(*jitter_, 0.5)) << " us, p99 "
+           << us(statsPercentile(*jitter_, 0.99)) << " us, max " << us(jitter_->latencyMax.load()) << " us\n";
+        os << "  tx lead left after send: p1 " << us(statsPercentile(*slack_, 0.01)) << " us, p50 "
+           << us(statsPercentile(*slack_, 0.5)) << " us\n";
+    }
+
+private:
+    // both threads may fail; the first error is the one reported
+    void setError(const std::string &error)
+    {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        if (error_.empty()) error_ = error;
+    }
+
+    // burst queue, TX thread pushes and RX thread pops
+    bool pushBurst(uint64_t at)
+    {
+        uint64_t h = qHead_.load(std::memory_order_relaxed);
+        if (h - qTail_.load(std::memory_order_acquire) == DUPLEX_QUEUE_SIZE) return false;
+        queue_[h & (DUPLEX_QUEUE_SIZE - 1)] = at;
+        qHead_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool popBurst(uint64_t *at)
+    {
+        uint64_t t = qTail_.load(std::memory_order_relaxed);
+        if (t == qHead_.load(std::memory_order_acquire)) return false;
+        *at = queue_[t & (DUPLEX_QUEUE_SIZE - 1)];
+        qTail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    void txLoop()
+    {
+        logAttachThread();
+        TxMeta meta = {0, true, true};
+        uint64_t next = 0;
+        while (running_) {
+            uint64_t now = rxNow_.load(std::memory_order_acquire);
+            if (!now) {
+                // RX clock not running yet
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            if (!next) {
+                next = now + cfg_.leadSamples;
+                if (cfg_.alignBursts) next = (next + cfg_.periodSamples - 1) / cfg_.periodSamples * cfg_.periodSamples;
+            }
+            if (next > now + cfg_.leadSamples) {
+                double wait = (next - now - cfg_.leadSamples) / cfg_.sampleRate;
+                std::this_thread::sleep_for(std::chrono::duration<double>(std::min(wait, 0.01)));
+                continue;
+            }
+            if (next <= now) {
+                stats_.skipped.fetch_add(1, std::memory_order_relaxed);
+                ALOG_RATE(LOG_WARN, 1, "duplex: burst at {} skipped, rx clock already at {}", next, now);
+                next += cfg_.periodSamples;
+                continue;
+            }
+            if (!pushBurst(next)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            meta.timestamp = next;
+            if (waveform_) waveform_->fill(burst_.data(), burst_.size());
+            if (tx_->send(burst_.data(), burst_.size(), &meta, 1000) < 0) {
+                setError(tx_->lastError());
+                running_ = false;
+                break;
+            }
+            stats_.sent.fetch_add(1, std::memory_order_relaxed);
+            uint64_t after = rxNow_.load(std::memory_order_acquire);
+            slack_->record(next > after ? uint64_t((next - after) * 1e9 / cfg_.sampleRate) : 0);
+            next += cfg_.periodSamples;
+        }
+    }
+
+    void rxLoop()
+    {
+        std::vector<std::complex<float>> block(cfg_.blockSamples);
+        const float factor = std::pow(10.0f, cfg_.thresholdDb / 10);
+        const double nsPerSample = 1e9 / cfg_.sampleRate;
+        RxMeta meta;
+        uint64_t burstAt = 0, quietFrom = 0;
+        bool waiting = false;
+        double noise = 0;
+        int64_t lastLatency = -1;
+        // running noise floor from samples outside any burst
+        auto updateNoise = [&](const std::complex<float> *x, uint64_t t, size_t count) {
+            if (t + count <= quietFrom) return;
+            size_t skip = t < quietFrom ? size_t(quietFrom - t) : 0;
+            double sum = 0;
+            for (size_t i = skip; i < count; ++i)
+                sum += std::norm(x[i]);
+            double mean = sum / (count - skip);
+            noise = noise > 0 ? 0.9 * noise + 0.1 * mean : mean;
+        };
+        while (running_) {
+            int received = rx_->recv(block.data(), cfg_.blockSamples, &meta, 1000);
+            if (received < 0) {
+                setError(rx_->lastError());
+                running_ = false;
+                break;
+            }
+            if (corrector_ && received > 0) {
+                float *iq = reinterpret_cast<float *>(block.data());
+                corrector_->process(iq, iq, received);
+            }
+            uint64_t t0 = meta.timestamp;
+            rxNow_.store(t0 + received, std::memory_order_release);
+            stats_.rxSamples.fetch_add(received, std::memory_order_relaxed);
+            size_t i = 0;
+            while (i < size_t(received)) {
+                uint64_t t = t0 + i;
+                if (!waiting && !(waiting = popBurst(&burstAt))) {
+                    updateNoise(&block[i], t, received - i);
+                    break;
+                }
+                if (t < burstAt) {
+                    size_t k = size_t(std::min<uint64_t>(received - i, burstAt - t));
+                    updateNoise(&block[i], t, k);
+                    i += k;
+                    continue;
+                }
+                uint64_t windowEnd = burstAt + cfg_.windowSamples;
+                if (t >= windowEnd) {
+                    stats_.missed.fetch_add(1, std::memory_order_relaxed);
+                    quietFrom = windowEnd;
+                    waiting = false;
+                    continue;
+                }
+                size_t k = size_t(std::min<uint64_t>(received - i, windowEnd - t));
+                float threshold = float(noise * factor);
+                size_t j = i;
+                while (j < i + k && std::norm(block[j]) <= threshold) ++j;
+                if (j == i + k || noise <= 0) {
+                    i += k;
+                    continue;
+                }
+                // leading edge found
+                int64_t latency = int64_t(t0 + j - burstAt);
+                latency_->record(uint64_t(latency * nsPerSample));
+                if (lastLatency >= 0)
+                    jitter_->record(uint64_t(std::llabs(latency - lastLatency) * nsPerSample));
+                latencySum_ += latency;
+                latencySq_ += double(latency) * latency;
+                lastLatency = latency;
+                stats_.detected.fetch_add(1, std::memory_order_relaxed);
+                quietFrom = t0 + j + burst_.size();
+                waiting = false;
+                i = j + 1;
+            }
+            if (rxTap_) rxTap_(block.data(), received, t0);
+        }
+    }
+
+    RxSource *rx_;
+    TxSink *tx_;
+    DuplexConfig cfg_;
+    std::vector<std::complex<float>> burst_;
+    WaveformGenerator *waveform_ = nullptr;
+    DuplexRxFn rxTap_;
+    IqCorrector *corrector_ = nullptr;
+    StatsPage *page_ = nullptr;
+    StatsMetric local_[3]{};             // histograms when no page is attached
+    StatsMetric *latency_ = nullptr;
+    StatsMetric *jitter_ = nullptr;
+    StatsMetric *slack_ = nullptr;
+    double latencySum_ = 0;              // samples, RX thread only
+    double latencySq_ = 0;
+    DuplexStats stats_;
+    std::atomic<uint64_t> rxNow_{0};     // timestamp just past the last received sample
+    uint64_t queue_[DUPLEX_QUEUE_SIZE];
+    alignas(64) std::atomic<uint64_t> qHead_{0};
+    alignas(64) std::atomic<uint64_t> qTail_{0};
+    std::atomic<bool> running_{false};
+    mutable std::mutex errorMutex_;
+    std::string error_;
+    std::thread rxThread_;
+    std::thread txThread_;
+};
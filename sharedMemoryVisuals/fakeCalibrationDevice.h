@@ -0,0 +1,74 @@
+#pragma once
+// device-free CalibrationDevice, to exercise the calibration cache
+//
+// calibrate() costs calibrateMs of wall time (a real LMS_Calibrate takes
+// seconds) and produces a made-up register state; saveConfig/loadConfig
+// write and read it as a small text file, so a load only succeeds on a file
+// this device wrote. temperature is whatever the caller last set.
+
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include "calibrationCache.h"
+
+class FakeCalibrationDevice : public CalibrationDevice {
+public:
+    FakeCalibrationDevice(const std::string &serial, double celsius = 40.0, unsigned calibrateMs = 1500,
+                          unsigned loadMs = 20)
+        : serial_(serial), celsius_(celsius), calibrateMs_(calibrateMs), loadMs_(loadMs) {}
+
+    void setTemperature(double celsius) { celsius_ = celsius; }
+
+    std::string serial() override { return serial_; }
+
+    int temperature(double *celsius) override
+    {
+        *celsius = celsius_;
+        return 0;
+    }
+
+    int calibrate(double bandwidthHz) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(calibrateMs_));
+        state_ = uint64_t(bandwidthHz) ^ uint64_t(celsius_ * 1000) ^ ++calibrations_;
+        return 0;
+    }
+
+    int saveConfig(const std::string &path) override
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << "fake " << serial_ << " " << state_ << "\n";
+        if (!out) {
+            error_ = "cannot write " + path;
+            return -1;
+        }
+        return 0;
+    }
+
+    int loadConfig(const std::string &path) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(loadMs_));
+        std::ifstream in(path);
+        std::string tag, serial;
+        uint64_t state;
+        if (!(in >> tag >> serial >> state) || tag != "fake" || serial != serial_) {
+            error_ = "not a config of this device: " + path;
+            return -1;
+        }
+        state_ = state;
+        return 0;
+    }
+
+    const char *lastError() const override { return error_.c_str(); }
+
+    unsigned calibrations() const { return calibrations_; }
+
+private:
+    std::string serial_;
+    double celsius_;
+    unsigned calibrateMs_;
+    unsigned loadMs_;
+    uint64_t state_ = 0;
+    unsigned calibrations_ = 0;
+    std::string error_;
+};
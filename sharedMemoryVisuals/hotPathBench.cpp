@@ -0,0 +1,439 @@
+// Google Benchmark microbenchmarks for the capture hot path: sample format
+// conversion, ring push/pop, power estimation, tone generation and
+// detection and the cost of logging from the capture loop.
+// every benchmark reports bytes/s and items/s, items being IQ samples
+//
+// usage: hotPathBench [--benchmark_filter=<regex>] (or: cmake --build . --target bench)
+
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "asyncLog.h"
+#include "iqRing.h"
+#include "sampleConvert.h"
+#include "powerMeter.h"
+#include "decimator.h"
+#include "iqCorrection.h"
+#include "lockIn.h"
+#include "matchedFilter.h"
+#include "multitoneProbe.h"
+#include "syntheticRxSource.h"
+#include "waveform.h"
+
+#define BENCH_SHM_NAME "/limesuite_hotpath_bench"
+
+static std::vector<int16_t> i12Block(size_t samples)
+{
+    std::vector<int16_t> v(2 * samples);
+    for (size_t i = 0; i < v.size(); ++i)
+        v[i] = int16_t((i * 37) % 4096 - 2048);
+    return v;
+}
+
+static std::vector<float> f32Block(size_t samples)
+{
+    std::vector<float> v(2 * samples);
+    for (size_t i = 0; i < v.size(); ++i)
+        v[i] = float((i * 37) % 4096) / 2048.0f - 1.0f;
+    return v;
+}
+
+static void setRates(benchmark::State &state, size_t samples, size_t bytesPerSample)
+{
+    state.SetItemsProcessed(int64_t(state.iterations()) * samples);
+    state.SetBytesProcessed(int64_t(state.iterations()) * samples * bytesPerSample);
+}
+
+// --- sample format conversion: int16 in, float out, per kernel ---
+
+static void BM_I16ToF32(benchmark::State &state, I16ToF32Fn fn, bool supported)
+{
+    if (!supported) {
+        state.SkipWithError("kernel not supported on this CPU");
+        return;
+    }
+    size_t samples = state.range(0);
+    std::vector<int16_t> in = i12Block(samples);
+    std::vector<float> out(2 * samples);
+    for (auto _ : state) {
+        fn(in.data(), out.data(), in.size(), 1.0f / LMS_I12_FULL_SCALE);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    setRates(state, samples, 2 * sizeof(int16_t));
+}
+
+static void registerConvert()
+{
+    size_t count;
+    const I16ToF32Kernel *kernels = i16ToF32Kernels(&count);
+    for (size_t k = 0; k < count; ++k)
+        benchmark::RegisterBenchmark((std::string("BM_I16ToF32/") + kernels[k].name).c_str(), BM_I16ToF32,
+                                     kernels[k].fn, kernels[k].supported)
+            ->Arg(1024)->Arg(16384);
+}
+
+// --- ring: one block written and read back per iteration ---
+
+template <IqSampleFormat FMT>
+static void BM_RingCopy(benchmark::State &state)
+{
+    uint32_t samples = uint32_t(state.range(0));
+    IqRingWriter writer;
+    IqRingReader reader;
+    if (writer.create(BENCH_SHM_NAME, 256, samples, FMT, 30.72e6) != 0 || reader.open(BENCH_SHM_NAME) != 0) {
+        state.SkipWithError("cannot create the ring");
+        return;
+    }
+    size_t bytes = size_t(samples) * iqBytesPerSample(FMT);
+    std::vector<uint8_t> in(bytes, 1), out(bytes);
+    IqBlockInfo info = {};
+    uint64_t ts = 0;
+    for (auto _ : state) {
+        writer.write(in.data(), samples, ts);
+        ts += samples;
+        reader.read(out.data(), samples, &info);
+        benchmark::DoNotOptimize(out.data());
+    }
+    setRates(state, samples, iqBytesPerSample(FMT));
+    reader.close();
+    writer.close();
+}
+BENCHMARK_TEMPLATE(BM_RingCopy, IQ_FMT_I16)->Arg(1024)->Arg(8192);
+BENCHMARK_TEMPLATE(BM_RingCopy, IQ_FMT_F32)->Arg(1024)->Arg(8192);
+
+// zero-copy claim/publish as the capture thread does it, source fills the slot
+static void BM_RingZeroCopy(benchmark::State &state)
+{
+    uint32_t samples = uint32_t(state.range(0));
+    IqRingWriter writer;
+    IqRingReader reader;
+    if (writer.create(BENCH_SHM_NAME, 256, samples, IQ_FMT_I16, 30.72e6, LMS_I12_FULL_SCALE) != 0 ||
+        reader.open(BENCH_SHM_NAME) != 0) {
+        state.SkipWithError("cannot create the ring");
+        return;
+    }
+    SyntheticRxSource source(30.72e6, 100e3, 0.5f, 0.01f, false, 1 << 16, IQ_FMT_I16);
+    std::vector<int16_t> out(2 * samples);
+    IqBlockInfo info = {};
+    RxMeta meta;
+    for (auto _ : state) {
+        source.recv(writer.claim(), samples, &meta, 0);
+        writer.publish(samples, meta.timestamp);
+        reader.read(out.data(), samples, &info);
+        benchmark::DoNotOptimize(out.data());
+    }
+    setRates(state, samples, 2 * sizeof(int16_t));
+    reader.close();
+    writer.close();
+}
+BENCHMARK(BM_RingZeroCopy)->Arg(1024)->Arg(8192);
+
+// --- power estimation ---
+
+static void BM_PowerI16(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<int16_t> in = i12Block(samples);
+    PowerMeter meter(30.72e6);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(meter.process(in.data(), uint32_t(samples), IQ_FMT_I16, LMS_I12_FULL_SCALE));
+    setRates(state, samples, 2 * sizeof(int16_t));
+    state.SetLabel(meter.kernelName());
+}
+BENCHMARK(BM_PowerI16)->Arg(1024)->Arg(16384);
+
+static void BM_PowerF32(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<float> in = f32Block(samples);
+    PowerMeter meter(30.72e6);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(meter.process(in.data(), uint32_t(samples), IQ_FMT_F32, 1.0f));
+    setRates(state, samples, 2 * sizeof(float));
+    state.SetLabel(meter.kernelName());
+}
+BENCHMARK(BM_PowerF32)->Arg(1024)->Arg(16384);
+
+// --- DC / IQ imbalance correction ---
+
+// conversion, correction and the moments for the next block in one pass
+static void BM_IqCorrectI16(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<int16_t> in = i12Block(samples);
+    std::vector<float> out(2 * samples);
+    IqCorrector corrector;
+    for (auto _ : state) {
+        corrector.process(in.data(), out.data(), samples, LMS_I12_FULL_SCALE);
+        benchmark::DoNotOptimize(out.data());
+    }
+    setRates(state, samples, 2 * sizeof(int16_t));
+    state.SetLabel(corrector.kernelName());
+}
+BENCHMARK(BM_IqCorrectI16)->Arg(1024)->Arg(16384);
+
+static void BM_IqCorrectF32(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<float> in = f32Block(samples);
+    std::vector<float> out(2 * samples);
+    IqCorrector corrector;
+    for (auto _ : state) {
+        corrector.process(in.data(), out.data(), samples);
+        benchmark::DoNotOptimize(out.data());
+    }
+    setRates(state, samples, 2 * sizeof(float));
+    state.SetLabel(corrector.kernelName());
+}
+BENCHMARK(BM_IqCorrectF32)->Arg(1024)->Arg(16384);
+
+static void BM_IqCorrectScalar(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<int16_t> in = i12Block(samples);
+    std::vector<float> out(2 * samples);
+    static const IqCorrectKernels scalar = {"scalar", iqCorrectI16Scalar, iqCorrectF32Scalar};
+    IqCorrector corrector(1 << 20, scalar);
+    for (auto _ : state) {
+        corrector.process(in.data(), out.data(), samples, LMS_I12_FULL_SCALE);
+        benchmark::DoNotOptimize(out.data());
+    }
+    setRates(state, samples, 2 * sizeof(int16_t));
+}
+BENCHMARK(BM_IqCorrectScalar)->Arg(16384);
+
+// --- sine / tone generation ---
+
+// per-sample std::sin, as step1's transmit buffer is built
+static void BM_ToneStdSin(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<std::complex<float>> out(samples);
+    double t0 = 0;
+    for (auto _ : state) {
+        for (size_t i = 0; i < samples; ++i) {
+            double time = t0 + i / 2e6;
+            out[i] = std::complex<float>(std::sin(2 * M_PI * 100e3 * time), 0.0f);
+        }
+        t0 += samples / 2e6;
+        benchmark::DoNotOptimize(out.data());
+    }
+    setRates(state, samples, sizeof(std::complex<float>));
+}
+BENCHMARK(BM_ToneStdSin)->Arg(16384);
+
+// table-driven tone the synthetic source copies out
+template <IqSampleFormat FMT>
+static void BM_ToneTable(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    SyntheticRxSource source(30.72e6, 100e3, 0.5f, 0.01f, false, 1 << 16, FMT);
+    std::vector<uint8_t> out(samples * iqBytesPerSample(FMT));
+    RxMeta meta;
+    for (auto _ : state) {
+        source.recv(out.data(), samples, &meta, 0);
+        benchmark::DoNotOptimize(out.data());
+    }
+    setRates(state, samples, iqBytesPerSample(FMT));
+}
+BENCHMARK_TEMPLATE(BM_ToneTable, IQ_FMT_I16)->Arg(16384);
+BENCHMARK_TEMPLATE(BM_ToneTable, IQ_FMT_F32)->Arg(16384);
+
+// phase-accumulator NCO filling a reused TX buffer: one tone, an 8-tone sum
+// and a 1 ms linear chirp
+static void BM_NcoTone(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    WaveformGenerator wave(30.72e6, samples);
+    wave.setTone(100e3, 0.7f);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(wave.next(samples));
+    setRates(state, samples, sizeof(std::complex<float>));
+}
+BENCHMARK(BM_NcoTone)->Arg(16384);
+
+static void BM_NcoMultitone(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    WaveformGenerator wave(30.72e6, samples);
+    std::vector<double> hz;
+    for (int k = 1; k <= 8; ++k)
+        hz.push_back(k * 250e3);
+    wave.setMultitone(hz, std::vector<float>(8, 0.1f));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(wave.next(samples));
+    setRates(state, samples, sizeof(std::complex<float>));
+}
+BENCHMARK(BM_NcoMultitone)->Arg(16384);
+
+static void BM_NcoChirp(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    WaveformGenerator wave(30.72e6, samples);
+    wave.setChirp(-5e6, 5e6, 1e-3, 0.7f);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(wave.next(samples));
+    setRates(state, samples, sizeof(std::complex<float>));
+}
+BENCHMARK(BM_NcoChirp)->Arg(16384);
+
+// recurrence oscillator mixing a block down, as the DDC stage does
+static void BM_ToneMixer(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<float> in = f32Block(samples);
+    std::vector<float> re(samples), im(samples);
+    ToneMixer mixer(100e3, 30.72e6);
+    for (auto _ : state) {
+        mixer.mix(in.data(), samples, re.data(), im.data());
+        benchmark::DoNotOptimize(re.data());
+        benchmark::DoNotOptimize(im.data());
+    }
+    setRates(state, samples, 2 * sizeof(float));
+}
+BENCHMARK(BM_ToneMixer)->Arg(16384);
+
+// --- tone detection ---
+
+// lock-in bank over 16384 samples, arg is the number of tones
+static void BM_LockInBank(benchmark::State &state)
+{
+    const size_t samples = 16384;
+    std::vector<float> in = f32Block(samples);
+    std::vector<double> tones;
+    for (int64_t k = 0; k < state.range(0); ++k)
+        tones.push_back(100e3 + 50e3 * k);
+    LockInBank bank(tones, 30.72e6, 307200);
+    uint64_t timestamp = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bank.push(in.data(), samples, timestamp));
+        timestamp += samples;
+    }
+    setRates(state, samples, 2 * sizeof(float));
+    state.SetLabel(bank.kernelName());
+}
+BENCHMARK(BM_LockInBank)->Arg(1)->Arg(8)->Arg(32);
+
+// the scalar kernel alone, one group of 8 tones
+static void BM_LockInScalar(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<float> in = f32Block(samples);
+    LockInGroup group = {};
+    for (int k = 0; k < LOCKIN_LANES; ++k) {
+        group.pr[k] = 1.0f;
+        group.rr[k] = float(std::cos(2 * M_PI * (k + 1) * 1e-3));
+        group.ri[k] = float(std::sin(2 * M_PI * (k + 1) * 1e-3));
+    }
+    for (auto _ : state) {
+        lockInScalar(in.data(), samples, &group, 1);
+        benchmark::DoNotOptimize(group.ar);
+    }
+    setRates(state, samples, 2 * sizeof(float));
+}
+BENCHMARK(BM_LockInScalar)->Arg(16384);
+
+// multitone channel estimation on back-to-back bursts of 1 guard + 4 periods
+// of a 1024 point comb, arg is the (even) number of tones; points are tone
+// estimates, one per tone per burst
+static void BM_MultitoneEstimate(benchmark::State &state)
+{
+    const uint32_t fft = 1024, guard = 1, periods = 4;
+    int tones = int(state.range(0));
+    MultitoneProbe probe(fft, MultitoneProbe::comb(-tones / 2, tones / 2, 1));
+    MultitoneEstimator estimator(probe, fft * (guard + periods), guard, periods);
+    std::vector<cfloat> burst = probe.burst(guard + periods);
+    uint64_t timestamp = 0, points = 0;
+    for (auto _ : state) {
+        points += estimator.push(burst.data(), burst.size(), timestamp) * probe.tones();
+        timestamp += burst.size();
+    }
+    setRates(state, burst.size(), sizeof(cfloat));
+    state.counters["points"] = benchmark::Counter(double(points), benchmark::Counter::kIsRate);
+    state.counters["rejected"] = double(estimator.stats().rejected);
+}
+BENCHMARK(BM_MultitoneEstimate)->Arg(16)->Arg(100)->Arg(400);
+
+// --- matched filter ---
+
+// one overlap-save segment (FFT, multiply, inverse, peak search) against a
+// tone burst of arg samples; correlations are the lags the segment covers
+static void BM_MatchedFilter(benchmark::State &state)
+{
+    size_t length = state.range(0);
+    WaveformGenerator wave(2e6, length);
+    wave.setTone(100e3);
+    std::vector<cfloat> reference(length);
+    wave.fill(reference.data(), length);
+    MatchedFilter filter(reference);
+    MatchedScratch scratch;
+    filter.prepare(scratch);
+    std::vector<cfloat> segment(filter.fftSize());
+    wave.fill(segment.data(), segment.size());
+    uint64_t timestamp = 0;
+    for (auto _ : state) {
+        CorrelationPeak peak = filter.correlate(segment.data(), timestamp, scratch);
+        benchmark::DoNotOptimize(peak);
+        timestamp += filter.hop();
+    }
+    setRates(state, filter.hop(), sizeof(cfloat));
+    state.counters["correlations"] =
+        benchmark::Counter(double(state.iterations()) * filter.hop(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_MatchedFilter)->Arg(1024)->Arg(5120);
+
+// one capture loop iteration: copy a received block out, then log about it.
+// LOG_ENDL is the old std::cout << ... << std::endl per block (to /dev/null,
+// so this is the flush syscall without a terminal behind it)
+enum LogMode { LOG_NONE, LOG_ENDL, LOG_ASYNC, LOG_ASYNC_LIMITED };
+
+template <LogMode MODE>
+static void BM_CaptureLog(benchmark::State &state)
+{
+    size_t samples = state.range(0);
+    std::vector<int16_t> rx = i12Block(samples), out(2 * samples);
+    std::ofstream devNull("/dev/null");
+    FILE *sink = fopen("/dev/null", "w");
+    AsyncLogger::instance().setOutput(sink);
+    uint64_t block = 0, dropped = AsyncLogger::instance().dropped();
+    for (auto _ : state) {
+        memcpy(out.data(), rx.data(), out.size() * sizeof(int16_t));
+        benchmark::DoNotOptimize(out.data());
+        if (MODE == LOG_ENDL)
+            devNull << "Received " << samples << " samples, block " << block << std::endl;
+        else if (MODE == LOG_ASYNC)
+            ALOG(LOG_INFO, "Received {} samples, block {}", samples, block);
+        else if (MODE == LOG_ASYNC_LIMITED)
+            ALOG_RATE(LOG_INFO, 1, "Received {} samples, block {}", samples, block);
+        // keep the per-thread ring from filling: format off the clock, as the
+        // log thread would between blocks
+        if (MODE >= LOG_ASYNC && (++block & 511) == 0) {
+            state.PauseTiming();
+            AsyncLogger::instance().flush();
+            state.ResumeTiming();
+        }
+    }
+    AsyncLogger::instance().flush();
+    AsyncLogger::instance().setOutput(stderr);
+    fclose(sink);
+    state.counters["dropped"] = double(AsyncLogger::instance().dropped() - dropped);
+    setRates(state, samples, 2 * sizeof(int16_t));
+}
+BENCHMARK_TEMPLATE(BM_CaptureLog, LOG_NONE)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_CaptureLog, LOG_ENDL)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_CaptureLog, LOG_ASYNC)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_CaptureLog, LOG_ASYNC_LIMITED)->Arg(1024);
+
+int main(int argc, char **argv)
+{
+    registerConvert();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
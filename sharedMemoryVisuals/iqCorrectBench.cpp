@@ -0,0 +1,131 @@
+// DC and IQ imbalance correction against a synthetic front end: a 100 kHz
+// tone plus noise goes through a known DC offset, gain and phase imbalance
+// and 12-bit quantisation, the corrector runs over it block by block, and
+// the estimates, the residual DC and the image rejection before and after
+// are checked. then the samples/s per core of every kernel, int16 and float.
+//
+// usage: iqCorrectBench [seconds of signal]
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "iqCorrection.h"
+#include "iqRing.h"
+
+#define BLOCK_SAMPLES 1024
+
+static const double sample_rate = 30.72e6;
+static const double tone_hz = 100e3;
+static const float full_scale = 2048.0f;
+
+struct Impairment {
+    double dcI, dcQ;
+    double gain;                         // Q over I, linear
+    double phaseDeg;
+};
+
+// tone at +tone_hz through the impairment, as 12-bit samples in int16
+static std::vector<int16_t> impairedTone(size_t pairs, const Impairment &imp)
+{
+    std::vector<int16_t> out(2 * pairs);
+    std::mt19937 rng(7);
+    std::normal_distribution<double> gauss(0.0, 0.003);
+    double phi = imp.phaseDeg * M_PI / 180;
+    for (size_t n = 0; n < pairs; ++n) {
+        double w = 2 * M_PI * tone_hz / sample_rate * double(n);
+        double i = 0.5 * std::cos(w) + gauss(rng), q = 0.5 * std::sin(w) + gauss(rng);
+        double ii = i + imp.dcI;
+        double qq = imp.gain * (q * std::cos(phi) - i * std::sin(phi)) + imp.dcQ;
+        out[2 * n] = int16_t(std::lround(std::max(-2048.0, std::min(2047.0, ii * full_scale))));
+        out[2 * n + 1] = int16_t(std::lround(std::max(-2048.0, std::min(2047.0, qq * full_scale))));
+    }
+    return out;
+}
+
+// power at +tone_hz over power at -tone_hz, and the mean, of float IQ
+static void measure(const float *iq, size_t pairs, double *irrDb, std::complex<double> *dc)
+{
+    std::complex<double> tone = 0, image = 0, sum = 0;
+    for (size_t n = 0; n < pairs; ++n) {
+        std::complex<double> x(iq[2 * n], iq[2 * n + 1]);
+        std::complex<double> ref = std::polar(1.0, -2 * M_PI * tone_hz / sample_rate * double(n));
+        tone += x * ref;
+        image += x * std::conj(ref);
+        sum += x;
+    }
+    *irrDb = 10 * std::log10(std::norm(tone) / std::max(std::norm(image), 1e-30));
+    *dc = sum / double(pairs);
+}
+
+static bool check(const char *what, double value, double expect, double tolerance)
+{
+    bool ok = std::fabs(value - expect) <= tolerance;
+    std::cout << "  " << what << ": " << value << " (expected " << expect << ")" << (ok ? "" : " UNEXPECTED")
+              << std::endl;
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    size_t blocks = size_t(seconds * sample_rate / BLOCK_SAMPLES);
+    Impairment imp = {0.04, -0.025, 1.06, 4.0};
+    std::vector<int16_t> input = impairedTone(blocks * BLOCK_SAMPLES, imp);
+    std::vector<float> raw(2 * BLOCK_SAMPLES), corrected(2 * BLOCK_SAMPLES);
+
+    // the last block, uncorrected and corrected
+    IqCorrector corrector;
+    for (size_t b = 0; b < blocks; ++b)
+        corrector.process(&input[2 * b * BLOCK_SAMPLES], corrected.data(), BLOCK_SAMPLES, full_scale);
+    // a whole number of tone cycles for the image measurement
+    size_t window = size_t(std::floor(BLOCK_SAMPLES * tone_hz / sample_rate) * sample_rate / tone_hz);
+    const int16_t *last = &input[2 * (blocks - 1) * BLOCK_SAMPLES];
+    for (size_t i = 0; i < 2 * BLOCK_SAMPLES; ++i)
+        raw[i] = last[i] / full_scale;
+    double irrBefore, irrAfter;
+    std::complex<double> dcBefore, dcAfter;
+    measure(raw.data(), window, &irrBefore, &dcBefore);
+    measure(corrected.data(), window, &irrAfter, &dcAfter);
+
+    IqImbalance est = corrector.estimate();
+    std::cout << "impairment: DC " << imp.dcI << ", " << imp.dcQ << ", gain " << 20 * std::log10(imp.gain)
+              << " dB, phase " << imp.phaseDeg << " deg; " << blocks << " blocks through the corrector" << std::endl;
+    bool ok = true;
+    ok &= check("DC I", est.dcI, imp.dcI, 0.002);
+    ok &= check("DC Q", est.dcQ, imp.dcQ, 0.002);
+    ok &= check("gain dB", est.gainDb, 20 * std::log10(imp.gain), 0.05);
+    ok &= check("phase deg", est.phaseDeg, imp.phaseDeg, 0.2);
+    std::cout << "  image rejection: " << irrBefore << " dB before, " << irrAfter << " dB after (estimated "
+              << est.imageRejectionDb << " dB before)" << std::endl;
+    std::cout << "  residual DC: " << std::abs(dcBefore) << " before, " << std::abs(dcAfter) << " after" << std::endl;
+    ok &= irrAfter > 50 && irrAfter > irrBefore + 20;
+    ok &= std::abs(dcAfter) < 0.002;
+
+    // throughput, the whole signal per kernel and format
+    std::vector<float> floats(input.size());
+    for (size_t i = 0; i < input.size(); ++i)
+        floats[i] = input[i] / full_scale;
+    static const IqCorrectKernels scalar = {"scalar", iqCorrectI16Scalar, iqCorrectF32Scalar};
+    for (const IqCorrectKernels *kernels : {&scalar, &bestIqCorrectKernels()}) {
+        IqCorrector c(1 << 20, *kernels);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t b = 0; b < blocks; ++b)
+            c.process(&input[2 * b * BLOCK_SAMPLES], corrected.data(), BLOCK_SAMPLES, full_scale);
+        double i16 = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        for (size_t b = 0; b < blocks; ++b)
+            c.process(&floats[2 * b * BLOCK_SAMPLES], &floats[2 * b * BLOCK_SAMPLES], BLOCK_SAMPLES);
+        double f32 = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double n = double(blocks) * BLOCK_SAMPLES;
+        std::cout << kernels->name << ": int16 " << n / i16 / 1e6 << " MS/s, float (in place) " << n / f32 / 1e6
+                  << " MS/s per core, " << n / std::max(i16, f32) / sample_rate << "x real time at 30.72 MSPS"
+                  << std::endl;
+        if (kernels == &scalar && &bestIqCorrectKernels() == &scalar) break;
+    }
+    std::cout << (ok ? "correction as expected" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
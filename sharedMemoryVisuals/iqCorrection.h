@@ -0,0 +1,259 @@
+#pragma once
+// blind DC-offset and IQ gain/phase imbalance correction, adapted per block
+//
+// the front end's imbalance is modelled as I' = I + dcI,
+// Q' = g (Q cos phi - I sin phi) + dcQ. for any signal whose I and Q have the
+// same power and no correlation (noise, tones off DC, anything circular),
+// the running means give dc, E[Q'^2] / E[I'^2] gives g^2 and E[I'Q'] gives
+// sin phi, so the inverse is one 2x2 matrix plus an offset:
+//   I = I' - dcI
+//   Q = c1 (I' - dcI) + c2 (Q' - dcQ),   c1 = tan phi, c2 = 1 / (g cos phi)
+// the kernels apply it and gather the block's first and second moments in
+// the same pass (with the int16 -> float conversion folded in), and the
+// moments move the estimates by an exponential average with a time constant
+// in samples, so the correction settles in a few time constants and follows
+// slow drift. the coefficients of a block are those estimated up to the end
+// of the previous one.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IQ_CORRECT_X86 1
+#endif
+
+#define IQ_CORRECT_CHUNK 4096            // pairs summed in float before moving to double
+
+struct IqCoeffs {
+    float kI;                            // I offset, -dcI
+    float c1, c2;                        // Q from I' and Q'
+    float kQ;                            // Q offset, -(c1 dcI + c2 dcQ)
+};
+
+// raw input moments of a block, full scale 1.0
+struct IqMoments {
+    double sx, sy, sxx, syy, sxy;
+};
+
+typedef void (*IqCorrectF32Fn)(const float *in, float *out, size_t pairs, const IqCoeffs &c, IqMoments *m);
+typedef void (*IqCorrectI16Fn)(const int16_t *in, float *out, size_t pairs, float scale, const IqCoeffs &c,
+                               IqMoments *m);
+
+inline void iqCorrectPair(float x, float y, float *out, const IqCoeffs &c, IqMoments *m)
+{
+    out[0] = x + c.kI;
+    out[1] = c.c1 * x + c.c2 * y + c.kQ;
+    m->sx += x;
+    m->sy += y;
+    m->sxx += x * x;
+    m->syy += y * y;
+    m->sxy += x * y;
+}
+
+inline void iqCorrectF32Scalar(const float *in, float *out, size_t pairs, const IqCoeffs &c, IqMoments *m)
+{
+    for (size_t i = 0; i < pairs; ++i)
+        iqCorrectPair(in[2 * i], in[2 * i + 1], out + 2 * i, c, m);
+}
+
+inline void iqCorrectI16Scalar(const int16_t *in, float *out, size_t pairs, float scale, const IqCoeffs &c,
+                               IqMoments *m)
+{
+    for (size_t i = 0; i < pairs; ++i)
+        iqCorrectPair(in[2 * i] * scale, in[2 * i + 1] * scale, out + 2 * i, c, m);
+}
+
+#ifdef IQ_CORRECT_X86
+// lanes alternate I, Q: the sums land in even (I) and odd (Q) lanes
+struct IqAvx2State {
+    __m256 a, b, k;                      // out = a * I' + b * Q' + k, per lane
+    __m256 s, sq, xy;
+};
+
+__attribute__((target("avx2,fma"))) inline void iqAvx2Setup(IqAvx2State &st, const IqCoeffs &c)
+{
+    st.a = _mm256_setr_ps(1, c.c1, 1, c.c1, 1, c.c1, 1, c.c1);
+    st.b = _mm256_setr_ps(0, c.c2, 0, c.c2, 0, c.c2, 0, c.c2);
+    st.k = _mm256_setr_ps(c.kI, c.kQ, c.kI, c.kQ, c.kI, c.kQ, c.kI, c.kQ);
+}
+
+// four pairs
+__attribute__((target("avx2,fma"))) inline void iqAvx2Step(IqAvx2State &st, __m256 v, float *out)
+{
+    __m256 vi = _mm256_moveldup_ps(v);   // I0 I0 I1 I1 ...
+    __m256 vq = _mm256_movehdup_ps(v);   // Q0 Q0 Q1 Q1 ...
+    _mm256_storeu_ps(out, _mm256_fmadd_ps(st.a, vi, _mm256_fmadd_ps(st.b, vq, st.k)));
+    st.s = _mm256_add_ps(st.s, v);
+    st.sq = _mm256_fmadd_ps(v, v, st.sq);
+    st.xy = _mm256_fmadd_ps(vi, vq, st.xy);
+}
+
+__attribute__((target("avx2,fma"))) inline void iqAvx2Flush(IqAvx2State &st, IqMoments *m)
+{
+    alignas(32) float s[8], sq[8], xy[8];
+    _mm256_store_ps(s, st.s);
+    _mm256_store_ps(sq, st.sq);
+    _mm256_store_ps(xy, st.xy);
+    for (int l = 0; l < 8; l += 2) {
+        m->sx += s[l];
+        m->sy += s[l + 1];
+        m->sxx += sq[l];
+        m->syy += sq[l + 1];
+        m->sxy += xy[l];                 // odd lanes hold the same products
+    }
+    st.s = st.sq = st.xy = _mm256_setzero_ps();
+}
+
+__attribute__((target("avx2,fma"))) inline void iqCorrectF32Avx2(const float *in, float *out, size_t pairs,
+                                                                 const IqCoeffs &c, IqMoments *m)
+{
+    IqAvx2State st;
+    iqAvx2Setup(st, c);
+    st.s = st.sq = st.xy = _mm256_setzero_ps();
+    size_t i = 0;
+    while (i + 4 <= pairs) {
+        size_t end = std::min(pairs & ~size_t(3), i + IQ_CORRECT_CHUNK);
+        for (; i < end; i += 4)
+            iqAvx2Step(st, _mm256_loadu_ps(in + 2 * i), out + 2 * i);
+        iqAvx2Flush(st, m);
+    }
+    iqCorrectF32Scalar(in + 2 * i, out + 2 * i, pairs - i, c, m);
+}
+
+__attribute__((target("avx2,fma"))) inline void iqCorrectI16Avx2(const int16_t *in, float *out, size_t pairs,
+                                                                 float scale, const IqCoeffs &c, IqMoments *m)
+{
+    IqAvx2State st;
+    iqAvx2Setup(st, c);
+    st.s = st.sq = st.xy = _mm256_setzero_ps();
+    const __m256 vscale = _mm256_set1_ps(scale);
+    size_t i = 0;
+    while (i + 4 <= pairs) {
+        size_t end = std::min(pairs & ~size_t(3), i + IQ_CORRECT_CHUNK);
+        for (; i < end; i += 4) {
+            __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * i));
+            __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(raw)), vscale);
+            iqAvx2Step(st, v, out + 2 * i);
+        }
+        iqAvx2Flush(st, m);
+    }
+    iqCorrectI16Scalar(in + 2 * i, out + 2 * i, pairs - i, scale, c, m);
+}
+#endif
+
+struct IqCorrectKernels {
+    const char *name;
+    IqCorrectI16Fn i16;
+    IqCorrectF32Fn f32;
+};
+
+inline const IqCorrectKernels &bestIqCorrectKernels()
+{
+    static const IqCorrectKernels scalar = {"scalar", iqCorrectI16Scalar, iqCorrectF32Scalar};
+#ifdef IQ_CORRECT_X86
+    static const IqCorrectKernels avx2 = {"avx2", iqCorrectI16Avx2, iqCorrectF32Avx2};
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return avx2;
+#endif
+    return scalar;
+}
+
+// the current estimate of the front end's impairments
+struct IqImbalance {
+    float dcI, dcQ;                      // full scale 1.0
+    float gainDb;                        // Q path over I path
+    float phaseDeg;                      // Q's departure from quadrature
+    float imageRejectionDb;              // what the uncorrected input achieves
+};
+
+class IqCorrector {
+public:
+    // timeConstantSamples sets how fast the estimates follow: ~34 ms at 30.72 MSPS by default
+    explicit IqCorrector(double timeConstantSamples = 1 << 20, const IqCorrectKernels &kernels = bestIqCorrectKernels())
+        : tau_(timeConstantSamples), kernels_(kernels)
+    {
+        coeffs_ = {0, 0, 1, 0};
+    }
+
+    // in and out may be the same buffer
+    void process(const float *in, float *out, size_t pairs)
+    {
+        IqMoments m = {0, 0, 0, 0, 0};
+        kernels_.f32(in, out, pairs, coeffs_, &m);
+        update(m, pairs);
+    }
+
+    // int16 input scaled by 1 / fullScale, corrected floats out
+    void process(const int16_t *in, float *out, size_t pairs, float fullScale)
+    {
+        IqMoments m = {0, 0, 0, 0, 0};
+        kernels_.i16(in, out, pairs, 1.0f / fullScale, coeffs_, &m);
+        update(m, pairs);
+    }
+
+    IqImbalance estimate() const
+    {
+        double g = pQQ_ > 0 && pII_ > 0 ? std::sqrt(pQQ_ / pII_) : 1.0;
+        double s = sinPhi();
+        double c = std::sqrt(1 - s * s);
+        // image rejection of the uncorrected path: |1 + g e^{j phi}|^2 / |1 - g e^{j phi}|^2
+        double irr = (1 + 2 * g * c + g * g) / std::max(1 - 2 * g * c + g * g, 1e-12);
+        return {float(dcI_), float(dcQ_), float(20 * std::log10(g)), float(std::asin(s) * 180 / M_PI),
+                float(10 * std::log10(irr))};
+    }
+
+    const IqCoeffs &coeffs() const { return coeffs_; }
+    const char *kernelName() const { return kernels_.name; }
+
+    // forget the estimates, e.g. after retuning
+    void reset()
+    {
+        primed_ = false;
+        dcI_ = dcQ_ = pII_ = pQQ_ = pIQ_ = 0;
+        coeffs_ = {0, 0, 1, 0};
+    }
+
+private:
+    double sinPhi() const
+    {
+        double norm = std::sqrt(pII_ * pQQ_);
+        return norm > 0 ? std::max(-0.99, std::min(0.99, -pIQ_ / norm)) : 0.0;
+    }
+
+    void update(const IqMoments &m, size_t pairs)
+    {
+        if (!pairs) return;
+        double n = double(pairs);
+        double alpha = primed_ ? std::min(1.0, n / tau_) : 1.0;
+        primed_ = true;
+        double mx = m.sx / n, my = m.sy / n;
+        dcI_ += alpha * (mx - dcI_);
+        dcQ_ += alpha * (my - dcQ_);
+        // second moments about the running DC, not the block mean: a block
+        // holding a few cycles of a tone has a mean that is not the offset
+        double cxx = m.sxx / n - 2 * dcI_ * mx + dcI_ * dcI_;
+        double cyy = m.syy / n - 2 * dcQ_ * my + dcQ_ * dcQ_;
+        double cxy = m.sxy / n - dcI_ * my - dcQ_ * mx + dcI_ * dcQ_;
+        pII_ += alpha * (cxx - pII_);
+        pQQ_ += alpha * (cyy - pQQ_);
+        pIQ_ += alpha * (cxy - pIQ_);
+        // no signal to estimate from: only take the offset out
+        if (pII_ < 1e-12 || pQQ_ < 1e-12) {
+            coeffs_ = {float(-dcI_), 0, 1, float(-dcQ_)};
+            return;
+        }
+        double g = std::sqrt(pQQ_ / pII_);
+        double s = sinPhi();
+        double c = std::sqrt(1 - s * s);
+        double c1 = s / c, c2 = 1 / (g * c);
+        coeffs_ = {float(-dcI_), float(c1), float(c2), float(-(c1 * dcI_ + c2 * dcQ_))};
+    }
+
+    double tau_;
+    const IqCorrectKernels &kernels_;
+    IqCoeffs coeffs_;
+    bool primed_ = false;
+    double dcI_ = 0, dcQ_ = 0;
+    double pII_ = 0, pQQ_ = 0, pIQ_ = 0;
+};
@@ -0,0 +1,521 @@
+#pragma once
+// IQ recorder that keeps file I/O off the capture thread
+//
+// samples are copied into a pool of page-aligned buffers; full buffers are
+// written asynchronously with io_uring (raw syscalls, no liburing needed)
+// on an O_DIRECT file descriptor so the page cache never has to flush
+// behind capture. if io_uring is unavailable a writer thread does pwrite()
+// instead, and if the filesystem refuses O_DIRECT (tmpfs) the file is opened
+// buffered. a SigMF metadata file is written next to the data, with a new
+// capture wherever the stream timestamps jump (samples lost on capture or
+// blocks dropped before the recorder) and an annotation over zero-filled gaps.
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include "continuity.h"
+#include "iqRing.h"
+
+#define RECORDER_ALIGN 4096
+
+// minimal io_uring: one submission per write, completions reaped on demand.
+// a write is in the kernel's hands from the moment its SQE is in the ring;
+// if io_uring_enter cannot take it right away it stays queued and goes in
+// with the next enter, so its buffer must not be touched until it completes
+class UringQueue {
+public:
+    ~UringQueue() { close(); }
+
+    int setup(unsigned entries)
+    {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd_ = int(syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) return -1;
+
+        sqLen_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqLen_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqLen_ = cqLen_ = std::max(sqLen_, cqLen_);
+        sqPtr_ = mmap(nullptr, sqLen_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sqPtr_ == MAP_FAILED) return fail();
+        cqPtr_ = single ? sqPtr_ : mmap(nullptr, cqLen_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cqPtr_ == MAP_FAILED) return fail();
+        sqesLen_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(mmap(nullptr, sqesLen_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) return fail();
+
+        uint8_t *sq = static_cast<uint8_t *>(sqPtr_);
+        uint8_t *cq = static_cast<uint8_t *>(cqPtr_);
+        sqTail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+        return 0;
+    }
+
+    // queue and submit one write; the caller never has more in flight than
+    // entries. 0 once submitted, else -errno with the write still queued:
+    // -EAGAIN / -EBUSY until completions are reaped, anything else is fatal
+    int write(int fd, const void *buf, unsigned len, uint64_t offset, uint64_t userData)
+    {
+        unsigned tail = *sqTail_;
+        unsigned idx = tail & sqMask_;
+        io_uring_sqe *sqe = &sqes_[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        sqArray_[idx] = idx;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        pending_++;
+        return flush();
+    }
+
+    // submit whatever is queued, 0 or -errno as for write()
+    int flush()
+    {
+        while (pending_ > 0) {
+            int n = int(syscall(__NR_io_uring_enter, fd_, pending_, 0, 0, nullptr, 0));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return -errno;
+            }
+            if (n == 0) return -EAGAIN;
+            pending_ -= std::min(pending_, unsigned(n));
+        }
+        return 0;
+    }
+
+    unsigned pending() const { return pending_; }
+
+    // pop one completion; waits for one if block is set, else returns false
+    // when none. waiting also submits anything still queued
+    bool complete(io_uring_cqe *out, bool block)
+    {
+        while (true) {
+            unsigned head = *cqHead_;
+            if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+                *out = cqes_[head & cqMask_];
+                __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            if (!block) return false;
+            int n = int(syscall(__NR_io_uring_enter, fd_, pending_, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (n > 0) pending_ -= std::min(pending_, unsigned(n));
+            // EBUSY: the completion ring is full, the loop empties it first
+            if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+        }
+    }
+
+    void close()
+    {
+        if (sqes_ && sqes_ != MAP_FAILED) munmap(sqes_, sqesLen_);
+        if (cqPtr_ && cqPtr_ != MAP_FAILED && cqPtr_ != sqPtr_) munmap(cqPtr_, cqLen_);
+        if (sqPtr_ && sqPtr_ != MAP_FAILED) munmap(sqPtr_, sqLen_);
+        if (fd_ >= 0) ::close(fd_);
+        sqes_ = nullptr;
+        sqPtr_ = cqPtr_ = nullptr;
+        fd_ = -1;
+    }
+
+private:
+    int fail()
+    {
+        close();
+        return -1;
+    }
+
+    int fd_ = -1;
+    void *sqPtr_ = nullptr;
+    void *cqPtr_ = nullptr;
+    size_t sqLen_ = 0, cqLen_ = 0, sqesLen_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    unsigned *sqTail_ = nullptr, *sqArray_ = nullptr, sqMask_ = 0;
+    unsigned *cqHead_ = nullptr, *cqTail_ = nullptr, cqMask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+    unsigned pending_ = 0;               // in the SQ ring, not yet taken by the kernel
+};
+
+// what goes into the SigMF sidecar
+struct RecordingInfo {
+    IqSampleFormat format;
+    double sampleRate;
+    double frequency;      // LO frequency
+    double gainDb;
+    uint64_t timestamp;    // lms_stream_meta_t timestamp of the first sample
+    std::string hardware;
+};
+
+struct RecorderStats {
+    uint64_t bytes;        // accepted from the caller
+    uint64_t writes;       // buffers handed to the kernel
+    uint64_t stalls;       // times the caller waited for a free buffer
+    uint64_t errors;
+    uint64_t lostBytes;    // never reached the file: failed writes, or everything after a fatal error
+    uint64_t discontinuities; // captures started after the first one
+};
+
+class IqRecorder {
+public:
+    ~IqRecorder() { close(); }
+
+    // records basePath.sigmf-data, metadata goes to basePath.sigmf-meta on close
+    // bufferBytes is rounded up to RECORDER_ALIGN
+    int open(const std::string &basePath, const RecordingInfo &info, size_t bufferBytes = 4 << 20, unsigned buffers = 8)
+    {
+        base_ = basePath;
+        info_ = info;
+        started_ = time(nullptr);
+        captures_.clear();
+        fills_.clear();
+        bufferBytes_ = (bufferBytes + RECORDER_ALIGN - 1) & ~size_t(RECORDER_ALIGN - 1);
+        std::string dataPath = basePath + ".sigmf-data";
+        fd_ = ::open(dataPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        direct_ = fd_ >= 0;
+        if (fd_ < 0) fd_ = ::open(dataPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            std::cerr << "recorder: cannot open " << dataPath << ": " << strerror(errno) << std::endl;
+            return -1;
+        }
+        for (unsigned i = 0; i < buffers; ++i) {
+            void *p = nullptr;
+            if (posix_memalign(&p, RECORDER_ALIGN, bufferBytes_) != 0) return -1;
+            memset(p, 0, bufferBytes_); // prefault before capture starts
+            pool_.push_back(static_cast<uint8_t *>(p));
+            free_.push_back(i);
+        }
+        writes_.assign(buffers, Write{0, 0, 0});
+        uring_ = uringQueue_.setup(buffers) == 0;
+        if (!uring_) {
+            running_ = true;
+            writer_ = std::thread([this] { writerLoop(); });
+        }
+        current_ = takeBuffer();
+        return 0;
+    }
+
+    // record count samples starting at stream timestamp; a timestamp other
+    // than the one following the previous block starts a new capture, and
+    // IQ_BLOCK_FILLED blocks are annotated as zeros
+    void writeBlock(const void *data, uint32_t count, uint64_t timestamp, uint32_t flags = 0)
+    {
+        uint64_t at = stats_.bytes / iqBytesPerSample(info_.format);
+        if (captures_.empty()) {
+            started_ = time(nullptr);
+            info_.timestamp = timestamp;
+            captures_.push_back({at, timestamp});
+        } else if (timestamp != nextTimestamp_) {
+            captures_.push_back({at, timestamp});
+            stats_.discontinuities++;
+        }
+        if (flags & IQ_BLOCK_FILLED) {
+            if (!fills_.empty() && fills_.back().start + fills_.back().count == at) fills_.back().count += count;
+            else fills_.push_back({at, count});
+        }
+        nextTimestamp_ = timestamp + count;
+        write(data, size_t(count) * iqBytesPerSample(info_.format));
+    }
+
+    // copy bytes into the pool; blocks only when every buffer is in flight
+    void write(const void *data, size_t bytes)
+    {
+        const uint8_t *src = static_cast<const uint8_t *>(data);
+        stats_.bytes += bytes;
+        if (failed_) {
+            stats_.lostBytes += bytes;
+            return;
+        }
+        while (bytes > 0) {
+            size_t n = std::min(bytes, bufferBytes_ - fill_);
+            memcpy(pool_[current_] + fill_, src, n);
+            fill_ += n;
+            src += n;
+            bytes -= n;
+            if (fill_ == bufferBytes_) {
+                submit(current_, bufferBytes_);
+                current_ = takeBuffer();
+                fill_ = 0;
+            }
+        }
+    }
+
+    // flush, trim the O_DIRECT padding and write the SigMF metadata
+    void close()
+    {
+        if (fd_ < 0) return;
+        size_t tail = fill_;
+        if (tail > 0 && failed_) stats_.lostBytes += tail;
+        else if (tail > 0) submit(current_, (tail + RECORDER_ALIGN - 1) & ~size_t(RECORDER_ALIGN - 1));
+        drain();
+        if (ftruncate(fd_, stats_.bytes) != 0) stats_.errors++;
+        ::close(fd_);
+        fd_ = -1;
+        if (!uring_) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_ = false;
+            }
+            cv_.notify_all();
+            if (writer_.joinable()) writer_.join();
+        }
+        uringQueue_.close();
+        for (uint8_t *p : pool_)
+            free(p);
+        pool_.clear();
+        writeMeta();
+    }
+
+    const RecorderStats &stats() const { return stats_; }
+    // io_uring stopped taking writes; the rest of the recording is dropped
+    bool failed() const { return failed_; }
+    const char *backend() const { return uring_ ? (direct_ ? "io_uring+O_DIRECT" : "io_uring") : (direct_ ? "thread+O_DIRECT" : "thread"); }
+
+private:
+    void submit(unsigned buffer, size_t len)
+    {
+        stats_.writes++;
+        inFlight_++;
+        if (uring_) {
+            queue(buffer, 0, len, offset_);
+        } else {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back({buffer, len, offset_});
+            cv_.notify_one();
+        }
+        offset_ += len;
+    }
+
+    // hand bytes [from, to) of a buffer to io_uring. once queued the buffer
+    // belongs to the kernel until its completion, so a submit that has to
+    // wait is retried, never replaced by a synchronous write
+    void queue(unsigned buffer, size_t from, size_t to, uint64_t offset)
+    {
+        writes_[buffer] = {from, to, offset};
+        int ret = uringQueue_.write(fd_, pool_[buffer] + from, unsigned(to - from), offset + from, buffer);
+        while (ret == -EAGAIN || ret == -EBUSY) {
+            reap(true);
+            ret = uringQueue_.flush();
+        }
+        if (ret < 0) fail(ret);
+    }
+
+    // the ring will not take writes any more: what is queued never completes
+    void fail(int err)
+    {
+        if (!failed_)
+            std::cerr << "recorder: io_uring submit failed: " << strerror(-err) << ", dropping the rest" << std::endl;
+        failed_ = true;
+        stats_.errors++;
+    }
+
+    unsigned takeBuffer()
+    {
+        reap(false);
+        if (free_.empty()) {
+            stats_.stalls++;
+            while (free_.empty() && !failed_) reap(true);
+            // nothing comes back after a fatal error, reuse one for the dropped bytes
+            if (free_.empty()) return current_;
+        }
+        unsigned b = free_.front();
+        free_.pop_front();
+        return b;
+    }
+
+    // move finished writes back to the free list
+    void reap(bool block)
+    {
+        if (uring_) {
+            io_uring_cqe cqe;
+            while (uringQueue_.complete(&cqe, block)) {
+                block = false;
+                unsigned buffer = unsigned(cqe.user_data);
+                Write &w = writes_[buffer];
+                size_t len = w.to - w.from;
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    queue(buffer, w.from, w.to, w.offset);
+                    continue;
+                }
+                if (cqe.res > 0 && size_t(cqe.res) < len) {
+                    // short write: the rest goes in again from where it stopped
+                    queue(buffer, w.from + cqe.res, w.to, w.offset);
+                    continue;
+                }
+                if (cqe.res < 0 || size_t(cqe.res) < len) {
+                    stats_.errors++;
+                    stats_.lostBytes += len;
+                }
+                inFlight_--;
+                free_.push_back(buffer);
+            }
+        } else {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (block) doneCv_.wait(lock, [this] { return !done_.empty(); });
+            while (!done_.empty()) {
+                free_.push_back(done_.front());
+                done_.pop_front();
+                inFlight_--;
+            }
+            stats_.errors += threadErrors_;
+            stats_.lostBytes += threadLost_;
+            threadErrors_ = threadLost_ = 0;
+        }
+    }
+
+    void drain()
+    {
+        while (inFlight_ > 0 && !failed_) reap(true);
+    }
+
+    // bytes that could not be written
+    size_t writeAll(unsigned buffer, size_t len, uint64_t offset)
+    {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = pwrite(fd_, pool_[buffer] + done, len - done, offset + done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return len - done;
+            done += n;
+        }
+        return 0;
+    }
+
+    void writerLoop()
+    {
+        while (true) {
+            Pending job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return !queue_.empty() || !running_; });
+                if (queue_.empty()) return;
+                job = queue_.front();
+                queue_.pop_front();
+            }
+            size_t lost = writeAll(job.buffer, job.len, job.offset);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.push_back(job.buffer);
+                if (lost) {
+                    threadErrors_++;
+                    threadLost_ += lost;
+                }
+            }
+            doneCv_.notify_one();
+        }
+    }
+
+    // core:datetime is the wall time of the first sample; captures after the
+    // first only carry their stream timestamp
+    void writeMeta()
+    {
+        char datetime[32];
+        strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%SZ", gmtime(&started_));
+        if (captures_.empty()) captures_.push_back({0, info_.timestamp});
+        std::ofstream meta(base_ + ".sigmf-meta");
+        meta << "{\n"
+             << "  \"global\": {\n"
+             << "    \"core:datatype\": \"" << (info_.format == IQ_FMT_I16 ? "ci16_le" : "cf32_le") << "\",\n"
+             << "    \"core:sample_rate\": " << std::fixed << info_.sampleRate << ",\n"
+             << "    \"core:version\": \"1.0.0\",\n"
+             << "    \"core:hw\": \"" << info_.hardware << "\",\n"
+             << "    \"core:recorder\": \"LimeSDR4Edema iqRecorder (" << backend() << ")\",\n"
+             << "    \"core:extensions\": [\n"
+             << "      {\"name\": \"lime\", \"version\": \"1.0.0\", \"optional\": true}\n"
+             << "    ]\n"
+             << "  },\n"
+             << "  \"captures\": [\n";
+        for (size_t i = 0; i < captures_.size(); ++i) {
+            meta << "    {\n"
+                 << "      \"core:sample_start\": " << captures_[i].start << ",\n"
+                 << "      \"core:frequency\": " << info_.frequency << ",\n";
+            if (i == 0) meta << "      \"core:datetime\": \"" << datetime << "\",\n";
+            meta << "      \"lime:gain_db\": " << info_.gainDb << ",\n"
+                 << "      \"lime:timestamp\": " << captures_[i].timestamp << "\n"
+                 << "    }" << (i + 1 < captures_.size() ? "," : "") << "\n";
+        }
+        meta << "  ],\n"
+             << "  \"annotations\": [";
+        for (size_t i = 0; i < fills_.size(); ++i)
+            meta << (i ? "," : "") << "\n    {\"core:sample_start\": " << fills_[i].start
+                 << ", \"core:sample_count\": " << fills_[i].count
+                 << ", \"core:comment\": \"zeros over lost samples\"}";
+        meta << (fills_.empty() ? "]\n" : "\n  ]\n") << "}\n";
+    }
+
+    struct Pending {
+        unsigned buffer;
+        size_t len;
+        uint64_t offset;
+    };
+
+    // a capture segment (first sample in the file, its stream timestamp)
+    // or a zero-filled span
+    struct Capture {
+        uint64_t start, timestamp;
+    };
+    struct Span {
+        uint64_t start, count;
+    };
+
+    // the part of a buffer an io_uring write covers, file offset of byte 0
+    struct Write {
+        size_t from, to;
+        uint64_t offset;
+    };
+
+    std::string base_;
+    RecordingInfo info_;
+    int fd_ = -1;
+    bool direct_ = false;
+    bool uring_ = false;
+    UringQueue uringQueue_;
+    size_t bufferBytes_ = 0;
+    std::vector<uint8_t *> pool_;
+    std::deque<unsigned> free_;
+    unsigned current_ = 0;
+    size_t fill_ = 0;
+    uint64_t offset_ = 0;
+    unsigned inFlight_ = 0;
+    std::vector<Write> writes_;          // per buffer, io_uring backend
+    bool failed_ = false;
+    RecorderStats stats_ = {};
+    time_t started_ = 0;
+    uint64_t nextTimestamp_ = 0;
+    std::vector<Capture> captures_;
+    std::vector<Span> fills_;
+
+    // writer thread backend
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable cv_, doneCv_;
+    std::deque<Pending> queue_;
+    std::deque<unsigned> done_;
+    uint64_t threadErrors_ = 0;          // failed pwrites since the last reap
+    uint64_t threadLost_ = 0;
+    bool running_ = false;
+};
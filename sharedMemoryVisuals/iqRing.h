@@ -0,0 +1,438 @@
+#pragma once
+// single-producer / multi-consumer IQ block ring living in POSIX shared memory
+//
+// layout: [IqRingHeader][slot 0][slot 1]...[slot N-1]
+// each slot is an IqSlotHeader followed by slotSamples IQ pairs.
+//
+// the writer marks a slot with an odd sequence (2*block+1) while it fills it and
+// an even one (2*block+2) once it is published, then advances writeCursor.
+// readers copy a slot and re-check its sequence, so a slot overwritten while it
+// was being read is detected instead of handed out torn. every registered
+// reader keeps its cursor and overrun counter in the header so anyone can see
+// how far behind each consumer is.
+//
+// a claimed slot that is never published is simply reused by the next claim.
+//
+// readers that have caught up can sleep in wait() on the futex next to
+// writeCursor instead of polling; the writer only makes the wake syscall
+// when someone is asleep, and at most once per wake batch.
+//
+// with setHugePages() the ring is a file on hugetlbfs instead, so the slots
+// cost a handful of TLB entries, and is prefaulted and locked at creation.
+// a symlink under /dev/shm keeps it where the python viewers look; readers
+// fall back to the hugetlbfs path themselves (shm_open refuses symlinks).
+// without a hugetlbfs mount or reserved pages the ring stays in /dev/shm and
+// asks for transparent huge pages instead.
+
+#include <iostream>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include "shmNotify.h"
+
+#define IQ_RING_MAGIC 0x4e525149u // "IQRN"
+#define IQ_RING_VERSION 3
+#define IQ_RING_MAX_READERS 8
+#define IQ_RING_ALIGN 64
+#define IQ_RING_HUGETLBFS "/dev/hugepages"
+#define IQ_RING_HUGEPAGE (size_t(2) << 20)
+
+enum IqSampleFormat : uint32_t {
+    IQ_FMT_F32 = 0, // interleaved float I,Q
+    IQ_FMT_I16 = 1, // interleaved int16 I,Q
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared memory atomics must be lock free");
+
+// one entry per attached reader, a cache line each
+struct alignas(IQ_RING_ALIGN) IqRingReaderInfo {
+    std::atomic<uint32_t> pid;       // 0 when the entry is free
+    uint32_t reserved;
+    std::atomic<uint64_t> cursor;    // next block this reader will consume
+    std::atomic<uint64_t> overruns;  // blocks overwritten before this reader got them
+};
+
+struct IqRingHeader {
+    std::atomic<uint32_t> magic;     // written last by the creator
+    uint32_t version;
+    uint32_t headerSize;             // offset of slot 0
+    uint32_t slotCount;              // power of two
+    uint32_t slotSamples;            // IQ pairs per slot
+    uint32_t sampleFormat;           // IqSampleFormat
+    uint32_t bytesPerSample;         // bytes per IQ pair
+    uint32_t slotStride;             // bytes from one slot header to the next
+    double sampleRate;
+    float fullScale;                 // integer value of 1.0 (1 for float rings)
+    alignas(IQ_RING_ALIGN) std::atomic<uint64_t> writeCursor; // blocks published so far
+    ShmNotifier notify;              // bumped with writeCursor, readers sleep on it
+    IqRingReaderInfo readers[IQ_RING_MAX_READERS];
+};
+
+struct alignas(IQ_RING_ALIGN) IqSlotHeader {
+    std::atomic<uint64_t> seq;       // 2*block+1 while writing, 2*block+2 when published
+    uint64_t timestamp;              // hardware timestamp of the first sample
+    uint32_t count;                  // valid IQ pairs in this slot
+    uint32_t flags;
+};
+
+// what a reader gets back alongside the samples
+struct IqBlockInfo {
+    uint64_t block;
+    uint64_t timestamp;
+    uint32_t count;
+    uint32_t flags;
+    uint64_t lost;                   // blocks skipped since the previous read
+};
+
+inline uint32_t iqBytesPerSample(IqSampleFormat fmt)
+{
+    return fmt == IQ_FMT_I16 ? 2 * sizeof(int16_t) : 2 * sizeof(float);
+}
+
+// samples follow the slot header
+inline uint8_t *iqSlotData(IqSlotHeader *s)
+{
+    return reinterpret_cast<uint8_t *>(s) + sizeof(IqSlotHeader);
+}
+
+inline size_t iqAlignUp(size_t n)
+{
+    return (n + IQ_RING_ALIGN - 1) & ~size_t(IQ_RING_ALIGN - 1);
+}
+
+class IqRingWriter {
+public:
+    ~IqRingWriter() { close(); }
+
+    // create (or re-create) the shared memory ring
+    int create(const char *name, uint32_t slotCount, uint32_t slotSamples, IqSampleFormat fmt, double sampleRate,
+               float fullScale = 1.0f)
+    {
+        if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0) {
+            std::cerr << "iqRing: slot count must be a power of two" << std::endl;
+            return -1;
+        }
+        uint32_t bytesPerSample = iqBytesPerSample(fmt);
+        size_t headerSize = iqAlignUp(sizeof(IqRingHeader));
+        size_t slotStride = sizeof(IqSlotHeader) + iqAlignUp(size_t(slotSamples) * bytesPerSample);
+        size_t size = headerSize + slotStride * slotCount;
+
+        shm_unlink(name); // ensure no stale ring exists
+        unlink((std::string(IQ_RING_HUGETLBFS) + name).c_str());
+        void *base = hugePages_ ? mapHuge(name, &size) : MAP_FAILED;
+        if (base == MAP_FAILED) {
+            int fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+            if (fd == -1) return fail("shm_open failed");
+            if (ftruncate(fd, size) == -1) {
+                ::close(fd);
+                return fail("ftruncate failed");
+            }
+            base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (base == MAP_FAILED) return fail("mmap failed");
+            if (hugePages_) madvise(base, size, MADV_HUGEPAGE);
+        }
+
+        name_ = name;
+        base_ = static_cast<uint8_t *>(base);
+        size_ = size;
+        if (hugePages_) {
+            // every page backed and resident before the first block
+            memset(base_, 0, size_);
+            if (mlock(base_, size_) != 0)
+                std::cerr << "iqRing: mlock of " << size_ / 1024 << " KiB failed: " << strerror(errno) << std::endl;
+        }
+        hdr_ = new (base_) IqRingHeader();
+        hdr_->version = IQ_RING_VERSION;
+        hdr_->headerSize = headerSize;
+        hdr_->slotCount = slotCount;
+        hdr_->slotSamples = slotSamples;
+        hdr_->sampleFormat = fmt;
+        hdr_->bytesPerSample = bytesPerSample;
+        hdr_->slotStride = slotStride;
+        hdr_->sampleRate = sampleRate;
+        hdr_->fullScale = fullScale;
+        hdr_->writeCursor.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < slotCount; ++i)
+            new (slot(i)) IqSlotHeader();
+        next_ = 0;
+        notifier_.attach(&hdr_->notify);
+        hdr_->magic.store(IQ_RING_MAGIC, std::memory_order_release);
+        return 0;
+    }
+
+    // zero-copy path: hand out the next slot's sample area (room for slotSamples()
+    // IQ pairs) so the receiver can fill it in place, then publish() it
+    void *claim()
+    {
+        claimed_ = begin();
+        return iqSlotData(claimed_);
+    }
+
+    void publish(uint32_t count, uint64_t timestamp, uint32_t flags = 0)
+    {
+        if (count > hdr_->slotSamples) count = hdr_->slotSamples;
+        end(claimed_, count, timestamp, flags);
+    }
+
+    // copy one block of IQ pairs into the next slot and publish it
+    void write(const void *samples, uint32_t count, uint64_t timestamp, uint32_t flags = 0)
+    {
+        if (count > hdr_->slotSamples) count = hdr_->slotSamples;
+        memcpy(claim(), samples, size_t(count) * hdr_->bytesPerSample);
+        publish(count, timestamp, flags);
+    }
+
+    // back the ring with huge pages, call before create()
+    void setHugePages(bool huge) { hugePages_ = huge; }
+    bool onHugetlbfs() const { return onHugetlbfs_; }
+
+    // wake sleeping readers at most once per batch blocks
+    void setWakeBatch(uint32_t batch) { notifier_.setWakeBatch(batch); }
+    // wake sleeping readers now, e.g. before stopping
+    void wakeReaders() { if (hdr_) notifier_.flush(); }
+    uint64_t wakes() const { return notifier_.wakes(); }
+
+    uint32_t slotSamples() const { return hdr_->slotSamples; }
+    uint64_t published() const { return next_; }
+    IqRingHeader *header() const { return hdr_; }
+
+    void close()
+    {
+        if (base_) {
+            munmap(base_, size_);
+            shm_unlink(name_.c_str());
+            if (onHugetlbfs_) unlink((std::string(IQ_RING_HUGETLBFS) + name_).c_str());
+            base_ = nullptr;
+            hdr_ = nullptr;
+            onHugetlbfs_ = false;
+        }
+    }
+
+private:
+    IqSlotHeader *slot(uint64_t block) const
+    {
+        return reinterpret_cast<IqSlotHeader *>(base_ + hdr_->headerSize + (block & (hdr_->slotCount - 1)) * hdr_->slotStride);
+    }
+
+    IqSlotHeader *begin()
+    {
+        IqSlotHeader *s = slot(next_);
+        s->seq.store(2 * next_ + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return s;
+    }
+
+    void end(IqSlotHeader *s, uint32_t count, uint64_t timestamp, uint32_t flags)
+    {
+        s->timestamp = timestamp;
+        s->count = count;
+        s->flags = flags;
+        s->seq.store(2 * next_ + 2, std::memory_order_release);
+        hdr_->writeCursor.store(++next_, std::memory_order_release);
+        notifier_.notify();
+    }
+
+    // the ring as a file on hugetlbfs, size rounded up to whole huge pages;
+    // MAP_FAILED (after saying why) when there is no mount or no free pages
+    void *mapHuge(const char *name, size_t *size)
+    {
+        std::string path = std::string(IQ_RING_HUGETLBFS) + name;
+        size_t huge = (*size + IQ_RING_HUGEPAGE - 1) & ~(IQ_RING_HUGEPAGE - 1);
+        void *base = MAP_FAILED;
+        int fd = open(path.c_str(), O_CREAT | O_RDWR, 0666);
+        if (fd != -1) {
+            if (ftruncate(fd, huge) == 0)
+                base = mmap(nullptr, huge, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+            ::close(fd);
+        }
+        if (base == MAP_FAILED) {
+            std::cerr << "iqRing: no huge pages at " << path << " (" << strerror(errno)
+                      << "), using /dev/shm with transparent huge pages" << std::endl;
+            unlink(path.c_str());
+            return MAP_FAILED;
+        }
+        // where liveViz.py and the other viewers open the ring
+        std::string link = std::string("/dev/shm") + name;
+        if (symlink(path.c_str(), link.c_str()) != 0)
+            std::cerr << "iqRing: cannot link " << link << ": " << strerror(errno) << std::endl;
+        *size = huge;
+        onHugetlbfs_ = true;
+        return base;
+    }
+
+    int fail(const char *msg)
+    {
+        std::cerr << "iqRing: " << msg << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    std::string name_;
+    uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    IqRingHeader *hdr_ = nullptr;
+    IqSlotHeader *claimed_ = nullptr;
+    uint64_t next_ = 0;
+    bool hugePages_ = false;
+    bool onHugetlbfs_ = false;
+    NotifyPublisher notifier_;
+};
+
+class IqRingReader {
+public:
+    ~IqRingReader() { close(); }
+
+    // attach to an existing ring; starts at the newest block unless fromOldest
+    int open(const char *name, bool fromOldest = false)
+    {
+        int fd = shm_open(name, O_RDWR, 0666);
+        // a hugetlbfs ring is only a symlink in /dev/shm
+        if (fd == -1) fd = ::open((std::string(IQ_RING_HUGETLBFS) + name).c_str(), O_RDWR);
+        if (fd == -1) return fail("shm_open failed");
+        struct stat st;
+        if (fstat(fd, &st) == -1 || size_t(st.st_size) < sizeof(IqRingHeader)) {
+            ::close(fd);
+            std::cerr << "iqRing: " << name << " is too small to be a ring" << std::endl;
+            return -1;
+        }
+        void *base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) return fail("mmap failed");
+        const IqRingHeader *probe = static_cast<const IqRingHeader *>(base);
+        if (probe->magic.load(std::memory_order_acquire) != IQ_RING_MAGIC || probe->version != IQ_RING_VERSION) {
+            munmap(base, st.st_size);
+            std::cerr << "iqRing: " << name << " is not a version " << IQ_RING_VERSION << " ring" << std::endl;
+            return -1;
+        }
+        base_ = static_cast<uint8_t *>(base);
+        size_ = st.st_size;
+        hdr_ = reinterpret_cast<IqRingHeader *>(base_);
+
+        uint64_t wc = hdr_->writeCursor.load(std::memory_order_acquire);
+        if (fromOldest)
+            cursor_ = wc > hdr_->slotCount ? wc - hdr_->slotCount + 1 : 0;
+        else
+            cursor_ = wc;
+
+        // claim a reader entry, reclaiming ones whose process has gone away
+        uint32_t self = getpid();
+        for (int i = 0; i < IQ_RING_MAX_READERS && !me_; ++i) {
+            IqRingReaderInfo &r = hdr_->readers[i];
+            uint32_t pid = r.pid.load(std::memory_order_relaxed);
+            if (pid != 0 && kill(pid, 0) == 0) continue;
+            if (pid != 0 && errno != ESRCH) continue;
+            if (r.pid.compare_exchange_strong(pid, self)) {
+                r.overruns.store(0, std::memory_order_relaxed);
+                r.cursor.store(cursor_, std::memory_order_relaxed);
+                me_ = &r;
+            }
+        }
+        if (!me_) std::cerr << "iqRing: no free reader entry, overruns will not be exported" << std::endl;
+        return 0;
+    }
+
+    // copy the next block into dst (room for maxCount IQ pairs)
+    // returns 1 when a block was read, 0 when nothing new is published yet
+    int read(void *dst, uint32_t maxCount, IqBlockInfo *info)
+    {
+        uint64_t lost = 0;
+        while (true) {
+            uint64_t wc = hdr_->writeCursor.load(std::memory_order_acquire);
+            if (cursor_ >= wc) return 0;
+            // the oldest block that can still be intact is wc - slotCount + 1
+            if (wc - cursor_ >= hdr_->slotCount) {
+                uint64_t oldest = wc - hdr_->slotCount + 1;
+                lost += oldest - cursor_;
+                cursor_ = oldest;
+            }
+            IqSlotHeader *s = slot(cursor_);
+            uint64_t expected = 2 * cursor_ + 2;
+            uint64_t seq1 = s->seq.load(std::memory_order_acquire);
+            if (seq1 < expected) return 0; // not published yet
+            if (seq1 == expected) {
+                uint32_t count = s->count < maxCount ? s->count : maxCount;
+                uint64_t timestamp = s->timestamp;
+                uint32_t flags = s->flags;
+                memcpy(dst, iqSlotData(s), size_t(count) * hdr_->bytesPerSample);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s->seq.load(std::memory_order_relaxed) == seq1) {
+                    if (info) {
+                        info->block = cursor_;
+                        info->timestamp = timestamp;
+                        info->count = count;
+                        info->flags = flags;
+                        info->lost = lost;
+                    }
+                    ++cursor_;
+                    account(lost);
+                    return 1;
+                }
+            }
+            // lapped by the writer while we looked at it
+            ++lost;
+            ++cursor_;
+        }
+    }
+
+    // like read(), but sleeps until a block is published or timeoutMs passes
+    int wait(void *dst, uint32_t maxCount, IqBlockInfo *info, unsigned timeoutMs)
+    {
+        if (read(dst, maxCount, info)) return 1;
+        notifyWait(&hdr_->notify, [this] { return hdr_->writeCursor.load(std::memory_order_acquire) > cursor_; },
+                   timeoutMs);
+        return read(dst, maxCount, info);
+    }
+
+    // blocks published but not yet consumed by this reader
+    uint64_t lag() const { return hdr_->writeCursor.load(std::memory_order_acquire) - cursor_; }
+    uint64_t overruns() const { return overruns_; }
+    IqRingHeader *header() const { return hdr_; }
+
+    void close()
+    {
+        if (base_) {
+            if (me_) me_->pid.store(0, std::memory_order_release);
+            munmap(base_, size_);
+            base_ = nullptr;
+            hdr_ = nullptr;
+            me_ = nullptr;
+        }
+    }
+
+private:
+    IqSlotHeader *slot(uint64_t block) const
+    {
+        return reinterpret_cast<IqSlotHeader *>(base_ + hdr_->headerSize + (block & (hdr_->slotCount - 1)) * hdr_->slotStride);
+    }
+
+    void account(uint64_t lost)
+    {
+        overruns_ += lost;
+        if (me_) {
+            me_->cursor.store(cursor_, std::memory_order_relaxed);
+            if (lost) me_->overruns.store(overruns_, std::memory_order_relaxed);
+        }
+    }
+
+    int fail(const char *msg)
+    {
+        std::cerr << "iqRing: " << msg << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    IqRingHeader *hdr_ = nullptr;
+    IqRingReaderInfo *me_ = nullptr;
+    uint64_t cursor_ = 0;
+    uint64_t overruns_ = 0;
+};
@@ -0,0 +1,49 @@
+#pragma once
+// CalibrationDevice for the RX channels of a LimeSDR in use: the slow path is
+// LMS_SetLPFBW plus LMS_Calibrate on each of them, the cached path
+// LMS_LoadConfig of the chip state LMS_SaveConfig wrote after a calibration.
+// a config file holds the whole chip, so one entry covers all the channels
+// and they are calibrated together or not at all
+
+#include <LimeSuite.h>
+#include <cstdio>
+#include "calibrationCache.h"
+
+class LimeCalibrationDevice : public CalibrationDevice {
+public:
+    // RX channels 0 .. channels - 1
+    LimeCalibrationDevice(lms_device_t *device, size_t channels) : device_(device), channels_(channels) {}
+
+    std::string serial() override
+    {
+        const lms_dev_info_t *info = LMS_GetDeviceInfo(device_);
+        char text[32];
+        snprintf(text, sizeof(text), "%016llx", info ? (unsigned long long)info->boardSerialNumber : 0ULL);
+        return text;
+    }
+
+    int temperature(double *celsius) override
+    {
+        float_type t = 0;
+        if (LMS_GetChipTemperature(device_, 0, &t) != 0) return -1;
+        *celsius = t;
+        return 0;
+    }
+
+    int calibrate(double bandwidthHz) override
+    {
+        for (size_t ch = 0; ch < channels_; ++ch) {
+            if (LMS_SetLPFBW(device_, LMS_CH_RX, ch, bandwidthHz) != 0) return -1;
+            if (LMS_Calibrate(device_, LMS_CH_RX, ch, bandwidthHz, 0) != 0) return -1;
+        }
+        return 0;
+    }
+
+    int saveConfig(const std::string &path) override { return LMS_SaveConfig(device_, path.c_str()); }
+    int loadConfig(const std::string &path) override { return LMS_LoadConfig(device_, path.c_str()); }
+    const char *lastError() const override { return LMS_GetLastErrorMessage(); }
+
+private:
+    lms_device_t *device_;
+    size_t channels_;
+};
@@ -0,0 +1,38 @@
+#pragma once
+// RxSource backed by a LimeSuite RX stream
+
+#include <LimeSuite.h>
+#include "rxSource.h"
+
+class LimeRxSource : public RxSource {
+public:
+    explicit LimeRxSource(lms_stream_t *stream) : stream_(stream) {}
+
+    int recv(void *samples, size_t count, RxMeta *meta, unsigned timeoutMs) override
+    {
+        lms_stream_meta_t lmsMeta = {};
+        int ret = LMS_RecvStream(stream_, samples, count, &lmsMeta, timeoutMs);
+        if (meta) meta->timestamp = lmsMeta.timestamp;
+        return ret;
+    }
+
+    int status(RxStatus *status) override
+    {
+        lms_stream_status_t lmsStatus;
+        if (LMS_GetStreamStatus(stream_, &lmsStatus) != 0) return -1;
+        status->fifoFilledCount = lmsStatus.fifoFilledCount;
+        status->fifoSize = lmsStatus.fifoSize;
+        status->underrun = lmsStatus.underrun;
+        status->overrun = lmsStatus.overrun;
+        status->droppedPackets = lmsStatus.droppedPackets;
+        status->linkRate = lmsStatus.linkRate;
+        return 0;
+    }
+
+    const char *lastError() const override { return LMS_GetLastErrorMessage(); }
+
+    lms_stream_t *stream() const { return stream_; }
+
+private:
+    lms_stream_t *stream_;
+};
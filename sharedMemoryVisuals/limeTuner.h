@@ -0,0 +1,25 @@
+#pragma once
+// Tuner backed by LMS_SetLOFrequency, optionally moving the TX LO along
+
+#include <LimeSuite.h>
+#include "tuner.h"
+
+class LimeTuner : public Tuner {
+public:
+    LimeTuner(lms_device_t *device, size_t channel, bool withTx = false)
+        : device_(device), channel_(channel), withTx_(withTx) {}
+
+    int tune(double hz) override
+    {
+        if (LMS_SetLOFrequency(device_, LMS_CH_RX, channel_, hz) != 0) return -1;
+        if (withTx_ && LMS_SetLOFrequency(device_, LMS_CH_TX, channel_, hz) != 0) return -1;
+        return 0;
+    }
+
+    const char *lastError() const override { return LMS_GetLastErrorMessage(); }
+
+private:
+    lms_device_t *device_;
+    size_t channel_;
+    bool withTx_;
+};
@@ -0,0 +1,35 @@
+#pragma once
+// TxSink backed by a LimeSuite TX stream
+
+#include <LimeSuite.h>
+#include "txSink.h"
+
+class LimeTxSink : public TxSink {
+public:
+    explicit LimeTxSink(lms_stream_t *stream) : stream_(stream) {}
+
+    int send(const void *samples, size_t count, const TxMeta *meta, unsigned timeoutMs) override
+    {
+        lms_stream_meta_t lmsMeta = {};
+        if (meta) {
+            lmsMeta.timestamp = meta->timestamp;
+            lmsMeta.waitForTimestamp = meta->waitForTimestamp;
+            lmsMeta.flushPartialPacket = meta->endOfBurst;
+        }
+        return LMS_SendStream(stream_, samples, count, &lmsMeta, timeoutMs);
+    }
+
+    // the FPGA drops packets whose timestamp is in the past and counts them
+    // as TX underruns
+    uint64_t late() const override
+    {
+        lms_stream_status_t lmsStatus;
+        if (LMS_GetStreamStatus(stream_, &lmsStatus) != 0) return 0;
+        return lmsStatus.underrun;
+    }
+
+    const char *lastError() const override { return LMS_GetLastErrorMessage(); }
+
+private:
+    lms_stream_t *stream_;
+};
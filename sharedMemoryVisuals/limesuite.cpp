@@ -1,21 +1,61 @@
 #include <iostream>
+#ifdef HAVE_LIMESUITE
 #include <LimeSuite.h>
+#endif
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <unistd.h>
 #include <cstring>
-
-int main()
+#include <cstdlib>
+#include <csignal>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include "iqRing.h"
+#include "replayRxSource.h"
+#include "syntheticRxSource.h"
+#include "capturePipeline.h"
+#include "powerMeter.h"
+#include "lockIn.h"
+#include "spectrum.h"
+#include "decimator.h"
+#include "iqRecorder.h"
+#include "calibrationCache.h"
+#include "sweepEngine.h"
+#include "sweepSimulator.h"
+#include "multiCapture.h"
+#include "realtime.h"
+#ifdef HAVE_LIMESUITE
+#include "limeCalibration.h"
+#include "limeRxSource.h"
+#include "limeTuner.h"
+#endif
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void onSignal(int)
 {
-
+    stop_requested = 1;
+}
+
+#ifdef HAVE_LIMESUITE
+// open LimeSDR number `index` of the device list, configure up to `channels`
+// RX channels (all of them for 0) and start one stream per channel in
+// rx_Streams (room for LIME_MAX_RX_CHANNELS); returns the number of streams
+// started, or -1 with the device closed again. with a cal_cache the chip
+// state of an earlier calibration at the same settings is loaded instead of
+// calibrating again
+static constexpr int LIME_MAX_RX_CHANNELS = 2;
+static int startDevice(lms_device_t **device_out, lms_stream_t *rx_Streams, int index, int channels, bool f32_mode,
+                       unsigned int gain, CalibrationCache *cal_cache)
+{
+    StartupReport startup;
     // Declare a pointer to hold the LimeSDR device instance
     lms_device_t *device = nullptr;
     // Declare a variable to hold the return value of LimeSuite functions
     int ret;
     // Declare an array to hold the device information strings
     lms_info_str_t list[8];
-    // Declare a pointer to hold the device information structure
-    lms_dev_info_t *devInfo;
 
     // Get the list of available LimeSDR devices
     // The function returns the number of devices found
@@ -25,25 +65,32 @@ int main()
 
     if (numDevices <= 0)
     {
-        std::cerr << "No LimeSDR devices found!" << std::endl;
+        std::cerr << "No LimeSDR devices found! (--replay <file> or --synthetic run without one)" << std::endl;
+        return -1;
+    }
+    if (index >= numDevices)
+    {
+        std::cerr << "No LimeSDR device " << index << ", found " << numDevices << std::endl;
         return -1;
     }
 
-    std::cout << "Found " << numDevices << " device(s)." << std::endl;
-
-    for (int i = 0; i < numDevices; ++i)
+    if (index == 0)
     {
-        std::cout << "[" << i << "] " << list[i] << std::endl;
+        std::cout << "Found " << numDevices << " device(s)." << std::endl;
+        for (int i = 0; i < numDevices; ++i)
+        {
+            std::cout << "[" << i << "] " << list[i] << std::endl;
+        }
     }
 
-    // Open the first device in the list
-    ret = LMS_Open(&device, list[0], nullptr);
+    ret = LMS_Open(&device, list[index], nullptr);
     if (ret != 0)
     {
-        std::cerr << "Error opening device: " << LMS_GetLastErrorMessage() << std::endl;
+        std::cerr << "Error opening device " << index << ": " << LMS_GetLastErrorMessage() << std::endl;
         return -1;
     }
-    std::cout << "Device opened successfully." << std::endl;
+    std::cout << "Device " << index << " opened successfully." << std::endl;
+    startup.mark("open");
 
     // all trials here
 
@@ -55,24 +102,18 @@ int main()
         return -1;
     }
     std::cout << "Device initialized successfully." << std::endl;
+    startup.mark("init");
 
     int numTXChannels = LMS_GetNumChannels(device, LMS_CH_TX);
     int numRXChannels = LMS_GetNumChannels(device, LMS_CH_RX);
     std::cout << "max TX Channels :" << numTXChannels << std::endl;
-    std::cout << "max RX Channels :" << numTXChannels << std::endl;
+    std::cout << "max RX Channels :" << numRXChannels << std::endl;
+    if (channels <= 0 || channels > numRXChannels)
+        channels = numRXChannels;
+    if (channels > LIME_MAX_RX_CHANNELS)
+        channels = LIME_MAX_RX_CHANNELS;
 
-    // lets try out RX functionalities
-    // enable RX channel 0
-    if (LMS_EnableChannel(device, LMS_CH_RX, 0, true) != 0)
-    {
-        std::cerr << "Failed to enable RX channel" << std::endl;
-        LMS_Close(device);
-        return -1;
-    }
-    std::cout << "RX channel 0 enabled successfully." << std::endl;
-
-
-    // set RX sample rate to 1 MHz
+    // set RX sample rate, shared by all channels
     if (LMS_SetSampleRate(device, 30.72e6, 0) != 0)
     {
         std::cerr << "Failed to set RX sample rate" << std::endl;
@@ -81,7 +122,7 @@ int main()
     }
     std::cout << "RX sample rate set to 30.72 MHz." << std::endl;
 
-    // set center frequency to 2.4 GHz
+    // set center frequency to 2.4 GHz, the RX LO is shared as well
     if (LMS_SetLOFrequency(device, LMS_CH_RX, 0, 2.4e9) != 0)
     {
         std::cerr << "Failed to set RX center frequency" << std::endl;
@@ -90,177 +131,775 @@ int main()
     }
     std::cout << "RX center frequency set to 2.4 GHz." << std::endl;
 
-    // set antenna
-    // LMS_PATH_NONE = 0, ///<No active path (RX or TX)
-    // LMS_PATH_LNAH = 1, ///<RX LNA_H port
-    // LMS_PATH_LNAL = 2, ///<RX LNA_L port
-    // LMS_PATH_LNAW = 3, ///<RX LNA_W port
-    // LMS_PATH_TX1 = 1,  ///<TX port 1
-    // LMS_PATH_TX2 = 2,   ///<TX port 2
-    // LMS_PATH_AUTO = 255, ///<Automatically select port (if supported)
-    if (LMS_SetAntenna(device, LMS_CH_RX, 0, LMS_PATH_LNAH) != 0)
-    {
-        if (LMS_SetAntenna(device, LMS_CH_RX, 0, LMS_PATH_LNAL) != 0)
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        if (LMS_EnableChannel(device, LMS_CH_RX, ch, true) != 0)
+        {
+            std::cerr << "Failed to enable RX channel " << ch << std::endl;
+            LMS_Close(device);
+            return -1;
+        }
+        std::cout << "RX channel " << ch << " enabled successfully." << std::endl;
+
+        // set antenna
+        // LMS_PATH_NONE = 0, ///<No active path (RX or TX)
+        // LMS_PATH_LNAH = 1, ///<RX LNA_H port
+        // LMS_PATH_LNAL = 2, ///<RX LNA_L port
+        // LMS_PATH_LNAW = 3, ///<RX LNA_W port
+        // LMS_PATH_TX1 = 1,  ///<TX port 1
+        // LMS_PATH_TX2 = 2,   ///<TX port 2
+        // LMS_PATH_AUTO = 255, ///<Automatically select port (if supported)
+        if (LMS_SetAntenna(device, LMS_CH_RX, ch, LMS_PATH_LNAH) != 0)
         {
-            if (LMS_SetAntenna(device, LMS_CH_RX, 0, LMS_PATH_LNAW) != 0)
+            if (LMS_SetAntenna(device, LMS_CH_RX, ch, LMS_PATH_LNAL) != 0)
             {
-                std::cerr << "Failed to set RX antenna" << std::endl;
-                LMS_Close(device);
-                return -1;
+                if (LMS_SetAntenna(device, LMS_CH_RX, ch, LMS_PATH_LNAW) != 0)
+                {
+                    std::cerr << "Failed to set RX antenna" << std::endl;
+                    LMS_Close(device);
+                    return -1;
+                }
             }
         }
-    }
-    std::cout << "RX antenna set to " << LMS_GetAntenna(device, LMS_CH_RX, 0) << std::endl;
+        std::cout << "RX antenna set to " << LMS_GetAntenna(device, LMS_CH_RX, ch) << std::endl;
 
-    unsigned int gain = 20;
-    // set gain in dB
-    if (LMS_SetGaindB(device, LMS_CH_RX, 0, gain) != 0)
-    {
-        std::cerr << "Failed to set RX gain" << std::endl;
-        LMS_Close(device);
-        return -1;
+        // set gain in dB
+        if (LMS_SetGaindB(device, LMS_CH_RX, ch, gain) != 0)
+        {
+            std::cerr << "Failed to set RX gain" << std::endl;
+            LMS_Close(device);
+            return -1;
+        }
+        std::cout << "RX gain was set to " << gain << " dB" << std::endl;
     }
-    unsigned int gainRead;
-    LMS_GetGaindB(device, LMS_CH_RX, 0, &gainRead);
-    std::cout << "RX gain was set to " << gain << " dB" << std::endl;
+    startup.mark("configure");
 
+    // LPF bandwidth and calibration of every channel, or the cached chip state.
+    // a config file restores the whole chip, so one entry covers the channels
+    // in use and a miss recalibrates all of them
     float bandwidth = 15.36e6; // 15.36 MHz for 30.72 MSPS SamplingRate
-    if (LMS_SetLPFBW(device, false, 0, bandwidth) != 0) 
+    CalOutcome cal_outcome = CAL_UNCACHED;
+    LimeCalibrationDevice cal_device(device, channels);
+    CalKey cal_key;
+    CalibrationCache *cache = cal_cache;
+    if (cache && cache->key(cal_device, 2.4e9, bandwidth, gain, &cal_key) != 0)
     {
-        std::cerr << "Failed to set RX LPF bandwidth" << std::endl;
-        LMS_Close(device);
-        return -1;
+        std::cerr << "Failed to read chip temperature, calibrating without the cache" << std::endl;
+        cache = nullptr;
     }
-    std::cout << "RX LPF bandwidth set to " << bandwidth / 1e6 << " MHz" << std::endl;
-
-    // calibrate the RX channel
-    if (LMS_Calibrate(device, LMS_CH_RX, 0, 15.36e6, 0) != 0)
+    cal_key.serial += "_" + std::to_string(channels) + "ch";
+    ret = cache ? cache->apply(cal_device, cal_key, bandwidth, &cal_outcome) : cal_device.calibrate(bandwidth);
+    if (ret != 0)
     {
-        std::cerr << "Failed to calibrate RX channel" << std::endl;
+        std::cerr << "Failed to calibrate the RX channels: " << cal_device.lastError() << std::endl;
         LMS_Close(device);
         return -1;
     }
-    std::cout << "RX channel calibrated successfully." << std::endl;
+    bool cal_loaded = cache && cal_outcome == CAL_HIT;
+    for (int ch = 0; ch < channels; ++ch)
+        std::cout << "RX channel " << ch << " LPF bandwidth " << bandwidth / 1e6 << " MHz, calibrated ("
+                  << (cache ? calOutcomeName(cal_outcome) : "no cache") << ")." << std::endl;
+    startup.mark(std::string(cal_loaded ? "load calibration" : "calibrate") + " ch0-" + std::to_string(channels - 1));
+
+    // setup one RX stream per channel
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        lms_stream_t *rx_Stream = &rx_Streams[ch];
+        rx_Stream->channel = ch;
+        rx_Stream->isTx = false; // RX stream
+        rx_Stream->fifoSize = 1024 * 1024; // Buffer size in samples
+        rx_Stream->throughputVsLatency = 0.5; // Balance throughput and latency
+        // 12-bit samples over USB, handed to us as int16 unless floats were asked for
+        rx_Stream->dataFmt = f32_mode ? lms_stream_t::LMS_FMT_F32 : lms_stream_t::LMS_FMT_I12;
+        rx_Stream->linkFmt = lms_stream_t::LMS_LINK_FMT_I12;
+        if (LMS_SetupStream(device, rx_Stream) != 0)
+        {
+            std::cerr << "Failed to setup RX stream " << ch << std::endl;
+            for (int k = 0; k < ch; ++k)
+                LMS_DestroyStream(device, &rx_Streams[k]);
+            LMS_Close(device);
+            return -1;
+        }
+    }
+    std::cout << "RX streams setup successfully." << std::endl;
 
+    // start the RX streams, channels of one board share its sample counter
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        if (LMS_StartStream(&rx_Streams[ch]) != 0)
+        {
+            std::cerr << "Failed to start RX stream " << ch << std::endl;
+            for (int k = 0; k < channels; ++k)
+            {
+                if (k < ch)
+                    LMS_StopStream(&rx_Streams[k]);
+                LMS_DestroyStream(device, &rx_Streams[k]);
+            }
+            LMS_Close(device);
+            return -1;
+        }
+    }
+    std::cout << channels << " RX stream(s) started successfully." << std::endl;
+    startup.mark("stream");
+    startup.report(std::cout);
+    *device_out = device;
+    return channels;
+}
+
+// stop and destroy the RX streams, then close the device
+static int stopDevice(lms_device_t *device, lms_stream_t *rx_Streams, int channels = 1)
+{
+    int ret = 0;
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        // stop RX stream
+        if (LMS_StopStream(&rx_Streams[ch]) != 0)
+        {
+            std::cerr << "Failed to stop RX stream " << ch << std::endl;
+            ret = -1;
+        }
 
-    // -----------------------------------------------------------------
-    // Attempt signals
+        // Destroy the RX stream
+        if (LMS_DestroyStream(device, &rx_Streams[ch]) != 0)
+        {
+            std::cerr << "Failed to destroy RX stream " << ch << std::endl;
+            ret = -1;
+        }
+    }
+    std::cout << "RX streams stopped and destroyed." << std::endl;
 
-    // setup RX stream
-    lms_stream_t rx_Stream;
-    rx_Stream.channel = 0; // RX channel 0
-    rx_Stream.isTx = false; // RX stream
-    rx_Stream.fifoSize = 1024 * 1024; // Buffer size in samples
-    rx_Stream.throughputVsLatency = 0.5; // Balance throughput and latency
-    if (LMS_SetupStream(device, &rx_Stream) != 0)
+    // Close the device
+    if (LMS_Close(device) != 0)
     {
-        std::cerr << "Failed to setup RX stream" << std::endl;
-        LMS_Close(device);
+        std::cerr << "Device failed to close" << std::endl;
         return -1;
     }
-    std::cout << "RX stream setup successfully." << std::endl;
+    std::cout << "Disconnected" << std::endl;
+    return ret;
+}
+#else
+// built without LimeSuite: the modes that need a board say so
+static int noDevice()
+{
+    std::cerr << "Built without LimeSuite, only --replay <file> and --synthetic run" << std::endl;
+    return -1;
+}
+#endif
+
+// --sweep: step the LO through the points and report mean power at each,
+// instead of streaming into the ring
+static int runSweep(RxSource *source, Tuner *tuner, double sample_rate, IqSampleFormat fmt,
+                    const std::vector<SweepPoint> &points, uint32_t settle_samples)
+{
+    SweepEngine sweep(source, tuner, sample_rate, fmt);
+    sweep.setPoints(points);
+    sweep.setSettleSamples(settle_samples);
+    // sums of the dwell in progress, written by the processing thread only.
+    // a dwell whose last block was dropped is discarded when the next one starts
+    PowerSums sums{0, 0};
+    uint64_t count = 0;
+    uint64_t dwell_sweep = UINT64_MAX;
+    uint32_t dwell_point = UINT32_MAX;
+    std::vector<float> last_dbfs(points.size(), -200.0f);
+    const PowerKernels &kernels = bestPowerKernels();
+    float full_scale = fmt == IQ_FMT_F32 ? 1.0f : LMS_I12_FULL_SCALE;
+    sweep.setProcessor([&](const void *samples, const SweepBlock &block)
+    {
+        if (block.sweep != dwell_sweep || block.point != dwell_point)
+        {
+            sums = PowerSums{0, 0};
+            count = 0;
+            dwell_sweep = block.sweep;
+            dwell_point = block.point;
+        }
+        PowerSums s = fmt == IQ_FMT_I16 ? kernels.i16(static_cast<const int16_t *>(samples), block.count)
+                                        : kernels.f32(static_cast<const float *>(samples), block.count);
+        sums.sum += s.sum;
+        count += block.count;
+        if (block.last)
+        {
+            last_dbfs[block.point] = powerToDb(sums.sum / count / (full_scale * full_scale));
+            // a late block of the same dwell starts over rather than adding to it
+            dwell_point = UINT32_MAX;
+        }
+    });
+    if (sweep.start() != 0)
+    {
+        std::cerr << "Failed to start sweep: " << sweep.error() << std::endl;
+        return -1;
+    }
+    std::cout << "Sweeping " << points.size() << " points from " << points.front().hz / 1e6 << " to "
+              << points.back().hz / 1e6 << " MHz, Ctrl+C to stop." << std::endl;
 
-    // start RX stream
-    if (LMS_StartStream(&rx_Stream) != 0)
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    while (sweep.running() && !stop_requested)
     {
-        std::cerr << "Failed to start RX stream" << std::endl;
-        LMS_DestroyStream(device, &rx_Stream);
-        LMS_Close(device);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        sweep.report(std::cout);
+    }
+    sweep.stop();
+    if (!sweep.error().empty())
+        std::cerr << "Sweep failed: " << sweep.error() << std::endl;
+    for (size_t i = 0; i < points.size(); ++i)
+        std::cout << "  " << points[i].hz / 1e6 << " MHz: " << last_dbfs[i] << " dBFS" << std::endl;
+    return sweep.error().empty() ? 0 : -1;
+}
+
+// --devices: one ring (/limesuite_shm_<k>) and one pinned capture thread per
+// stream, a power stage on each, and an aligned reader checking the streams
+// line up on the common timeline. with rt_cpus the capture threads run
+// SCHED_FIFO at rt_priority on those CPUs round robin instead
+static int runMulti(std::vector<std::unique_ptr<RxSource>> &sources, const std::vector<int> &groups,
+                    double sample_rate, IqSampleFormat fmt, const std::vector<int> &rt_cpus, int rt_priority,
+                    bool huge_pages)
+{
+    const uint32_t block_samples = 1024;
+    float full_scale = fmt == IQ_FMT_F32 ? 1.0f : LMS_I12_FULL_SCALE;
+    MultiCapture multi(block_samples, fmt, sample_rate, full_scale);
+    multi.setHugePages(huge_pages);
+    std::vector<std::unique_ptr<PowerMeter>> meters;
+    std::unique_ptr<std::atomic<float>[]> dbfs(new std::atomic<float>[sources.size()]);
+    for (size_t k = 0; k < sources.size(); ++k)
+    {
+        int cpu = rt_cpus.empty() ? int(k) % onlineCpus() : rt_cpus[k % rt_cpus.size()];
+        if (multi.add("/limesuite_shm_" + std::to_string(k), sources[k].get(), groups[k], cpu) != 0)
+        {
+            std::cerr << "Failed to create ring for stream " << k << std::endl;
+            return -1;
+        }
+        if (!rt_cpus.empty())
+            multi.pipeline(k).setRealtime(rt_priority);
+        meters.emplace_back(new PowerMeter(sample_rate));
+        dbfs[k] = -200.0f;
+        PowerMeter *meter = meters.back().get();
+        std::atomic<float> *reading = &dbfs[k];
+        multi.pipeline(k).addStage("power", [=](const void *samples, const IqBlockInfo &info)
+        {
+            reading->store(meter->process(samples, info.count, fmt, full_scale).emaDbfs, std::memory_order_relaxed);
+        });
+    }
+    if (multi.start() != 0)
+    {
+        std::cerr << "Failed to start capture: " << multi.error() << std::endl;
         return -1;
     }
-    std::cout << "RX stream started successfully." << std::endl;
+    std::cout << "Capturing " << multi.size() << " streams on " << onlineCpus() << " CPUs, Ctrl+C to stop." << std::endl;
 
-    // receive stream
-    float samples[1024];
-    lms_stream_meta_t meta;
-    // if(LMS_RecvStream(&rx_Stream, &samples, 1024, &meta, 1000) != 0)
-    // {
-    //     std::cerr << "Failed to receive samples" << std::endl;
-    //     LMS_StopStream(&rx_Stream);
-    //     LMS_DestroyStream(device, &rx_Stream);
-    //     LMS_Close(device);
-    //     return -1;
-    // }
-    // std::cout << "Received samples successfully." << std::endl;
+    // the aligned reader starts once every stream has delivered a block
+    std::atomic<uint64_t> aligned_blocks{0}, aligned_dropped{0};
+    std::atomic<bool> aligning{true};
+    std::thread aligner([&]
+    {
+        std::vector<int64_t> offsets;
+        while (aligning && !multi.offsets(&offsets))
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::vector<std::string> names;
+        for (size_t k = 0; k < multi.size(); ++k)
+            names.push_back(multi.ringName(k));
+        AlignedReader reader;
+        if (!aligning || reader.open(names, offsets) != 0)
+            return;
+        std::vector<std::vector<uint8_t>> blocks;
+        uint64_t timestamp;
+        while (aligning)
+        {
+            if (!reader.read(block_samples, blocks, &timestamp, 100))
+                continue;
+            aligned_blocks.fetch_add(1, std::memory_order_relaxed);
+            aligned_dropped.store(reader.dropped(), std::memory_order_relaxed);
+        }
+    });
 
-    // Open shared memory object
-    const char *shm_name = "/limesuite_shm";
-    shm_unlink(shm_name); // Ensure no stale shared memory exists
-    int shm_fd = shm_open(shm_name, O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1)
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    while (multi.running() && !stop_requested)
     {
-        std::cerr << "Failed to open shared memory object" << std::endl;
-        LMS_StopStream(&rx_Stream);
-        LMS_DestroyStream(device, &rx_Stream);
-        LMS_Close(device);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        multi.report(std::cout);
+        std::cout << "  aligned: " << aligned_blocks.load() << " blocks, " << aligned_dropped.load()
+                  << " samples dropped lining up, power";
+        for (size_t k = 0; k < multi.size(); ++k)
+            std::cout << " " << dbfs[k].load();
+        std::cout << " dBFS" << std::endl;
+    }
+    aligning = false;
+    aligner.join();
+    multi.stop();
+    if (!multi.error().empty())
+    {
+        std::cerr << "Capture failed: " << multi.error() << std::endl;
         return -1;
     }
-    std::cout << "Shared memory created with fd: " << shm_fd << std::endl;
+    return 0;
+}
 
-    // Set the size of the shared memory object
-    size_t shm_size = 1024 * sizeof(float); // Adjust size as needed
-    if (ftruncate(shm_fd, shm_size) == -1)
+int main(int argc, char **argv)
+{
+    // --copy receives into a local buffer and copies it into the ring,
+    // the default receives straight into the claimed ring slot
+    // --f32 streams floats instead of the device's native 12-bit samples
+    // --tone <Hz> / --decim <ratio> set the narrowband decimation stage
+    // --tones <Hz,Hz,...> lists the probe tones to lock in on (default --tone)
+    // --record <basePath> writes the raw stream to basePath.sigmf-data/-meta
+    // --replay <file> / --synthetic run without a device, as fast as the
+    // stages keep up unless --paced holds them to the sample rate
+    // --sweep <startHz> <stopHz> <points> steps the LO instead, keeping
+    // --dwell <us> of samples per point after --settle <us> of PLL settling;
+    // with --synthetic it sweeps a simulated device
+    // --cal-cache <dir> keeps calibrations there (default ~/.cache/limesdr4edema),
+    // --no-cal-cache always calibrates, --recal calibrates and replaces the entry
+    // --devices <N> captures every RX channel of the first N boards (0 for
+    // all) at once, with --synthetic N simulated single-channel devices
+    // --realtime <cpu[,cpu...]> pins capture to the first CPU and the stages
+    // to the rest, runs them SCHED_FIFO at --rt-priority <n> (default 80,
+    // stages one lower) and locks all memory; --hugepages backs the rings with
+    // huge pages; --jitter-test <seconds> only measures wakeup latency under
+    // the same settings and exits
+    // --gap-fill publishes zeros over samples lost between blocks instead of
+    // only tagging the block after them; --drop-every <N> makes --synthetic
+    // lose 1000 samples in front of every Nth block
+    // --iq-correct takes DC offset and IQ imbalance out of what the PSD and
+    // lock-in stages see
+    bool copy_mode = false;
+    bool f32_mode = false;
+    double tone_hz = 100e3;
+    std::vector<double> lockin_hz;
+    unsigned decim_ratio = 1024;
+    const char *record_path = nullptr;
+    const char *replay_path = nullptr;
+    bool synthetic = false;
+    bool paced = false;
+    double sweep_start = 0, sweep_stop = 0;
+    unsigned sweep_count = 0;
+    double dwell_us = 1000, settle_us = 100;
+    const char *home = getenv("HOME");
+    std::string cal_dir = std::string(home ? home : ".") + "/.cache/limesdr4edema";
+    bool use_cal_cache = true, recal = false;
+    int multi_devices = -1;
+    std::vector<int> rt_cpus;
+    int rt_priority = 80;
+    bool huge_pages = false;
+    double jitter_seconds = 0;
+    bool gap_fill = false;
+    bool iq_correct = false;
+    unsigned drop_every = 0;
+    for (int i = 1; i < argc; ++i)
     {
-        std::cerr << "Failed to set size of shared memory object" << std::endl;
-        close(shm_fd);
-        shm_unlink(shm_name);
-        LMS_StopStream(&rx_Stream);
-        LMS_DestroyStream(device, &rx_Stream);
-        LMS_Close(device);
-        return -1;
+        if (strcmp(argv[i], "--copy") == 0) copy_mode = true;
+        else if (strcmp(argv[i], "--f32") == 0) f32_mode = true;
+        else if (strcmp(argv[i], "--tone") == 0 && i + 1 < argc) tone_hz = atof(argv[++i]);
+        else if (strcmp(argv[i], "--tones") == 0 && i + 1 < argc)
+        {
+            for (char *hz = strtok(argv[++i], ","); hz; hz = strtok(nullptr, ","))
+                lockin_hz.push_back(atof(hz));
+        }
+        else if (strcmp(argv[i], "--decim") == 0 && i + 1 < argc)
+        {
+            char *end;
+            unsigned long ratio = strtoul(argv[++i], &end, 10);
+            if (*end || end == argv[i] || ratio > UINT32_MAX || !DecimatorChain::supports(unsigned(ratio)))
+            {
+                std::cerr << "--decim " << argv[i] << ": not a ratio the CIC + halfband chain can realise (1 or more, "
+                          << "at most " << CicDecimator::maxRatio(4) << " left for the CIC after dividing out up to "
+                          << "3 halfbands)" << std::endl;
+                return -1;
+            }
+            decim_ratio = unsigned(ratio);
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replay_path = argv[++i];
+        else if (strcmp(argv[i], "--synthetic") == 0) synthetic = true;
+        else if (strcmp(argv[i], "--paced") == 0) paced = true;
+        else if (strcmp(argv[i], "--sweep") == 0 && i + 3 < argc)
+        {
+            sweep_start = atof(argv[++i]);
+            sweep_stop = atof(argv[++i]);
+            // strtoul takes "-1" as a huge count, the sign is refused first
+            char *end = argv[++i];
+            unsigned long count = *end == '-' ? 0 : strtoul(argv[i], &end, 10);
+            if (count < 1 || *end || count > UINT32_MAX)
+            {
+                std::cerr << "--sweep: point count " << argv[i] << " is not a number of 1 or more" << std::endl;
+                return -1;
+            }
+            sweep_count = unsigned(count);
+        }
+        else if (strcmp(argv[i], "--dwell") == 0 && i + 1 < argc) dwell_us = atof(argv[++i]);
+        else if (strcmp(argv[i], "--settle") == 0 && i + 1 < argc) settle_us = atof(argv[++i]);
+        else if (strcmp(argv[i], "--cal-cache") == 0 && i + 1 < argc) cal_dir = argv[++i];
+        else if (strcmp(argv[i], "--no-cal-cache") == 0) use_cal_cache = false;
+        else if (strcmp(argv[i], "--recal") == 0) recal = true;
+        else if (strcmp(argv[i], "--devices") == 0 && i + 1 < argc) multi_devices = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--realtime") == 0 && i + 1 < argc)
+        {
+            for (char *cpu = strtok(argv[++i], ","); cpu; cpu = strtok(nullptr, ","))
+                rt_cpus.push_back(atoi(cpu));
+        }
+        else if (strcmp(argv[i], "--rt-priority") == 0 && i + 1 < argc) rt_priority = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--hugepages") == 0) huge_pages = true;
+        else if (strcmp(argv[i], "--jitter-test") == 0 && i + 1 < argc) jitter_seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--gap-fill") == 0) gap_fill = true;
+        else if (strcmp(argv[i], "--iq-correct") == 0) iq_correct = true;
+        else if (strcmp(argv[i], "--drop-every") == 0 && i + 1 < argc) drop_every = atoi(argv[++i]);
     }
 
-    // Map the shared memory object to the process's address space
-    float *shm_ptr = static_cast<float *>(mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0));
-    if (shm_ptr == MAP_FAILED)
+    for (int cpu : rt_cpus)
     {
-        std::cerr << "Failed to map shared memory object" << std::endl;
-        close(shm_fd);
-        shm_unlink(shm_name);
-        LMS_StopStream(&rx_Stream);
-        LMS_DestroyStream(device, &rx_Stream);
-        LMS_Close(device);
-        return -1;
+        if (cpu < 0 || cpu >= onlineCpus())
+        {
+            std::cerr << "--realtime: cpu " << cpu << " out of range, " << onlineCpus() << " online" << std::endl;
+            return -1;
+        }
     }
-    std::cout << "Shared memory object mapped successfully." << std::endl;
 
-    // Receive samples and write to shared memory
-    while (true)
+    // wakeup latency of a thread set up like the capture thread would be
+    if (jitter_seconds > 0)
     {
-        // Receive samples
-        int samples_received = LMS_RecvStream(&rx_Stream, &samples, 1024, &meta, 1000);
-        if (samples_received < 0) {
-            std::cerr << "Failed to receive samples: " << LMS_GetLastErrorMessage() << std::endl;
-            break;
+        const unsigned period_us = 100;
+        if (!rt_cpus.empty())
+            lockMemory();
+        JitterResult jitter = jitterSelfTest(jitter_seconds, period_us, rt_cpus.empty() ? -1 : rt_cpus[0],
+                                             rt_cpus.empty() ? 0 : rt_priority);
+        reportJitter(std::cout, jitter, period_us);
+        return 0;
+    }
+    // before the device is opened, so the driver's buffers are locked too
+    if (!rt_cpus.empty())
+    {
+        if (lockMemory() == 0)
+            std::cout << "Memory locked" << std::endl;
+        else
+            std::cerr << "Running with pageable memory" << std::endl;
+    }
+
+    double sample_rate = 30.72e6;
+    unsigned int gain = 20;
+    IqSampleFormat ring_format = f32_mode ? IQ_FMT_F32 : IQ_FMT_I16;
+
+    // a cache that cannot be opened only costs the full calibration
+    CalibrationCache cal_cache;
+    [[maybe_unused]] CalibrationCache *cal = nullptr;
+    if (use_cal_cache && !synthetic && !replay_path && cal_cache.open(cal_dir) == 0)
+    {
+        cal_cache.setForce(recal);
+        cal = &cal_cache;
+    }
+
+    // pick where samples come from: a recording, a generated tone or the board
+#ifdef HAVE_LIMESUITE
+    lms_device_t *device = nullptr;
+    lms_stream_t rx_Stream;
+#endif
+    // stop and close the board, if one was opened
+    auto closeDevice = [&]() -> int
+    {
+#ifdef HAVE_LIMESUITE
+        if (device)
+            return stopDevice(device, &rx_Stream);
+#endif
+        return 0;
+    };
+    if (sweep_count > 0)
+    {
+        std::vector<SweepPoint> points;
+        for (unsigned k = 0; k < sweep_count; ++k)
+        {
+            double hz = sweep_count > 1 ? sweep_start + (sweep_stop - sweep_start) * k / (sweep_count - 1) : sweep_start;
+            points.push_back({hz, uint32_t(dwell_us * 1e-6 * sample_rate)});
+        }
+        uint32_t settle_samples = uint32_t(settle_us * 1e-6 * sample_rate);
+        if (synthetic)
+        {
+            SweepSimulator sim(sample_rate, tone_hz, ring_format);
+            return runSweep(&sim.rx, &sim.tuner, sample_rate, ring_format, points, settle_samples);
+        }
+        if (replay_path)
+        {
+            std::cerr << "--sweep needs a device or --synthetic" << std::endl;
+            return -1;
+        }
+#ifdef HAVE_LIMESUITE
+        if (startDevice(&device, &rx_Stream, 0, 1, f32_mode, gain, cal) < 0)
+            return -1;
+        LimeRxSource rx(&rx_Stream);
+        LimeTuner tuner(device, 0);
+        int ret = runSweep(&rx, &tuner, sample_rate, ring_format, points, settle_samples);
+        stopDevice(device, &rx_Stream);
+        return ret;
+#else
+        return noDevice();
+#endif
+    }
+    if (multi_devices >= 0)
+    {
+        std::vector<std::unique_ptr<RxSource>> sources;
+        std::vector<int> groups;
+        if (synthetic)
+        {
+            for (int k = 0; k < std::max(multi_devices, 1); ++k)
+            {
+                sources.emplace_back(new SyntheticRxSource(sample_rate, tone_hz, 0.5f, 0.01f, paced, 1 << 16, ring_format));
+                groups.push_back(k);
+            }
+            return runMulti(sources, groups, sample_rate, ring_format, rt_cpus, rt_priority, huge_pages);
+        }
+#ifdef HAVE_LIMESUITE
+        lms_info_str_t list[8];
+        int found = LMS_GetDeviceList(list);
+        int boards = multi_devices > 0 ? std::min(multi_devices, found) : found;
+        std::vector<lms_device_t *> devices(std::max(boards, 0), nullptr);
+        std::vector<lms_stream_t> streams(devices.size() * LIME_MAX_RX_CHANNELS);
+        std::vector<int> channels(devices.size(), 0);
+        int ret = 0;
+        for (int d = 0; d < boards && ret == 0; ++d)
+        {
+            channels[d] = startDevice(&devices[d], &streams[d * LIME_MAX_RX_CHANNELS], d, 0, f32_mode, gain, cal);
+            if (channels[d] < 0)
+            {
+                channels[d] = 0;
+                ret = -1;
+            }
+            for (int ch = 0; ch < channels[d]; ++ch)
+            {
+                sources.emplace_back(new LimeRxSource(&streams[d * LIME_MAX_RX_CHANNELS + ch]));
+                groups.push_back(d);
+            }
         }
-        memcpy(shm_ptr, samples, sizeof(samples));
-        std::cout << "Relayed " << sizeof(samples) / sizeof(float) << " samples." << std::endl;
-        usleep(10000); // Sleep for a while to simulate processing
+        if (boards <= 0)
+            std::cerr << "No LimeSDR devices found! (--synthetic --devices <N> simulates them)" << std::endl;
+        else if (ret == 0)
+            ret = runMulti(sources, groups, sample_rate, ring_format, rt_cpus, rt_priority, huge_pages);
+        sources.clear();
+        for (int d = 0; d < boards; ++d)
+            if (devices[d])
+                stopDevice(devices[d], &streams[d * LIME_MAX_RX_CHANNELS], channels[d]);
+        return boards > 0 ? ret : -1;
+#else
+        return noDevice();
+#endif
+    }
+    std::unique_ptr<RxSource> source;
+    if (replay_path)
+    {
+        ReplayRxSource *replay = new ReplayRxSource;
+        source.reset(replay);
+        ReplayInfo replay_info = {ring_format, sample_rate, 2.4e9, 0};
+        if (replay->open(replay_path, replay_info, paced) != 0)
+            return -1;
+        ring_format = replay->format();
+        sample_rate = replay->sampleRate();
+        std::cout << "Replaying " << replay->fileSamples() << " samples from " << replay_path
+                  << " at " << sample_rate / 1e6 << " MSPS" << (paced ? "" : " (unpaced)") << std::endl;
+    }
+    else if (synthetic)
+    {
+        SyntheticRxSource *synth = new SyntheticRxSource(sample_rate, tone_hz, 0.5f, 0.01f, paced, 1 << 16, ring_format);
+        synth->setDropEvery(drop_every, 1000);
+        source.reset(synth);
+        // the tone actually sent, rounded to whole cycles of the table; the
+        // lock-in and DDC below tune to it
+        tone_hz = synth->toneHz();
+        std::cout << "Generating a synthetic " << tone_hz / 1e3 << " kHz tone" << (paced ? "" : " (unpaced)") << std::endl;
+    }
+    else
+    {
+#ifdef HAVE_LIMESUITE
+        if (startDevice(&device, &rx_Stream, 0, 1, f32_mode, gain, cal) < 0)
+            return -1;
+        source.reset(new LimeRxSource(&rx_Stream));
+#else
+        return noDevice();
+#endif
     }
 
-    // Cleanup
-    munmap(shm_ptr, shm_size);
-    close(shm_fd);
-    shm_unlink(shm_name);    
+    // receive stream
+    // 1024 IQ pairs per block, interleaved I,Q (int16 or float)
+    const uint32_t block_samples = 1024;
 
-    // stop RX stream
-    if (LMS_StopStream(&rx_Stream) != 0)
+    // Create the shared memory ring readers attach to
+    // 256 slots of one block each (~8.5 ms of history at 30.72 MSPS,
+    // 1 MB as int16, 2 MB as float)
+    const char *shm_name = "/limesuite_shm";
+    IqRingWriter ring;
+    float full_scale = ring_format == IQ_FMT_F32 ? 1.0f : LMS_I12_FULL_SCALE;
+    ring.setHugePages(huge_pages);
+    if (ring.create(shm_name, 256, block_samples, ring_format, sample_rate, full_scale) != 0)
     {
-        std::cerr << "Failed to stop RX stream" << std::endl;
-        LMS_DestroyStream(device, &rx_Stream);
-        LMS_Close(device);
+        std::cerr << "Failed to create shared memory ring" << std::endl;
+        closeDevice();
         return -1;
     }
-    std::cout << "RX stream stopped successfully." << std::endl;
+    // stages that caught up sleep on the ring's futex; waking them every
+    // 4 blocks (~133 us at 30.72 MSPS) keeps wake syscalls off most publishes
+    ring.setWakeBatch(4);
+    std::cout << "Shared memory ring created at " << shm_name << std::endl;
+
+    // Capture on its own thread, processing stages read the ring behind it
+    CapturePipeline pipeline(source.get(), &ring, shm_name);
+    pipeline.setCopyMode(copy_mode);
+    pipeline.setGapPolicy(gap_fill ? GAP_ZERO_FILL : GAP_MARK);
+    if (!rt_cpus.empty())
+    {
+        pipeline.setCpu(rt_cpus[0]);
+        pipeline.setRealtime(rt_priority, std::vector<int>(rt_cpus.begin() + 1, rt_cpus.end()));
+        std::cout << "Real-time capture on CPU " << rt_cpus[0] << " at SCHED_FIFO " << rt_priority << std::endl;
+    }
 
-    // Destroy the RX stream
-    if (LMS_DestroyStream(device, &rx_Stream) != 0)
+    // per-step latency histograms and stream status for statsView.py
+    StatsPage stats;
+    if (stats.create() != 0)
+        std::cerr << "Failed to create stats shared memory, running without telemetry" << std::endl;
+    else
+        pipeline.setStats(&stats);
+
+    // power / RSSI alongside capture, published to /limesuite_power
+    PowerMeter power(sample_rate);
+    PowerPublisher power_shm;
+    if (power_shm.create() != 0)
+        std::cerr << "Failed to create power shared memory, readings stay local" << std::endl;
+    std::atomic<float> power_dbfs{-200.0f};
+    pipeline.addStage("power", [&](const void *samples, const IqBlockInfo &info)
     {
-        std::cerr << "Failed to destroy RX stream" << std::endl;
-        LMS_Close(device);
+        PowerReading reading = power.process(samples, info.count, ring_format, full_scale, info.block, info.timestamp);
+        power_shm.publish(reading);
+        power_dbfs.store(reading.emaDbfs, std::memory_order_relaxed);
+    });
+
+    // Welch PSD frames to /limesuite_psd: 4096 bins, 50% overlap,
+    // 128 segments per frame, a 2048 sample hop each: 262144 samples, ~117
+    // frames/s at 30.72 MSPS
+    const size_t psd_bins = 4096;
+    const size_t psd_averages = 128;
+    WelchPsd psd(psd_bins, psd_averages, sample_rate);
+    // each corrected stage tracks the impairments itself, on its own thread
+    IqCorrector psd_corrector, lockin_corrector;
+    PsdPublisher psd_shm;
+    if (psd_shm.create(psd_bins, psd_averages, sample_rate) != 0)
+        std::cerr << "Failed to create PSD shared memory, frames stay local" << std::endl;
+    pipeline.addFloatStage("psd", [&](const float *samples, const IqBlockInfo &info)
+    {
+        // segments must be contiguous in time
+        if (info.lost || (info.flags & (IQ_BLOCK_GAP | IQ_BLOCK_RESTART))) psd.restartSegment();
+        if (psd.push(samples, info.count) > 0) psd_shm.publish(psd.frame(), info.timestamp);
+    }, iq_correct ? &psd_corrector : nullptr);
+
+    // amplitude, phase and SNR of the probe tones over 10 ms windows
+    if (lockin_hz.empty())
+        lockin_hz.push_back(tone_hz);
+    LockInBank lockin(lockin_hz, sample_rate, uint32_t(sample_rate / 100));
+    std::mutex lockin_mutex;
+    std::vector<ToneReading> lockin_latest = lockin.readings();
+    IqImbalance imbalance_latest = lockin_corrector.estimate();
+    pipeline.addFloatStage("lockin", [&](const float *samples, const IqBlockInfo &info)
+    {
+        if (lockin.push(samples, info.count, info.timestamp) > 0)
+        {
+            std::lock_guard<std::mutex> lock(lockin_mutex);
+            lockin_latest = lockin.readings();
+            imbalance_latest = lockin_corrector.estimate();
+        }
+    }, iq_correct ? &lockin_corrector : nullptr);
+
+    // tone mixed to DC and decimated, narrowband consumers read /limesuite_ddc
+    DecimatorChain ddc(DecimatorChain::forRatio(sample_rate, tone_hz, decim_ratio));
+    IqRingWriter ddc_ring;
+    ddc_ring.setHugePages(huge_pages);
+    const uint32_t ddc_block = 256;
+    if (ddc_ring.create("/limesuite_ddc", 64, ddc_block, IQ_FMT_F32, ddc.outputRate()) != 0)
+        std::cerr << "Failed to create decimated ring" << std::endl;
+    std::vector<std::complex<float>> ddc_out;
+    ddc_out.reserve(2 * ddc_block);
+    uint64_t ddc_timestamp = 0;
+    bool ddc_started = false;
+    pipeline.addStage("ddc", [&](const void *samples, const IqBlockInfo &info)
+    {
+        // start on the timeline, and pick it up again after samples went
+        // missing with nothing from before the gap left in the filters
+        if (!ddc_started || info.lost || (info.flags & (IQ_BLOCK_GAP | IQ_BLOCK_RESTART)))
+        {
+            ddc_started = true;
+            ddc.reset(info.timestamp);
+            ddc_out.clear();
+            ddc_timestamp = info.timestamp;
+        }
+        if (ring_format == IQ_FMT_I16)
+            ddc.process(static_cast<const int16_t *>(samples), info.count, full_scale, ddc_out);
+        else
+            ddc.process(static_cast<const float *>(samples), info.count, ddc_out);
+        // timestamps on the decimated ring count input samples
+        while (ddc_out.size() >= ddc_block && ddc_ring.header())
+        {
+            ddc_ring.write(ddc_out.data(), ddc_block, ddc_timestamp);
+            ddc_timestamp += uint64_t(ddc_block) * ddc.ratio();
+            ddc_out.erase(ddc_out.begin(), ddc_out.begin() + ddc_block);
+        }
+    });
+    // recording runs as one more stage, so a slow disk drops ring blocks
+    // (counted in the stage report) instead of stalling capture
+    IqRecorder recorder;
+    if (record_path)
+    {
+        RecordingInfo rec_info = {ring_format, sample_rate, 2.4e9, double(gain), 0, synthetic ? "synthetic" : replay_path ? "replay" : "LimeSDR"};
+        if (recorder.open(record_path, rec_info) != 0)
+        {
+            std::cerr << "Failed to open recording " << record_path << std::endl;
+            record_path = nullptr;
+        }
+    }
+    if (record_path)
+    {
+        // blocks lost on capture or dropped here show up as timestamp jumps,
+        // each starts a new capture in the SigMF metadata
+        pipeline.addStage("record", [&](const void *samples, const IqBlockInfo &info)
+        {
+            recorder.writeBlock(samples, info.count, info.timestamp, info.flags);
+        });
+        std::cout << "Recording to " << record_path << ".sigmf-data (" << recorder.backend() << ")" << std::endl;
+    }
+
+    std::cout << "Decimating " << decim_ratio << "x around " << tone_hz / 1e3 << " kHz to "
+              << ddc.outputRate() / 1e3 << " kS/s" << std::endl;
+    if (pipeline.start() != 0)
+    {
+        std::cerr << "Failed to start capture pipeline" << std::endl;
+        closeDevice();
         return -1;
     }
-    std::cout << "RX stream destroyed successfully." << std::endl;
+    std::cout << "Capture pipeline started, Ctrl+C to stop." << std::endl;
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    while (pipeline.running() && !stop_requested)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        pipeline.report(std::cout);
+        std::cout << "  power: " << power_dbfs.load() << " dBFS (" << power.kernelName() << ")" << std::endl;
+        std::lock_guard<std::mutex> lock(lockin_mutex);
+        for (const ToneReading &tone : lockin_latest)
+            std::cout << "  tone " << tone.hz / 1e3 << " kHz: " << tone.dbfs << " dBFS, phase " << tone.phase
+                      << " rad, SNR " << tone.snrDb << " dB (" << lockin.kernelName() << ")" << std::endl;
+        if (iq_correct)
+            std::cout << "  iq correction: DC " << imbalance_latest.dcI << ", " << imbalance_latest.dcQ << ", gain "
+                      << imbalance_latest.gainDb << " dB, phase " << imbalance_latest.phaseDeg << " deg, image rejection "
+                      << imbalance_latest.imageRejectionDb << " dB uncorrected (" << lockin_corrector.kernelName() << ")"
+                      << std::endl;
+    }
+    pipeline.stop();
+    if (!pipeline.error().empty())
+        std::cerr << "Failed to receive samples: " << pipeline.error() << std::endl;
+
+    // Cleanup
+    if (record_path)
+    {
+        recorder.close();
+        const RecorderStats &rec = recorder.stats();
+        std::cout << "Recorded " << rec.bytes / 1e6 << " MB, " << rec.stalls << " stalls, "
+                  << rec.errors << " write errors, " << rec.lostBytes / 1e6 << " MB lost, "
+                  << rec.discontinuities << " discontinuities" << std::endl;
+    }
+    ring.close();
+
     // -----------------------------------------------------------------
 
 
@@ -312,12 +951,8 @@ int main()
 
 
     // Close the device
-    if (LMS_Close(device) != 0)
-    {
-        std::cerr << "Device failed to close" << std::endl;
+    if (closeDevice() != 0)
         return 1;
-    }
-    std::cout << "Disconnected" << std::endl;
 
     return 0;
 }
\ No newline at end of file
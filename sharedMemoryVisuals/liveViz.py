@@ -1,12 +1,62 @@
 import mmap
+import ctypes
 import numpy as np
 import matplotlib.pyplot as plt
 import os
 import time
+from shmNotify import ShmNotifier
 
 # Shared memory name
 shm_name = "/dev/shm/limesuite_shm"
 
+# ring layout, mirrors iqRing.h
+IQ_RING_MAGIC = 0x4e525149
+IQ_RING_VERSION = 3
+IQ_RING_MAX_READERS = 8
+IQ_FMT_I16 = 1
+# slot flags, mirror continuity.h
+IQ_BLOCK_GAP = 0x1
+IQ_BLOCK_RESTART = 0x4
+IQ_BLOCK_FILLED = 0x8
+
+class IqRingReaderInfo(ctypes.Structure):
+    _fields_ = [
+        ("pid", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+        ("cursor", ctypes.c_uint64),
+        ("overruns", ctypes.c_uint64),
+        ("pad", ctypes.c_uint8 * 40),
+    ]
+
+class IqRingHeader(ctypes.Structure):
+    _fields_ = [
+        ("magic", ctypes.c_uint32),
+        ("version", ctypes.c_uint32),
+        ("headerSize", ctypes.c_uint32),
+        ("slotCount", ctypes.c_uint32),
+        ("slotSamples", ctypes.c_uint32),
+        ("sampleFormat", ctypes.c_uint32),
+        ("bytesPerSample", ctypes.c_uint32),
+        ("slotStride", ctypes.c_uint32),
+        ("sampleRate", ctypes.c_double),
+        ("fullScale", ctypes.c_float),
+        ("pad", ctypes.c_uint8 * 20),
+        ("writeCursor", ctypes.c_uint64),
+        ("notifySeq", ctypes.c_uint32),
+        ("notifyWaiters", ctypes.c_uint32),
+        ("pad2", ctypes.c_uint8 * 48),
+        ("readers", IqRingReaderInfo * IQ_RING_MAX_READERS),
+    ]
+
+class IqSlotHeader(ctypes.Structure):
+    _fields_ = [
+        ("seq", ctypes.c_uint64),
+        ("timestamp", ctypes.c_uint64),
+        ("count", ctypes.c_uint32),
+        ("flags", ctypes.c_uint32),
+        ("pad", ctypes.c_uint8 * 40),
+    ]
+
 # Open shared memory with retry
 shm_fd = None
 while shm_fd is None:
@@ -20,38 +70,78 @@ while shm_fd is None:
         time.sleep(0.5)
 
 # Map shared memory
-shm = mmap.mmap(shm_fd, 1024 * 4, mmap.MAP_SHARED, mmap.PROT_READ)  # 1024 floats
+shm = mmap.mmap(shm_fd, os.fstat(shm_fd).st_size, mmap.MAP_SHARED, mmap.PROT_READ)
+header = IqRingHeader.from_buffer_copy(shm, 0)
+if header.magic != IQ_RING_MAGIC or header.version != IQ_RING_VERSION:
+    raise SystemExit(f"{shm_name} is not a version {IQ_RING_VERSION} IQ ring")
+dtype = np.int16 if header.sampleFormat == IQ_FMT_I16 else np.float32
+write_cursor_offset = IqRingHeader.writeCursor.offset
+notifier = ShmNotifier(shm_name, IqRingHeader.notifySeq.offset)
+
+def published_blocks():
+    return int.from_bytes(shm[write_cursor_offset:write_cursor_offset + 8], "little")
+
+def read_latest(last_block):
+    """copy the newest published block, returns (block, samples, flags) or None"""
+    write_cursor = published_blocks()
+    if write_cursor == 0 or write_cursor - 1 == last_block:
+        return None
+    block = write_cursor - 1
+    slot = header.headerSize + (block & (header.slotCount - 1)) * header.slotStride
+    before = IqSlotHeader.from_buffer_copy(shm, slot)
+    if before.seq != 2 * block + 2:
+        return None
+    samples = np.frombuffer(shm, dtype=dtype, count=2 * before.count, offset=slot + ctypes.sizeof(IqSlotHeader)).copy()
+    after = IqSlotHeader.from_buffer_copy(shm, slot)
+    if after.seq != before.seq:
+        return None  # overwritten while copying
+    return block, samples / np.float32(header.fullScale), before.flags
 
 # Set up real-time plotting
 plt.ion()  # Turn on interactive mode
 fig, ax = plt.subplots(figsize=(10, 6))
-line, = ax.plot([], [], label="Received Samples")
+line_i, = ax.plot([], [], label="I")
+line_q, = ax.plot([], [], label="Q")
 ax.set_title("Real-Time Received Signal Samples")
 ax.set_xlabel("Sample Index")
-ax.set_ylabel("Amplitude")
+ax.set_ylabel("Amplitude (full scale)")
 ax.grid(True)
 ax.legend()
 
 # Continuously read from shared memory
+last_block = None
+skipped = 0
+gaps = 0
 try:
     while True:
-        plt.ion() 
-        # Read samples from shared memory
-        shm.seek(0)
-        samples = np.frombuffer(shm.read(1024 * 4), dtype=np.float32)
+        plt.ion()
+        # Read the newest block from the ring
+        latest = read_latest(last_block)
+        if latest is None:
+            # sleep until the next block is published, then let the GUI run
+            notifier.wait(lambda: published_blocks() > (0 if last_block is None else last_block + 1), 100)
+            plt.pause(0.001)
+            continue
+        block, samples, flags = latest
+        # only drawn blocks are seen here, the capture report counts them all
+        if flags & (IQ_BLOCK_GAP | IQ_BLOCK_RESTART | IQ_BLOCK_FILLED):
+            gaps += 1
+        if last_block is not None:
+            skipped += block - last_block - 1
+        last_block = block
 
         # Update plot
-        line.set_xdata(np.arange(len(samples)))
-        line.set_ydata(samples)
+        line_i.set_data(np.arange(len(samples) // 2), samples[0::2])
+        line_q.set_data(np.arange(len(samples) // 2), samples[1::2])
+        ax.set_title(f"Real-Time Received Signal Samples (block {block}, {skipped} not drawn, {gaps} with gaps)")
         ax.relim()
         ax.autoscale_view()
         plt.draw()
-        plt.pause(0.01)  # Brief pause to allow plot update
-
-        time.sleep(0.01)  # Avoid busy-waiting
+        plt.pause(0.001)  # Brief pause to allow plot update
 except KeyboardInterrupt:
     print("Stopping plotter...")
 finally:
     # Cleanup
+    notifier.close()
     shm.close()
-    os.close(shm_fd)
\ No newline at end of file
+    os.close(shm_fd)
@@ -0,0 +1,215 @@
+#pragma once
+// bank of complex lock-in detectors: amplitude, phase and SNR of a list of
+// known tones per integration window, for a fraction of an FFT's cost when
+// only a handful of frequencies matter
+//
+// every tone k multiplies the input by its own reference e^{-j w_k t} and
+// sums over the window, so a tone A e^{j(w_k t + phi)} comes out as A e^{j phi}
+// with phi relative to sample timestamp 0: readings stay comparable across
+// windows and restarts. the references are kept as rotating phasors, tones
+// in structure-of-arrays lanes of 8 so the AVX2 kernel advances 8 tones per
+// instruction; they are re-anchored from the exact timestamp every chunk so
+// float rounding never builds up. SNR is the tone power over the noise left
+// in the window's bandwidth (fs / window) once all listed tones are taken out
+// of the total power.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "powerMeter.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOCKIN_X86 1
+#endif
+
+#define LOCKIN_LANES 8                   // tones per SIMD group
+#define LOCKIN_CHUNK 1024                // samples between re-anchoring the references
+
+// one SoA group: reference phasor p, per-sample rotation r, accumulator a = sum x * p
+struct LockInGroup {
+    float pr[LOCKIN_LANES], pi[LOCKIN_LANES];
+    float rr[LOCKIN_LANES], ri[LOCKIN_LANES];
+    float ar[LOCKIN_LANES], ai[LOCKIN_LANES];
+};
+
+typedef void (*LockInFn)(const float *iq, size_t n, LockInGroup *groups, size_t count);
+
+inline void lockInScalar(const float *iq, size_t n, LockInGroup *groups, size_t count)
+{
+    for (size_t g = 0; g < count; ++g) {
+        LockInGroup &b = groups[g];
+        for (int k = 0; k < LOCKIN_LANES; ++k) {
+            float pr = b.pr[k], pi = b.pi[k], ar = b.ar[k], ai = b.ai[k];
+            const float rr = b.rr[k], ri = b.ri[k];
+            for (size_t i = 0; i < n; ++i) {
+                float xr = iq[2 * i], xi = iq[2 * i + 1];
+                ar += xr * pr - xi * pi;
+                ai += xr * pi + xi * pr;
+                float t = pr * rr - pi * ri;
+                pi = pr * ri + pi * rr;
+                pr = t;
+            }
+            b.pr[k] = pr;
+            b.pi[k] = pi;
+            b.ar[k] = ar;
+            b.ai[k] = ai;
+        }
+    }
+}
+
+#ifdef LOCKIN_X86
+__attribute__((target("avx2,fma"))) inline void lockInAvx2(const float *iq, size_t n, LockInGroup *groups, size_t count)
+{
+    for (size_t g = 0; g < count; ++g) {
+        LockInGroup &b = groups[g];
+        __m256 pr = _mm256_loadu_ps(b.pr), pi = _mm256_loadu_ps(b.pi);
+        const __m256 rr = _mm256_loadu_ps(b.rr), ri = _mm256_loadu_ps(b.ri);
+        // the x_i terms go to their own accumulators, so each sum is one FMA
+        // deep per sample and only the phasor rotation is a longer chain
+        __m256 ar = _mm256_loadu_ps(b.ar), ai = _mm256_loadu_ps(b.ai);
+        __m256 br = _mm256_setzero_ps(), bi = _mm256_setzero_ps();
+        for (size_t i = 0; i < n; ++i) {
+            __m256 xr = _mm256_broadcast_ss(iq + 2 * i);
+            __m256 xi = _mm256_broadcast_ss(iq + 2 * i + 1);
+            ar = _mm256_fmadd_ps(xr, pr, ar);
+            br = _mm256_fmadd_ps(xi, pi, br);
+            ai = _mm256_fmadd_ps(xr, pi, ai);
+            bi = _mm256_fmadd_ps(xi, pr, bi);
+            __m256 t = _mm256_fmsub_ps(pr, rr, _mm256_mul_ps(pi, ri));
+            pi = _mm256_fmadd_ps(pr, ri, _mm256_mul_ps(pi, rr));
+            pr = t;
+        }
+        _mm256_storeu_ps(b.pr, pr);
+        _mm256_storeu_ps(b.pi, pi);
+        _mm256_storeu_ps(b.ar, _mm256_sub_ps(ar, br));
+        _mm256_storeu_ps(b.ai, _mm256_add_ps(ai, bi));
+    }
+}
+#endif
+
+inline LockInFn bestLockIn(const char **name = nullptr)
+{
+#ifdef LOCKIN_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        if (name) *name = "avx2";
+        return lockInAvx2;
+    }
+#endif
+    if (name) *name = "scalar";
+    return lockInScalar;
+}
+
+struct ToneReading {
+    double hz;
+    float amplitude;                     // linear, 1.0 is full scale
+    float dbfs;
+    float phase;                         // radians, against e^{j w t} at sample timestamp t
+    float snrDb;
+};
+
+class LockInBank {
+public:
+    // windowSamples per reading, input is interleaved float IQ at full scale 1.0
+    LockInBank(const std::vector<double> &toneHz, double sampleRate, uint32_t windowSamples)
+        : hz_(toneHz), sampleRate_(sampleRate), window_(std::max<uint32_t>(1, windowSamples)),
+          groups_((toneHz.size() + LOCKIN_LANES - 1) / LOCKIN_LANES), readings_(toneHz.size()),
+          kernel_(bestLockIn(&kernelName_)), power_(bestPowerKernels().f32)
+    {
+        // per-sample rotations, unused lanes stay at zero
+        for (size_t k = 0; k < hz_.size(); ++k) {
+            double w = -2 * M_PI * hz_[k] / sampleRate_;
+            lane(k).rr[k % LOCKIN_LANES] = float(std::cos(w));
+            lane(k).ri[k % LOCKIN_LANES] = float(std::sin(w));
+            readings_[k] = {hz_[k], 0, -200.0f, 0, 0};
+        }
+    }
+
+    // feed a block that starts at sample timestamp; a gap in timestamps
+    // drops the partial window. returns the number of windows completed
+    int push(const float *iq, size_t pairs, uint64_t timestamp)
+    {
+        if (filled_ && timestamp != next_) filled_ = 0;
+        next_ = timestamp + pairs;
+        int windows = 0;
+        while (pairs) {
+            if (!filled_) {
+                for (LockInGroup &g : groups_) {
+                    std::fill(g.ar, g.ar + LOCKIN_LANES, 0.0f);
+                    std::fill(g.ai, g.ai + LOCKIN_LANES, 0.0f);
+                }
+                powerSum_ = 0;
+                windowStart_ = timestamp;
+            }
+            size_t n = std::min<size_t>({pairs, size_t(window_ - filled_), size_t(LOCKIN_CHUNK)});
+            anchor(timestamp);
+            kernel_(iq, n, groups_.data(), groups_.size());
+            powerSum_ += power_(iq, n).sum;
+            iq += 2 * n;
+            pairs -= n;
+            timestamp += n;
+            filled_ += uint32_t(n);
+            if (filled_ == window_) {
+                finishWindow();
+                filled_ = 0;
+                ++windows;
+            }
+        }
+        return windows;
+    }
+
+    // readings of the last completed window, in toneHz order
+    const std::vector<ToneReading> &readings() const { return readings_; }
+    uint64_t windowTimestamp() const { return readingTimestamp_; }
+    uint64_t windowsDone() const { return windowsDone_; }
+    const char *kernelName() const { return kernelName_; }
+
+private:
+    LockInGroup &lane(size_t tone) { return groups_[tone / LOCKIN_LANES]; }
+
+    // reference phasors for the chunk starting at timestamp, from the exact phase
+    void anchor(uint64_t timestamp)
+    {
+        for (size_t k = 0; k < hz_.size(); ++k) {
+            double cycles = std::remainder(hz_[k] / sampleRate_ * double(timestamp), 1.0);
+            lane(k).pr[k % LOCKIN_LANES] = float(std::cos(-2 * M_PI * cycles));
+            lane(k).pi[k % LOCKIN_LANES] = float(std::sin(-2 * M_PI * cycles));
+        }
+    }
+
+    void finishWindow()
+    {
+        double tonePower = 0;
+        for (size_t k = 0; k < hz_.size(); ++k) {
+            const LockInGroup &g = lane(k);
+            double re = g.ar[k % LOCKIN_LANES] / window_, im = g.ai[k % LOCKIN_LANES] / window_;
+            double p = re * re + im * im;
+            tonePower += p;
+            readings_[k].amplitude = float(std::sqrt(p));
+            readings_[k].dbfs = powerToDb(p);
+            readings_[k].phase = float(std::atan2(im, re));
+        }
+        // per-sample noise power, then its share in the window's bandwidth
+        double noise = std::max(powerSum_ / window_ - tonePower, 1e-20) / window_;
+        for (ToneReading &r : readings_)
+            r.snrDb = powerToDb(double(r.amplitude) * r.amplitude / noise);
+        readingTimestamp_ = windowStart_;
+        ++windowsDone_;
+    }
+
+    std::vector<double> hz_;
+    double sampleRate_;
+    uint32_t window_;
+    std::vector<LockInGroup> groups_;
+    std::vector<ToneReading> readings_;
+    const char *kernelName_ = "scalar";
+    LockInFn kernel_;
+    PowerF32Fn power_;
+    double powerSum_ = 0;
+    uint32_t filled_ = 0;
+    uint64_t next_ = 0;
+    uint64_t windowStart_ = 0;
+    uint64_t readingTimestamp_ = 0;
+    uint64_t windowsDone_ = 0;
+};
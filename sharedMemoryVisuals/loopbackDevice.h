@@ -0,0 +1,143 @@
+#pragma once
+// device-free TX -> RX loopback for the duplex engine, F32 samples only
+//
+// the RX side runs on the wall clock like SyntheticRxSource (paced, the
+// sample counter is the timestamp) and returns noise. timestamped bursts
+// handed to the TX side reappear in the RX stream delaySamples later, scaled
+// by gain and each shifted by a random 0..jitterSamples, the way a cable
+// between TX and RX would show them. bursts whose timestamp has already
+// gone past on the RX clock are dropped and counted as late, as the FPGA does.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "rxSource.h"
+#include "txSink.h"
+
+class LoopbackDevice {
+public:
+    LoopbackDevice(double sampleRate, uint32_t delaySamples, float gain = 0.5f, float noise = 0.01f,
+                   uint32_t jitterSamples = 0)
+        : rx(this), tx(this), sampleRate_(sampleRate), delay_(delaySamples), gain_(gain),
+          jitter_(jitterSamples), gauss_(0.0f, noise)
+    {
+    }
+
+    class Rx : public RxSource {
+    public:
+        explicit Rx(LoopbackDevice *dev) : dev_(dev) {}
+        int recv(void *samples, size_t count, RxMeta *meta, unsigned) override
+        {
+            return dev_->recv(static_cast<std::complex<float> *>(samples), count, meta);
+        }
+
+    private:
+        LoopbackDevice *dev_;
+    };
+
+    class Tx : public TxSink {
+    public:
+        explicit Tx(LoopbackDevice *dev) : dev_(dev) {}
+        int send(const void *samples, size_t count, const TxMeta *meta, unsigned) override
+        {
+            return dev_->send(static_cast<const std::complex<float> *>(samples), count, meta);
+        }
+        uint64_t late() const override { return dev_->late_; }
+
+    private:
+        LoopbackDevice *dev_;
+    };
+
+    // receiver front end impairments on everything received: DC offset and
+    // Q path gain (linear) and phase error, see iqCorrection.h; set before streaming
+    void setFrontEnd(float dcI, float dcQ, float gain, float phaseDeg)
+    {
+        dc_ = {dcI, dcQ};
+        imbalanceGain_ = gain;
+        imbalancePhase_ = phaseDeg * float(M_PI) / 180;
+        impaired_ = true;
+    }
+
+    Rx rx;
+    Tx tx;
+
+private:
+    struct Burst {
+        uint64_t at;                     // RX timestamp of the first sample
+        std::vector<std::complex<float>> samples;
+    };
+
+    int recv(std::complex<float> *out, size_t count, RxMeta *meta)
+    {
+        pace(count);
+        uint64_t t0 = timestamp_;
+        if (meta) meta->timestamp = t0;
+        for (size_t i = 0; i < count; ++i)
+            out[i] = {gauss_(rng_), gauss_(rng_)};
+        std::lock_guard<std::mutex> lock(mutex_);
+        // add every burst overlapping [t0, t0 + count), retire the finished ones
+        for (auto it = bursts_.begin(); it != bursts_.end();) {
+            uint64_t end = it->at + it->samples.size();
+            uint64_t from = std::max(it->at, t0), to = std::min(end, t0 + count);
+            for (uint64_t t = from; t < to; ++t)
+                out[t - t0] += gain_ * it->samples[t - it->at];
+            it = end <= t0 + count ? bursts_.erase(it) : it + 1;
+        }
+        if (impaired_) {
+            float c = std::cos(imbalancePhase_), sn = std::sin(imbalancePhase_);
+            for (size_t i = 0; i < count; ++i) {
+                float re = out[i].real(), im = out[i].imag();
+                out[i] = std::complex<float>(re, imbalanceGain_ * (im * c - re * sn)) + dc_;
+            }
+        }
+        timestamp_ = t0 + count;
+        return int(count);
+    }
+
+    int send(const std::complex<float> *samples, size_t count, const TxMeta *meta)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t now = timestamp_;
+        uint64_t at = meta && meta->waitForTimestamp ? meta->timestamp : now;
+        if (at < now) {
+            late_++;
+            return int(count);
+        }
+        uint32_t jitter = jitter_ ? uint32_t(jitterRng_() % (jitter_ + 1)) : 0;
+        bursts_.push_back({at + delay_ + jitter, std::vector<std::complex<float>>(samples, samples + count)});
+        return int(count);
+    }
+
+    // block until the wall clock has caught up with the samples handed out
+    void pace(size_t count)
+    {
+        if (timestamp_ == 0) start_ = std::chrono::steady_clock::now();
+        auto due = start_ + std::chrono::duration<double>((timestamp_ + count) / sampleRate_);
+        std::this_thread::sleep_until(std::chrono::time_point_cast<std::chrono::steady_clock::duration>(due));
+    }
+
+    double sampleRate_;
+    uint32_t delay_;
+    float gain_;
+    uint32_t jitter_;
+    bool impaired_ = false;
+    std::complex<float> dc_;
+    float imbalanceGain_ = 1.0f;
+    float imbalancePhase_ = 0.0f;
+    std::mt19937 rng_{1};               // RX noise, RX thread only
+    std::mt19937 jitterRng_{2};         // under mutex_
+    std::normal_distribution<float> gauss_;
+    std::mutex mutex_;                   // bursts_ and the clock, between the TX and RX threads
+    std::deque<Burst> bursts_;
+    std::atomic<uint64_t> timestamp_{0};
+    std::atomic<uint64_t> late_{0};
+    std::chrono::steady_clock::time_point start_;
+};
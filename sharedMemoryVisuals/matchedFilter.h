@@ -0,0 +1,381 @@
+#pragma once
+// streaming matched filter: cross-correlation of the RX stream against the
+// transmitted waveform by overlap-save FFT convolution, for time of flight
+// and reflection strength
+//
+// MatchedFilter holds the reference spectrum, conj(FFT(reference)) over
+// fftSize points, computed once. a segment of fftSize consecutive samples
+// goes through one forward FFT, one multiply with it and one inverse FFT;
+// of the circular result the first fftSize - M + 1 lags (M the reference
+// length) never wrapped around, so segments start that many samples apart
+// and overlap by M - 1. each segment yields its strongest lag, refined to a
+// fraction of a sample by a parabola through the peak and its neighbours.
+//
+// segments do not depend on each other, so ParallelMatchedFilter deals them
+// out to worker threads round robin, each with its own FFT buffers and a
+// small ring of preallocated jobs, and collects the peaks back in stream
+// order on the thread that pushes samples. a full ring makes push() wait for
+// that worker, which is the backpressure when the workers fall behind.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "spectrum.h"
+
+#define MATCHED_JOBS_PER_WORKER 4
+
+struct CorrelationPeak {
+    uint64_t segment;
+    double position;                     // timestamp where the reference lines up best, sub-sample
+    float gain;                          // |c| / reference energy: echo amplitude relative to the reference
+    float coefficient;                   // normalised correlation, 1.0 for a perfect copy
+    float phase;                         // radians, of the echo relative to the reference
+};
+
+// per-thread working memory
+struct MatchedScratch {
+    std::vector<cfloat> spectrum;
+    std::vector<double> energy;          // prefix sums of |x|^2
+};
+
+class MatchedFilter {
+public:
+    // fftSize 0 picks the power of two at least 4x the reference, so three
+    // quarters of every FFT is fresh output; a given size is rounded up to a
+    // power of two of at least twice the reference
+    explicit MatchedFilter(const std::vector<cfloat> &reference, size_t fftSize = 0)
+        : refLength_(std::max<size_t>(1, reference.size())), fft_(pickSize(refLength_, fftSize)),
+          conjRef_(fft_.size(), 0.0f)
+    {
+        size_t n = fft_.size();
+        std::copy(reference.begin(), reference.end(), conjRef_.begin());
+        for (const cfloat &r : reference)
+            refEnergy_ += std::norm(r);
+        fft_.execute(conjRef_.data());
+        // the inverse is unscaled, fold the 1/N into the reference
+        for (cfloat &r : conjRef_)
+            r = std::conj(r) / float(n);
+    }
+
+    // the default size, made smaller while a segment would span more than
+    // one burst period (down to twice the reference)
+    static size_t sizeFor(size_t refLength, uint64_t periodSamples)
+    {
+        size_t n = pickSize(refLength, 0);
+        while (periodSamples && n - refLength + 1 > periodSamples && n / 2 >= 2 * refLength) n /= 2;
+        return n;
+    }
+
+    size_t fftSize() const { return fft_.size(); }
+    size_t referenceSamples() const { return refLength_; }
+    // new samples per segment, and lags evaluated per segment
+    size_t hop() const { return fft_.size() - refLength_ + 1; }
+
+    void prepare(MatchedScratch &s) const
+    {
+        s.spectrum.resize(fft_.size());
+        s.energy.resize(fft_.size() + 1);
+    }
+
+    // the best lag among the hop() that start in this segment of fftSize()
+    // samples, whose first sample is at timestamp
+    CorrelationPeak correlate(const cfloat *segment, uint64_t timestamp, MatchedScratch &s) const
+    {
+        size_t n = fft_.size();
+        s.energy[0] = 0;
+        for (size_t i = 0; i < n; ++i) {
+            s.spectrum[i] = segment[i];
+            s.energy[i + 1] = s.energy[i] + std::norm(segment[i]);
+        }
+        fft_.execute(s.spectrum.data());
+        // plain complex multiply, std::complex's operator* adds NaN/inf handling
+        for (size_t i = 0; i < n; ++i) {
+            cfloat x = s.spectrum[i], r = conjRef_[i];
+            s.spectrum[i] = cfloat(x.real() * r.real() - x.imag() * r.imag(), x.real() * r.imag() + x.imag() * r.real());
+        }
+        fft_.inverse(s.spectrum.data());
+        // c[k] = sum_m x[k + m] conj(r[m]), valid for k < hop()
+        size_t lags = hop(), best = 0;
+        float bestMag = -1;
+        for (size_t k = 0; k < lags; ++k) {
+            float m = std::norm(s.spectrum[k]);
+            if (m > bestMag) {
+                bestMag = m;
+                best = k;
+            }
+        }
+        double offset = 0;
+        if (best > 0 && best + 1 < lags) {
+            double a = std::abs(s.spectrum[best - 1]), b = std::abs(s.spectrum[best]), c = std::abs(s.spectrum[best + 1]);
+            double den = a - 2 * b + c;
+            if (den < 0) offset = std::max(-0.5, std::min(0.5, 0.5 * (a - c) / den));
+        }
+        cfloat peak = s.spectrum[best];
+        double window = s.energy[best + refLength_] - s.energy[best];
+        double norm = std::sqrt(refEnergy_ * window);
+        CorrelationPeak p;
+        p.segment = 0;
+        p.position = double(timestamp + best) + offset;
+        p.gain = refEnergy_ > 0 ? float(std::abs(peak) / refEnergy_) : 0.0f;
+        p.coefficient = norm > 0 ? float(std::abs(peak) / norm) : 0.0f;
+        p.phase = std::arg(peak);
+        return p;
+    }
+
+private:
+    static size_t pickSize(size_t refLength, size_t fftSize)
+    {
+        size_t n = 1;
+        while (n < (fftSize ? std::max(fftSize, 2 * refLength) : 4 * refLength)) n *= 2;
+        return n;
+    }
+
+    size_t refLength_;
+    FftPlan fft_;
+    std::vector<cfloat> conjRef_;
+    double refEnergy_ = 0;
+};
+
+typedef std::function<void(const CorrelationPeak &peak)> PeakFn;
+
+struct MatchedStats {
+    uint64_t segments = 0;
+    uint64_t lags = 0;                   // correlation values evaluated
+    uint64_t restarts = 0;               // timestamp gaps that dropped a partial segment
+};
+
+class ParallelMatchedFilter {
+public:
+    // peaks arrive in stream order on the thread calling push() and flush()
+    ParallelMatchedFilter(const MatchedFilter &filter, unsigned workers, PeakFn onPeak)
+        : filter_(filter), onPeak_(onPeak), pending_(filter.fftSize())
+    {
+        for (unsigned w = 0; w < std::max(1u, workers); ++w) {
+            std::unique_ptr<Worker> worker(new Worker);
+            filter_.prepare(worker->scratch);
+            for (Job &job : worker->jobs)
+                job.samples.resize(filter_.fftSize());
+            workers_.push_back(std::move(worker));
+        }
+        for (auto &w : workers_) {
+            Worker *worker = w.get();
+            worker->thread = std::thread([this, worker] { run(worker); });
+        }
+    }
+
+    // peaks not collected yet are dropped, flush() first to get them
+    ~ParallelMatchedFilter()
+    {
+        for (auto &w : workers_) {
+            {
+                std::lock_guard<std::mutex> lock(w->mutex);
+                w->stop = true;
+            }
+            w->wake.notify_one();
+            w->thread.join();
+        }
+    }
+
+    // interleaved float IQ starting at timestamp; a gap in timestamps starts
+    // the segment over
+    void push(const cfloat *samples, size_t count, uint64_t timestamp)
+    {
+        if (fill_ && timestamp != start_ + fill_) {
+            fill_ = 0;
+            stats_.restarts++;
+        }
+        if (!fill_) start_ = timestamp;
+        const size_t n = filter_.fftSize(), hop = filter_.hop();
+        while (count) {
+            size_t k = std::min(count, n - fill_);
+            std::copy(samples, samples + k, pending_.begin() + fill_);
+            fill_ += k;
+            samples += k;
+            count -= k;
+            if (fill_ < n) break;
+            submit();
+            // the last M - 1 samples begin the next segment
+            std::copy(pending_.begin() + hop, pending_.end(), pending_.begin());
+            fill_ = n - hop;
+            start_ += hop;
+        }
+    }
+
+    // wait for every submitted segment and hand out its peak
+    void flush()
+    {
+        while (collected_ < submitted_)
+            collect(true);
+    }
+
+    const MatchedStats &stats() const { return stats_; }
+    unsigned workers() const { return unsigned(workers_.size()); }
+
+private:
+    struct Job {
+        std::vector<cfloat> samples;
+        uint64_t timestamp = 0;
+        uint64_t segment = 0;
+        CorrelationPeak peak;
+    };
+
+    struct Worker {
+        Job jobs[MATCHED_JOBS_PER_WORKER];
+        MatchedScratch scratch;
+        uint64_t submitted = 0;          // pusher only
+        uint64_t collected = 0;          // pusher only
+        alignas(64) std::atomic<uint64_t> done{0};
+        std::mutex mutex;                // only to sleep on wake
+        std::condition_variable wake;
+        std::atomic<uint64_t> posted{0};
+        bool stop = false;
+        std::thread thread;
+    };
+
+    void submit()
+    {
+        Worker &w = *workers_[submitted_ % workers_.size()];
+        // the job ring is full: this worker's oldest peak has to be collected first
+        while (w.submitted - w.collected == MATCHED_JOBS_PER_WORKER)
+            collect(true);
+        Job &job = w.jobs[w.submitted % MATCHED_JOBS_PER_WORKER];
+        std::copy(pending_.begin(), pending_.end(), job.samples.begin());
+        job.timestamp = start_;
+        job.segment = submitted_++;
+        w.submitted++;
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.posted.store(w.submitted, std::memory_order_release);
+        }
+        w.wake.notify_one();
+        // hand out whatever is already finished
+        while (collected_ < submitted_ && collect(false)) {}
+    }
+
+    // the next peak in stream order, waiting for it if wait
+    bool collect(bool wait)
+    {
+        Worker &w = *workers_[collected_ % workers_.size()];
+        while (w.done.load(std::memory_order_acquire) <= w.collected) {
+            if (!wait) return false;
+            std::this_thread::yield();
+        }
+        Job &job = w.jobs[w.collected % MATCHED_JOBS_PER_WORKER];
+        job.peak.segment = job.segment;
+        stats_.segments++;
+        stats_.lags += filter_.hop();
+        w.collected++;
+        collected_++;
+        if (onPeak_) onPeak_(job.peak);
+        return true;
+    }
+
+    void run(Worker *w)
+    {
+        uint64_t next = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(w->mutex);
+                w->wake.wait(lock, [&] { return w->stop || w->posted.load(std::memory_order_relaxed) > next; });
+                if (w->posted.load(std::memory_order_relaxed) <= next) return;
+            }
+            uint64_t posted = w->posted.load(std::memory_order_acquire);
+            for (; next < posted; ++next) {
+                Job &job = w->jobs[next % MATCHED_JOBS_PER_WORKER];
+                job.peak = filter_.correlate(job.samples.data(), job.timestamp, w->scratch);
+                w->done.store(next + 1, std::memory_order_release);
+            }
+        }
+    }
+
+    const MatchedFilter &filter_;
+    PeakFn onPeak_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<cfloat> pending_;        // the segment being assembled
+    size_t fill_ = 0;
+    uint64_t start_ = 0;                 // timestamp of pending_[0]
+    uint64_t submitted_ = 0;
+    uint64_t collected_ = 0;
+    MatchedStats stats_;
+};
+
+struct EchoStats {
+    uint64_t echoes = 0;
+    double meanLag = 0;                  // samples after the burst start
+    double lagStd = 0;
+    double meanGain = 0;
+    double meanCoefficient = 0;
+};
+
+// one echo per burst out of the per-segment peaks: bursts start on multiples
+// of periodSamples (DuplexConfig::alignBursts), the strongest peak above
+// minCoefficient in a period is its echo, at a lag from the period start.
+// a lag whose reference would run into the next period is the front of the
+// next burst half overlapping (periodic probes correlate well there), not an
+// echo, and is skipped. periodSamples 0 takes every peak above
+// minCoefficient as an echo at its position. the segment hop should not
+// exceed the period, or a segment holding two bursts reports only one.
+class EchoTracker {
+public:
+    EchoTracker(uint64_t periodSamples, size_t referenceSamples, float minCoefficient = 0.5f,
+                PeakFn onEcho = PeakFn())
+        : period_(periodSamples), refLength_(referenceSamples), min_(minCoefficient), onEcho_(onEcho) {}
+
+    void add(const CorrelationPeak &peak)
+    {
+        if (peak.coefficient < min_) return;
+        uint64_t cycle = period_ ? uint64_t(std::max(0.0, peak.position) / double(period_)) : 0;
+        if (period_ && peak.position - double(cycle * period_) + double(refLength_) > double(period_)) return;
+        if (have_ && (!period_ || cycle != cycle_)) finish();
+        if (!have_ || peak.gain > best_.gain) {
+            best_ = peak;
+            best_.position -= double(cycle * period_);
+            cycle_ = cycle;
+            have_ = true;
+        }
+    }
+
+    // hand out the echo of the period still open
+    void finish()
+    {
+        if (!have_) return;
+        have_ = false;
+        count_++;
+        sumLag_ += best_.position;
+        sumLagSq_ += best_.position * best_.position;
+        sumGain_ += best_.gain;
+        sumCoef_ += best_.coefficient;
+        if (onEcho_) onEcho_(best_);
+    }
+
+    EchoStats stats() const
+    {
+        EchoStats s;
+        s.echoes = count_;
+        if (!count_) return s;
+        double n = double(count_);
+        s.meanLag = sumLag_ / n;
+        s.lagStd = std::sqrt(std::max(0.0, sumLagSq_ / n - s.meanLag * s.meanLag));
+        s.meanGain = sumGain_ / n;
+        s.meanCoefficient = sumCoef_ / n;
+        return s;
+    }
+
+private:
+    uint64_t period_;
+    size_t refLength_;
+    float min_;
+    PeakFn onEcho_;
+    bool have_ = false;
+    uint64_t cycle_ = 0;
+    CorrelationPeak best_ = {};
+    uint64_t count_ = 0;
+    double sumLag_ = 0, sumLagSq_ = 0, sumGain_ = 0, sumCoef_ = 0;
+};
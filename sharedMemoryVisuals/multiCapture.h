@@ -0,0 +1,248 @@
+#pragma once
+// several RX streams at once (every channel of every attached board), each
+// with its own ring and its own capture thread pinned to a separate core,
+// plus a reader that lines the streams up on their hardware timestamps
+//
+// streams share nothing on the capture path, so throughput scales with the
+// number of cores until the USB links or memory bandwidth run out. channels
+// of one board share its sample counter and line up exactly; separate boards
+// count from their own stream start, so their offset to a common timeline is
+// taken from the host arrival time of each one's first block (good to the
+// USB transfer jitter, a few hundred samples) unless the caller knows better,
+// e.g. boards started together on a shared reference and trigger.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "capturePipeline.h"
+#include "iqRing.h"
+
+class MultiCapture {
+public:
+    MultiCapture(uint32_t blockSamples, IqSampleFormat fmt, double sampleRate, float fullScale, uint32_t slots = 256)
+        : blockSamples_(blockSamples), fmt_(fmt), sampleRate_(sampleRate), fullScale_(fullScale), slots_(slots) {}
+
+    ~MultiCapture() { stop(); }
+
+    // a stream with its own ring; group numbers the board (streams of one
+    // group share a sample counter), cpu is where its capture thread runs
+    int add(const std::string &ringName, RxSource *source, int group, int cpu)
+    {
+        std::unique_ptr<Stream> s(new Stream);
+        s->name = ringName;
+        s->group = group;
+        s->ring.setHugePages(hugePages_);
+        if (s->ring.create(ringName.c_str(), slots_, blockSamples_, fmt_, sampleRate_, fullScale_) != 0) return -1;
+        s->ring.setWakeBatch(4);
+        s->pipeline.reset(new CapturePipeline(source, &s->ring, s->name.c_str()));
+        s->pipeline->setCpu(cpu);
+        streams_.push_back(std::move(s));
+        return 0;
+    }
+
+    // back the rings of streams added from now on with huge pages
+    void setHugePages(bool huge) { hugePages_ = huge; }
+
+    size_t size() const { return streams_.size(); }
+    const std::string &ringName(size_t i) const { return streams_[i]->name; }
+    // add stages here before start()
+    CapturePipeline &pipeline(size_t i) { return *streams_[i]->pipeline; }
+
+    int start()
+    {
+        for (auto &s : streams_) {
+            if (s->pipeline->start() != 0) {
+                error_ = "failed to start " + s->name;
+                stop();
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    void stop()
+    {
+        for (auto &s : streams_)
+            s->pipeline->stop();
+    }
+
+    // all streams still capturing
+    bool running() const
+    {
+        for (auto &s : streams_)
+            if (!s->pipeline->running()) return false;
+        return !streams_.empty();
+    }
+
+    std::string error() const
+    {
+        for (auto &s : streams_)
+            if (!s->pipeline->error().empty()) return s->name + ": " + s->pipeline->error();
+        return error_;
+    }
+
+    // per stream: subtract from its timestamps to get the common timeline.
+    // false until every stream has published a block
+    bool offsets(std::vector<int64_t> *out) const
+    {
+        uint64_t hostRef = UINT64_MAX;
+        for (auto &s : streams_) {
+            uint64_t ns = s->pipeline->first.hostNs.load(std::memory_order_acquire);
+            if (!ns) return false;
+            hostRef = std::min(hostRef, ns);
+        }
+        // one offset per board, taken from its first stream
+        std::vector<std::pair<int, int64_t>> groups;
+        out->clear();
+        for (auto &s : streams_) {
+            auto g = std::find_if(groups.begin(), groups.end(), [&](const std::pair<int, int64_t> &p) { return p.first == s->group; });
+            if (g == groups.end()) {
+                const FirstBlock &f = s->pipeline->first;
+                double since = (f.hostNs.load() - hostRef) * 1e-9 * sampleRate_;
+                groups.push_back({s->group, int64_t(f.timestamp.load()) - int64_t(std::llround(since))});
+                g = groups.end() - 1;
+            }
+            out->push_back(g->second);
+        }
+        return true;
+    }
+
+    // total rate, then the report of every stream
+    void report(std::ostream &os)
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t samples = 0;
+        for (auto &s : streams_)
+            samples += s->pipeline->capture.samples.load();
+        double seconds = std::chrono::duration<double>(now - lastReport_).count();
+        double rate = lastReport_.time_since_epoch().count() ? (samples - lastSamples_) / seconds : 0.0;
+        lastReport_ = now;
+        lastSamples_ = samples;
+        os << streams_.size() << " streams, " << rate / 1e6 << " MS/s total\n";
+        for (auto &s : streams_) {
+            os << s->name << " ";
+            s->pipeline->report(os);
+        }
+    }
+
+private:
+    struct Stream {
+        std::string name;
+        int group;
+        IqRingWriter ring;
+        std::unique_ptr<CapturePipeline> pipeline;
+    };
+
+    uint32_t blockSamples_;
+    IqSampleFormat fmt_;
+    double sampleRate_;
+    float fullScale_;
+    uint32_t slots_;
+    bool hugePages_ = false;
+    std::vector<std::unique_ptr<Stream>> streams_;
+    std::string error_;
+    std::chrono::steady_clock::time_point lastReport_;
+    uint64_t lastSamples_ = 0;
+};
+
+// reads several rings in step: every read() returns the same stretch of the
+// common timeline from each stream. samples only one stream has (it started
+// earlier, or the others lost blocks) are dropped and counted
+class AlignedReader {
+public:
+    int open(const std::vector<std::string> &rings, const std::vector<int64_t> &offsets)
+    {
+        streams_.clear();
+        for (size_t i = 0; i < rings.size(); ++i) {
+            std::unique_ptr<Stream> s(new Stream);
+            if (s->reader.open(rings[i].c_str()) != 0) return -1;
+            IqRingHeader *hdr = s->reader.header();
+            if (i && hdr->bytesPerSample != bytesPerSample_) {
+                std::cerr << "AlignedReader: " << rings[i] << " has another sample format" << std::endl;
+                return -1;
+            }
+            bytesPerSample_ = hdr->bytesPerSample;
+            s->block.resize(size_t(hdr->slotSamples) * bytesPerSample_);
+            s->offset = i < offsets.size() ? offsets[i] : 0;
+            streams_.push_back(std::move(s));
+        }
+        return 0;
+    }
+
+    // count samples of every stream starting at the same common timestamp,
+    // stream k's into out[k]; false if a stream had nothing new in timeoutMs
+    bool read(uint32_t count, std::vector<std::vector<uint8_t>> &out, uint64_t *timestamp, unsigned timeoutMs)
+    {
+        out.resize(streams_.size());
+        for (;;) {
+            uint64_t start = 0;
+            for (auto &s : streams_) {
+                if (!s->samples && !fill(*s, timeoutMs)) return false;
+                start = std::max(start, s->start);
+            }
+            bool ready = true;
+            for (auto &s : streams_) {
+                if (s->start < start) consume(*s, size_t(std::min<uint64_t>(start - s->start, s->samples)), true);
+                if (s->start != start || s->samples < count) {
+                    ready = false;
+                    if (s->start == start && !fill(*s, timeoutMs)) return false;
+                }
+            }
+            if (!ready) continue;
+            for (size_t k = 0; k < streams_.size(); ++k) {
+                Stream &s = *streams_[k];
+                out[k].assign(s.pending.begin(), s.pending.begin() + size_t(count) * bytesPerSample_);
+                consume(s, count, false);
+            }
+            *timestamp = start;
+            return true;
+        }
+    }
+
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    struct Stream {
+        IqRingReader reader;
+        std::vector<uint8_t> block;
+        std::vector<uint8_t> pending;    // contiguous samples from start on
+        uint64_t start = 0;              // common timestamp of pending[0]
+        size_t samples = 0;
+        int64_t offset = 0;
+    };
+
+    // append the next block, starting over after a gap
+    bool fill(Stream &s, unsigned timeoutMs)
+    {
+        IqBlockInfo info;
+        if (!s.reader.wait(s.block.data(), s.reader.header()->slotSamples, &info, timeoutMs)) return false;
+        uint64_t t = uint64_t(int64_t(info.timestamp) - s.offset);
+        if (s.samples && t != s.start + s.samples) {
+            dropped_ += s.samples;
+            s.samples = 0;
+            s.pending.clear();
+        }
+        if (!s.samples) s.start = t;
+        s.pending.insert(s.pending.end(), s.block.begin(), s.block.begin() + size_t(info.count) * bytesPerSample_);
+        s.samples += info.count;
+        return true;
+    }
+
+    void consume(Stream &s, size_t n, bool drop)
+    {
+        s.pending.erase(s.pending.begin(), s.pending.begin() + n * bytesPerSample_);
+        s.samples -= n;
+        s.start += n;
+        if (drop) dropped_ += n;
+    }
+
+    std::vector<std::unique_ptr<Stream>> streams_;
+    uint32_t bytesPerSample_ = 0;
+    uint64_t dropped_ = 0;
+};
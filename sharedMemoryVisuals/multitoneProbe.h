@@ -0,0 +1,248 @@
+#pragma once
+// multitone channel sounding: a comb of tones on FFT bins, sent as one burst
+// of identical periods, and a receiver that estimates the complex response at
+// every tone from one FFT per received period
+//
+// MultitoneProbe builds one period of the comb by inverse FFT, so it repeats
+// seamlessly, with Schroeder phases (phi_k = -pi k(k-1)/K) instead of equal
+// ones: the tones no longer line up into a spike every period and the crest
+// factor drops from 10 log10(2K) to a few dB, which lets the comb run closer
+// to full scale. a burst is guardPeriods + periods repetitions; the guard
+// absorbs the channel's delay so the analysed periods see a steady state.
+//
+// MultitoneEstimator finds the periods from stream timestamps alone: bursts
+// start on multiples of cycleSamples (DuplexConfig::alignBursts), so the
+// period a sample belongs to is a function of its timestamp. each period goes
+// through one FFT, periods whose tones are not thresholdDb above the bins
+// between them (a skipped or lost burst) are rejected, and the rest of the
+// burst is averaged into one estimate per tone: H = Y / X, its SNR from the
+// spread across periods, plus the delay from the phase slope across tones.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <vector>
+#include "spectrum.h"
+
+class MultitoneProbe {
+public:
+    // tones on the given FFT bins (negative bins below the LO), peak
+    // amplitude of the period scaled to peak
+    MultitoneProbe(size_t fftSize, const std::vector<int> &bins, float peak = 0.7f, bool schroeder = true)
+        : fftSize_(fftSize), bins_(bins), reference_(bins.size()), period_(fftSize)
+    {
+        FftPlan plan(fftSize);
+        std::vector<cfloat> spectrum(fftSize, 0.0f);
+        size_t k = bins.size();
+        for (size_t i = 0; i < k; ++i) {
+            double phase = schroeder ? -M_PI * double(i) * (i + 1) / k : 0;
+            spectrum[slot(bins[i])] = std::polar(1.0f, float(phase));
+        }
+        // x[n] = sum_k e^{j(2 pi b_k n / N + phi_k)}, then scaled to the peak
+        period_ = spectrum;
+        plan.inverse(period_.data());
+        float top = 0, power = 0;
+        for (const cfloat &x : period_) {
+            top = std::max(top, std::norm(x));
+            power += std::norm(x);
+        }
+        float scale = top > 0 ? peak / std::sqrt(top) : 0;
+        for (cfloat &x : period_)
+            x *= scale;
+        crestDb_ = power > 0 ? float(10 * std::log10(top / (power / fftSize))) : 0;
+        // what the receiver's FFT of one period sees for each tone
+        for (size_t i = 0; i < k; ++i)
+            reference_[i] = spectrum[slot(bins[i])] * scale * float(fftSize);
+    }
+
+    // every step-th bin from first to last, DC left out
+    static std::vector<int> comb(int first, int last, int step)
+    {
+        std::vector<int> bins;
+        for (int b = first; b <= last; b += step)
+            if (b != 0) bins.push_back(b);
+        return bins;
+    }
+
+    // the period repeated, guard periods included
+    std::vector<cfloat> burst(uint32_t periods) const
+    {
+        std::vector<cfloat> out;
+        out.reserve(periods * fftSize_);
+        for (uint32_t p = 0; p < periods; ++p)
+            out.insert(out.end(), period_.begin(), period_.end());
+        return out;
+    }
+
+    size_t fftSize() const { return fftSize_; }
+    size_t tones() const { return bins_.size(); }
+    const std::vector<int> &bins() const { return bins_; }
+    const std::vector<cfloat> &period() const { return period_; }
+    cfloat reference(size_t tone) const { return reference_[tone]; }
+    size_t slot(int bin) const { return size_t((bin % int(fftSize_) + int(fftSize_)) % int(fftSize_)); }
+    float crestDb() const { return crestDb_; }
+
+private:
+    size_t fftSize_;
+    std::vector<int> bins_;
+    std::vector<cfloat> reference_;
+    std::vector<cfloat> period_;
+    float crestDb_ = 0;
+};
+
+struct ToneEstimate {
+    int bin;
+    std::complex<float> response;        // received over sent, averaged over the burst
+    float gainDb;
+    float phase;                         // radians
+    float snrDb;                         // of the averaged estimate, from the spread across periods
+};
+
+struct MultitoneStats {
+    uint64_t periods = 0;                // analysed
+    uint64_t rejected = 0;               // no comb in them
+    uint64_t estimates = 0;              // bursts turned into a full set of tone estimates
+};
+
+class MultitoneEstimator {
+public:
+    // bursts start where timestamp % cycleSamples == 0, the first guardPeriods
+    // of each are skipped and the next periods analysed
+    MultitoneEstimator(const MultitoneProbe &probe, uint32_t cycleSamples, uint32_t guardPeriods, uint32_t periods,
+                       float thresholdDb = 10.0f)
+        : probe_(probe), plan_(probe.fftSize()), cycle_(cycleSamples), first_(guardPeriods * probe.fftSize()),
+          periods_(periods), factor_(std::pow(10.0f, thresholdDb / 10)), buffer_(probe.fftSize()),
+          sum_(probe.tones()), sumSq_(probe.tones()), estimates_(probe.tones())
+    {
+        isTone_.assign(probe.fftSize(), false);
+        for (int b : probe.bins())
+            isTone_[probe.slot(b)] = true;
+        for (size_t i = 0; i < probe.tones(); ++i)
+            estimates_[i] = {probe.bins()[i], 0, -200.0f, 0, 0};
+    }
+
+    // feed RX samples starting at timestamp; returns the estimates completed
+    int push(const cfloat *samples, size_t count, uint64_t timestamp)
+    {
+        const uint64_t n = probe_.fftSize();
+        const uint64_t end = first_ + periods_ * n;
+        int done = 0;
+        size_t i = 0;
+        while (i < count) {
+            uint64_t t = timestamp + i;
+            uint64_t pos = t % cycle_;
+            if (pos < first_ || pos >= end) {
+                // outside the analysed periods: skip to where they start
+                fill_ = 0;
+                uint64_t to = pos < first_ ? first_ - pos : cycle_ - pos + first_;
+                i += size_t(std::min<uint64_t>(to, count - i));
+                continue;
+            }
+            uint64_t offset = (pos - first_) % n;
+            if (offset != fill_) {
+                // joined mid-period or samples went missing
+                fill_ = 0;
+                i += size_t(std::min<uint64_t>(n - offset, count - i));
+                continue;
+            }
+            if (fill_ == 0 && t / cycle_ != burst_) {
+                // first period of a new burst, whatever the last one left is stale
+                burst_ = t / cycle_;
+                reset();
+            }
+            size_t k = size_t(std::min<uint64_t>(n - fill_, count - i));
+            std::copy(samples + i, samples + i + k, buffer_.begin() + fill_);
+            fill_ += k;
+            i += k;
+            if (fill_ < n) continue;
+            fill_ = 0;
+            analyse();
+            if ((pos - first_) / n == periods_ - 1 && finish()) ++done;
+        }
+        return done;
+    }
+
+    const std::vector<ToneEstimate> &estimates() const { return estimates_; }
+    const MultitoneStats &stats() const { return stats_; }
+
+    // channel delay from the phase step between neighbouring tones, wrapped
+    // into +-fftSize / (2 * bin spacing) samples
+    double delaySamples() const
+    {
+        if (estimates_.size() < 2) return 0;
+        int spacing = estimates_[1].bin - estimates_[0].bin;
+        std::complex<double> acc = 0;
+        for (size_t i = 1; i < estimates_.size(); ++i)
+            if (estimates_[i].bin - estimates_[i - 1].bin == spacing)
+                acc += std::complex<double>(estimates_[i].response) *
+                       std::conj(std::complex<double>(estimates_[i - 1].response));
+        return spacing > 0 ? -std::arg(acc) * probe_.fftSize() / (2 * M_PI * spacing) : 0;
+    }
+
+private:
+    void analyse()
+    {
+        stats_.periods++;
+        plan_.execute(buffer_.data());
+        double tonePower = 0, otherPower = 0;
+        for (size_t b = 0; b < buffer_.size(); ++b)
+            (isTone_[b] ? tonePower : otherPower) += std::norm(buffer_[b]);
+        size_t tones = probe_.tones();
+        size_t others = buffer_.size() - tones;
+        if (tonePower / tones < factor_ * std::max(otherPower / others, 1e-30)) {
+            stats_.rejected++;
+            return;
+        }
+        for (size_t i = 0; i < tones; ++i) {
+            std::complex<double> h = std::complex<double>(buffer_[probe_.slot(probe_.bins()[i])]) /
+                                     std::complex<double>(probe_.reference(i));
+            sum_[i] += h;
+            sumSq_[i] += std::norm(h);
+        }
+        accepted_++;
+    }
+
+    void reset()
+    {
+        std::fill(sum_.begin(), sum_.end(), 0.0);
+        std::fill(sumSq_.begin(), sumSq_.end(), 0.0);
+        accepted_ = 0;
+    }
+
+    // close the burst: average what was accepted into the estimates
+    bool finish()
+    {
+        uint32_t m = accepted_;
+        if (!m) return false;
+        for (size_t i = 0; i < probe_.tones(); ++i) {
+            std::complex<double> h = sum_[i] / double(m);
+            double var = std::max(sumSq_[i] / m - std::norm(h), 0.0);
+            ToneEstimate &e = estimates_[i];
+            e.response = std::complex<float>(h);
+            e.gainDb = float(std::norm(h) > 0 ? 10 * std::log10(std::norm(h)) : -200.0);
+            e.phase = float(std::arg(h));
+            // variance of the mean is var / m; a single period has no spread to measure
+            e.snrDb = m > 1 && var > 0 ? float(10 * std::log10(std::norm(h) * m / var)) : 0.0f;
+        }
+        reset();
+        stats_.estimates++;
+        return true;
+    }
+
+    const MultitoneProbe &probe_;
+    FftPlan plan_;
+    uint64_t cycle_;
+    uint64_t first_;                     // offset of the first analysed period in a burst
+    uint32_t periods_;
+    float factor_;
+    std::vector<bool> isTone_;
+    std::vector<cfloat> buffer_;
+    uint64_t fill_ = 0;
+    uint64_t burst_ = UINT64_MAX;        // cycle the accumulated periods belong to
+    std::vector<std::complex<double>> sum_;
+    std::vector<double> sumSq_;
+    uint32_t accepted_ = 0;
+    std::vector<ToneEstimate> estimates_;
+    MultitoneStats stats_;
+};
@@ -0,0 +1,114 @@
+// publish -> consume latency through the IQ ring with polling versus futex
+// wakeups. a producer thread publishes one block per block period (1024
+// samples at 30.72 MSPS by default) stamped with the publish time, and a
+// consumer thread reports how long each block took to reach it, plus the CPU
+// it burned waiting.
+//
+// usage: notifyBench [seconds per mode] [blockSamples]
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+#include "iqRing.h"
+
+#define BENCH_SHM_NAME "/limesuite_notify_bench"
+
+enum WaitMode {
+    WAIT_SLEEP_10MS,   // the old per-block sleep
+    WAIT_BACKOFF,      // yield, then 50us sleeps
+    WAIT_FUTEX,
+};
+
+static uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double threadCpuSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run(const char *label, WaitMode mode, uint32_t wakeBatch, double seconds, uint32_t blockSamples)
+{
+    IqRingWriter writer;
+    IqRingReader reader;
+    if (writer.create(BENCH_SHM_NAME, 256, blockSamples, IQ_FMT_I16, 30.72e6) != 0 || reader.open(BENCH_SHM_NAME) != 0)
+        return;
+    writer.setWakeBatch(wakeBatch);
+    const auto period = std::chrono::duration<double>(blockSamples / 30.72e6);
+    std::atomic<bool> done{false};
+    std::vector<double> latencies;
+    latencies.reserve(size_t(seconds / period.count()) + 16);
+    double consumerCpu = 0;
+    uint64_t lost = 0;
+
+    std::thread consumer([&] {
+        std::vector<int16_t> block(2 * blockSamples);
+        IqBlockInfo info;
+        unsigned idle = 0;
+        double cpu0 = threadCpuSeconds();
+        while (!done.load(std::memory_order_relaxed)) {
+            int got;
+            if (mode == WAIT_FUTEX) {
+                got = reader.wait(block.data(), blockSamples, &info, 100);
+            } else {
+                got = reader.read(block.data(), blockSamples, &info);
+                if (!got) {
+                    if (mode == WAIT_SLEEP_10MS)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    else if (++idle < 64)
+                        std::this_thread::yield();
+                    else
+                        std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    continue;
+                }
+                idle = 0;
+            }
+            if (!got) continue;
+            latencies.push_back((nowNs() - info.timestamp) * 1e-3);
+            lost += info.lost;
+        }
+        consumerCpu = threadCpuSeconds() - cpu0;
+    });
+
+    std::vector<int16_t> samples(2 * blockSamples);
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    while (std::chrono::steady_clock::now() - start < std::chrono::duration<double>(seconds)) {
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        std::this_thread::sleep_until(next);
+        writer.write(samples.data(), blockSamples, nowNs());
+    }
+    done = true;
+    writer.wakeReaders();
+    consumer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) { return latencies.empty() ? 0.0 : latencies[size_t(p * (latencies.size() - 1))]; };
+    std::cout << label << ": p50 " << pct(0.5) << " us, p99 " << pct(0.99) << " us, max " << pct(1.0)
+              << " us, consumer cpu " << 100 * consumerCpu / seconds << "%, wake syscalls "
+              << writer.wakes() << " for " << writer.published() << " blocks, lost " << lost << std::endl;
+    reader.close();
+    writer.close();
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    uint32_t blockSamples = argc > 2 ? atoi(argv[2]) : 1024;
+    std::cout << "block of " << blockSamples << " samples every " << blockSamples / 30.72 << " us" << std::endl;
+    run("poll, sleep 10 ms    ", WAIT_SLEEP_10MS, 1, seconds, blockSamples);
+    run("poll, yield + 50 us  ", WAIT_BACKOFF, 1, seconds, blockSamples);
+    run("futex, wake batch 1  ", WAIT_FUTEX, 1, seconds, blockSamples);
+    run("futex, wake batch 8  ", WAIT_FUTEX, 8, seconds, blockSamples);
+    return 0;
+}
@@ -0,0 +1,273 @@
+#pragma once
+// streaming power / RSSI estimator for interleaved int16 or float IQ
+//
+// per block: mean power, peak power and crest factor, plus an exponential
+// moving average of the mean, all in dBFS (a full-scale complex tone is
+// 0 dBFS). the per-sample |x|^2 sums run in SIMD kernels picked at runtime,
+// and readings can be published to a shared memory record for viewers.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "iqRing.h"
+#include "shmSegment.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POWER_METER_X86 1
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define POWER_METER_NEON 1
+#endif
+
+#define POWER_SHM_NAME "/limesuite_power"
+#define POWER_SHM_MAGIC 0x52574f50u // "POWR"
+#define POWER_SHM_VERSION 1
+
+// raw block sums in input units squared
+struct PowerSums {
+    double sum;  // sum of I^2 + Q^2
+    double peak; // largest I^2 + Q^2
+};
+
+typedef PowerSums (*PowerI16Fn)(const int16_t *iq, size_t pairs);
+typedef PowerSums (*PowerF32Fn)(const float *iq, size_t pairs);
+
+inline PowerSums powerI16Scalar(const int16_t *iq, size_t pairs)
+{
+    uint64_t sum = 0;
+    uint32_t peak = 0;
+    for (size_t i = 0; i < pairs; ++i) {
+        // each square fits int32, their sum (2^31 at -32768, -32768) only uint32
+        int32_t re = iq[2 * i], im = iq[2 * i + 1];
+        uint32_t m = uint32_t(re * re) + uint32_t(im * im);
+        sum += m;
+        if (m > peak) peak = m;
+    }
+    return {double(sum), double(peak)};
+}
+
+inline PowerSums powerF32Scalar(const float *iq, size_t pairs)
+{
+    double sum = 0;
+    float peak = 0;
+    for (size_t i = 0; i < pairs; ++i) {
+        float m = iq[2 * i] * iq[2 * i] + iq[2 * i + 1] * iq[2 * i + 1];
+        sum += m;
+        if (m > peak) peak = m;
+    }
+    return {sum, peak};
+}
+
+#ifdef POWER_METER_X86
+__attribute__((target("avx2"))) inline PowerSums powerI16Avx2(const int16_t *iq, size_t pairs)
+{
+    __m256i sum = _mm256_setzero_si256();
+    __m256i peak = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= pairs; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(iq + 2 * i));
+        // I*I + Q*Q per pair in one instruction; read as unsigned so the
+        // (-32768, -32768) corner does not wrap negative
+        __m256i m = _mm256_madd_epi16(v, v);
+        peak = _mm256_max_epu32(peak, m);
+        sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(m)));
+        sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(m, 1)));
+    }
+    alignas(32) uint64_t sums[4];
+    alignas(32) uint32_t peaks[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(sums), sum);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(peaks), peak);
+    PowerSums tail = powerI16Scalar(iq + 2 * i, pairs - i);
+    double total = tail.sum + double(sums[0] + sums[1] + sums[2] + sums[3]);
+    double top = tail.peak;
+    for (uint32_t p : peaks)
+        if (p > top) top = p;
+    return {total, top};
+}
+
+__attribute__((target("avx2,fma"))) inline PowerSums powerF32Avx2(const float *iq, size_t pairs)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 peak = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= pairs; i += 8) {
+        __m256 a = _mm256_loadu_ps(iq + 2 * i);
+        __m256 b = _mm256_loadu_ps(iq + 2 * i + 8);
+        __m256 sa = _mm256_mul_ps(a, a);
+        __m256 sb = _mm256_mul_ps(b, b);
+        acc0 = _mm256_add_ps(acc0, sa);
+        acc1 = _mm256_add_ps(acc1, sb);
+        // swap I/Q lanes so every lane holds its pair's I^2 + Q^2
+        peak = _mm256_max_ps(peak, _mm256_add_ps(sa, _mm256_permute_ps(sa, 0xb1)));
+        peak = _mm256_max_ps(peak, _mm256_add_ps(sb, _mm256_permute_ps(sb, 0xb1)));
+    }
+    alignas(32) float sums[8];
+    alignas(32) float peaks[8];
+    _mm256_store_ps(sums, _mm256_add_ps(acc0, acc1));
+    _mm256_store_ps(peaks, peak);
+    PowerSums tail = powerF32Scalar(iq + 2 * i, pairs - i);
+    double total = tail.sum;
+    double top = tail.peak;
+    for (int k = 0; k < 8; ++k) {
+        total += sums[k];
+        if (peaks[k] > top) top = peaks[k];
+    }
+    return {total, top};
+}
+#endif
+
+#ifdef POWER_METER_NEON
+inline PowerSums powerI16Neon(const int16_t *iq, size_t pairs)
+{
+    uint64x2_t sum = vdupq_n_u64(0);
+    uint32x4_t peak = vdupq_n_u32(0);
+    size_t i = 0;
+    for (; i + 4 <= pairs; i += 4) {
+        int16x8_t v = vld1q_s16(iq + 2 * i);
+        int32x4_t lo = vmull_s16(vget_low_s16(v), vget_low_s16(v));
+        int32x4_t hi = vmull_s16(vget_high_s16(v), vget_high_s16(v));
+        uint32x4_t m = vreinterpretq_u32_s32(vpaddq_s32(lo, hi));
+        peak = vmaxq_u32(peak, m);
+        sum = vpadalq_u32(sum, m);
+    }
+    PowerSums tail = powerI16Scalar(iq + 2 * i, pairs - i);
+    double top = tail.peak;
+    if (vmaxvq_u32(peak) > top) top = vmaxvq_u32(peak);
+    return {tail.sum + double(vaddvq_u64(sum)), top};
+}
+
+inline PowerSums powerF32Neon(const float *iq, size_t pairs)
+{
+    float32x4_t acc = vdupq_n_f32(0);
+    float32x4_t peak = vdupq_n_f32(0);
+    size_t i = 0;
+    for (; i + 4 <= pairs; i += 4) {
+        float32x4_t a = vld1q_f32(iq + 2 * i);
+        float32x4_t b = vld1q_f32(iq + 2 * i + 4);
+        float32x4_t m = vpaddq_f32(vmulq_f32(a, a), vmulq_f32(b, b));
+        acc = vaddq_f32(acc, m);
+        peak = vmaxq_f32(peak, m);
+    }
+    PowerSums tail = powerF32Scalar(iq + 2 * i, pairs - i);
+    double top = tail.peak;
+    if (vmaxvq_f32(peak) > top) top = vmaxvq_f32(peak);
+    return {tail.sum + vaddvq_f32(acc), top};
+}
+#endif
+
+struct PowerKernels {
+    const char *name;
+    PowerI16Fn i16;
+    PowerF32Fn f32;
+};
+
+inline const PowerKernels &bestPowerKernels()
+{
+    static const PowerKernels scalar = {"scalar", powerI16Scalar, powerF32Scalar};
+#ifdef POWER_METER_X86
+    static const PowerKernels avx2 = {"avx2", powerI16Avx2, powerF32Avx2};
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return avx2;
+#endif
+#ifdef POWER_METER_NEON
+    static const PowerKernels neon = {"neon", powerI16Neon, powerF32Neon};
+    return neon;
+#endif
+    return scalar;
+}
+
+struct PowerReading {
+    uint64_t block;
+    uint64_t timestamp;
+    uint32_t count;
+    float meanDbfs;
+    float peakDbfs;
+    float crestDb;     // peak over mean
+    float emaDbfs;     // moving average of the mean power
+};
+
+inline float powerToDb(double p)
+{
+    return p > 0 ? float(10.0 * std::log10(p)) : -200.0f;
+}
+
+class PowerMeter {
+public:
+    // emaSeconds is the time constant of the moving average
+    PowerMeter(double sampleRate, double emaSeconds = 0.1)
+        : sampleRate_(sampleRate), emaSeconds_(emaSeconds), kernels_(bestPowerKernels()) {}
+
+    // fullScale is the sample value of 1.0 (LMS_I12_FULL_SCALE, 1 for floats)
+    PowerReading process(const void *samples, uint32_t count, IqSampleFormat fmt, float fullScale,
+                         uint64_t block = 0, uint64_t timestamp = 0)
+    {
+        PowerReading r = {block, timestamp, count, -200.0f, -200.0f, 0.0f, powerToDb(ema_)};
+        if (count == 0) return r;
+        PowerSums s = fmt == IQ_FMT_I16 ? kernels_.i16(static_cast<const int16_t *>(samples), count)
+                                        : kernels_.f32(static_cast<const float *>(samples), count);
+        double norm = 1.0 / (double(fullScale) * fullScale);
+        double mean = s.sum / count * norm;
+        double peak = s.peak * norm;
+
+        // alpha follows the block length so the time constant stays in seconds
+        double alpha = 1.0 - std::exp(-double(count) / (sampleRate_ * emaSeconds_));
+        ema_ = primed_ ? ema_ + alpha * (mean - ema_) : mean;
+        primed_ = true;
+
+        r.meanDbfs = powerToDb(mean);
+        r.peakDbfs = powerToDb(peak);
+        r.crestDb = mean > 0 ? r.peakDbfs - r.meanDbfs : 0.0f;
+        r.emaDbfs = powerToDb(ema_);
+        return r;
+    }
+
+    const char *kernelName() const { return kernels_.name; }
+
+private:
+    double sampleRate_;
+    double emaSeconds_;
+    const PowerKernels &kernels_;
+    double ema_ = 0;
+    bool primed_ = false;
+};
+
+// layout of POWER_SHM_NAME
+struct PowerShm {
+    uint32_t magic;
+    uint32_t version;
+    SeqlockRecord<PowerReading> reading;
+};
+
+class PowerPublisher {
+public:
+    ~PowerPublisher() { close(); }
+
+    int create(const char *name = POWER_SHM_NAME)
+    {
+        shm_ = static_cast<PowerShm *>(shmCreate(name, sizeof(PowerShm)));
+        if (!shm_) return -1;
+        name_ = name;
+        shm_->version = POWER_SHM_VERSION;
+        shm_->magic = POWER_SHM_MAGIC;
+        return 0;
+    }
+
+    void publish(const PowerReading &r)
+    {
+        if (shm_) shm_->reading.store(r);
+    }
+
+    void close()
+    {
+        if (shm_) {
+            munmap(shm_, sizeof(PowerShm));
+            shm_unlink(name_.c_str());
+            shm_ = nullptr;
+        }
+    }
+
+private:
+    PowerShm *shm_ = nullptr;
+    std::string name_;
+};
@@ -0,0 +1,67 @@
+import mmap
+import ctypes
+import os
+import time
+
+# Shared memory name
+shm_name = "/dev/shm/limesuite_power"
+
+# layout, mirrors PowerShm in powerMeter.h
+POWER_SHM_MAGIC = 0x52574f50
+POWER_SHM_VERSION = 1
+
+class PowerReading(ctypes.Structure):
+    _fields_ = [
+        ("block", ctypes.c_uint64),
+        ("timestamp", ctypes.c_uint64),
+        ("count", ctypes.c_uint32),
+        ("meanDbfs", ctypes.c_float),
+        ("peakDbfs", ctypes.c_float),
+        ("crestDb", ctypes.c_float),
+        ("emaDbfs", ctypes.c_float),
+    ]
+
+class PowerShm(ctypes.Structure):
+    _fields_ = [
+        ("magic", ctypes.c_uint32),
+        ("version", ctypes.c_uint32),
+        ("seq", ctypes.c_uint64),
+        ("reading", PowerReading),
+    ]
+
+def read_reading(shm):
+    """seqlock read, None while the writer is mid-update"""
+    for _ in range(16):
+        snapshot = PowerShm.from_buffer_copy(shm, 0)
+        if snapshot.seq == 0 or snapshot.seq & 1:
+            continue
+        if PowerShm.from_buffer_copy(shm, 0).seq == snapshot.seq:
+            return snapshot.reading
+    return None
+
+# Open shared memory with retry
+shm_fd = None
+while shm_fd is None:
+    try:
+        shm_fd = os.open(shm_name, os.O_RDONLY)
+    except FileNotFoundError:
+        print(f"Waiting for shared memory {shm_name} to be created...")
+        time.sleep(0.5)  # Wait 500ms before retrying
+
+shm = mmap.mmap(shm_fd, ctypes.sizeof(PowerShm), mmap.MAP_SHARED, mmap.PROT_READ)
+header = PowerShm.from_buffer_copy(shm, 0)
+if header.magic != POWER_SHM_MAGIC or header.version != POWER_SHM_VERSION:
+    raise SystemExit(f"{shm_name} is not a version {POWER_SHM_VERSION} power record")
+
+try:
+    while True:
+        reading = read_reading(shm)
+        if reading is not None:
+            print(f"block {reading.block:10d}  mean {reading.meanDbfs:7.2f} dBFS  peak {reading.peakDbfs:7.2f} dBFS  "
+                  f"crest {reading.crestDb:5.2f} dB  avg {reading.emaDbfs:7.2f} dBFS", end="\r", flush=True)
+        time.sleep(0.1)
+except KeyboardInterrupt:
+    print("\nStopping monitor...")
+finally:
+    shm.close()
+    os.close(shm_fd)
@@ -1,14 +1,13 @@
 #include <iostream>
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
-#include <semaphore.h>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
 #include <string.h>
 #include <time.h>
-#include <errno.h>
+#include <unistd.h>
+#include "broadcastQueue.h"
 
 #define SHM_NAME "/live_data"
-#define SEM_NAME "/semCtrl"
 #define QUEUE_SIZE 1024
 #define TEXT_SIZE 64
 
@@ -18,73 +17,49 @@ struct QueueEntry {
     char text[TEXT_SIZE];
 };
 
-// Structure for the FIFO queue
-struct SharedQueue {
-    size_t head;
-    size_t tail;
-    size_t count;
-    QueueEntry entries[QUEUE_SIZE];
-};
+static std::atomic<bool> stop_requested{false};
 
-int error(const char *msg) {
-    std::cerr << msg << ": " << strerror(errno) << std::endl;
-    return -1;
+static void onSignal(int)
+{
+    stop_requested = true;
 }
 
-int main() {
-
-    // open shared memory
-    int shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1) return error("shm_open failed");
+// usage: provider [block|drop|sample] [intervalMs]
+// any number of consumers (queueConsumer, consumer.py) can read the same
+// entries; the policy decides what happens when one of them falls behind
+int main(int argc, char **argv) {
 
-    // set size of shared memory
-    if (ftruncate(shm_fd, sizeof(SharedQueue)) == -1) error("ftruncate failed");
+    BqPolicy policy = BQ_BLOCK;
+    if (argc > 1 && strcmp(argv[1], "drop") == 0) policy = BQ_DROP_OLDEST;
+    else if (argc > 1 && strcmp(argv[1], "sample") == 0) policy = BQ_SAMPLE;
+    useconds_t interval_us = argc > 2 ? atoi(argv[2]) * 1000 : 100000;
 
-    // Map shared memory
-    SharedQueue *queue = (SharedQueue *)mmap(nullptr, sizeof(SharedQueue), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (queue == MAP_FAILED) return error("mmap failed");
+    // create the broadcast queue in shared memory
+    BroadcastProducer<QueueEntry> queue;
+    if (queue.create(SHM_NAME, QUEUE_SIZE, policy) != 0) return -1;
+    std::cout << "Queue " << SHM_NAME << " created, policy " << bqPolicyName(policy) << std::endl;
 
-    // Create a named semaphore
-    sem_t *sem = sem_open(SEM_NAME, O_CREAT, 0666, 1);
-    if (sem == SEM_FAILED) error("sem_open failed");
-
-    // initialize shared queue
-    queue->head = 0;
-    queue->tail = 0;
-    queue->count = 0;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
 
     // produce some data
     int i = 0;
-    while (true) {
-        // wait for semaphore
-        if (sem_wait(sem) == -1) return error("sem_wait failed");
-        // check if queue is full
-        if (queue->count == QUEUE_SIZE) {
-            std::cerr << "Queue is full, waiting for consumer..." << std::endl;
-            sem_post(sem); // release semaphore lock
-            usleep(100000); // Sleep for 100 milliseconds
-            continue;
-        }
-
+    QueueEntry entry;
+    while (!stop_requested) {
         // produce data
-        QueueEntry &entry = queue->entries[queue->tail];
         entry.timestamp = time(nullptr);
         snprintf(entry.text, TEXT_SIZE, "Data id : %06d", i++);
-        // increment tail index
-        queue->tail = (queue->tail + 1) % QUEUE_SIZE;
-        queue->count++;
-        std::cout << "Produced: " << entry.text << " at " << entry.timestamp << std::endl;
-        // signal that data is available
-        sem_post(sem); // release semaphore lock
+        // under the block policy this waits for the slowest consumer
+        if (!queue.publish(entry, &stop_requested)) break;
+        std::cout << "Produced: " << entry.text << " at " << entry.timestamp
+                  << " (" << queue.consumers() << " consumers)" << std::endl;
         // sleep for a while to simulate data production
-        usleep(100000); // Sleep for 100 milliseconds
+        if (interval_us) usleep(interval_us);
     }
 
-    //Cleanup
-    munmap(queue, sizeof(SharedQueue));
-    shm_unlink(SHM_NAME);
-    sem_close(sem);
-    sem_unlink(SEM_NAME);
-    close(shm_fd);
+    // Cleanup
+    std::cout << "Published " << queue.published() << " entries, producer stalled "
+              << queue.stalls() << " times" << std::endl;
+    queue.close();
     return 0;
-}
\ No newline at end of file
+}
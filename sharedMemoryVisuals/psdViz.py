@@ -0,0 +1,80 @@
+import mmap
+import ctypes
+import numpy as np
+import matplotlib.pyplot as plt
+import os
+import time
+
+# Shared memory name
+shm_name = "/dev/shm/limesuite_psd"
+
+# layout, mirrors PsdShmHeader in spectrum.h; bins floats follow the header
+PSD_SHM_MAGIC = 0x46445350
+PSD_SHM_VERSION = 1
+
+class PsdShmHeader(ctypes.Structure):
+    _fields_ = [
+        ("magic", ctypes.c_uint32),
+        ("version", ctypes.c_uint32),
+        ("bins", ctypes.c_uint32),
+        ("averages", ctypes.c_uint32),
+        ("sampleRate", ctypes.c_double),
+        ("binHz", ctypes.c_double),
+        ("seq", ctypes.c_uint64),
+        ("frame", ctypes.c_uint64),
+        ("timestamp", ctypes.c_uint64),
+    ]
+
+# Open shared memory with retry
+shm_fd = None
+while shm_fd is None:
+    try:
+        shm_fd = os.open(shm_name, os.O_RDONLY)
+    except FileNotFoundError:
+        print(f"Waiting for shared memory {shm_name} to be created...")
+        time.sleep(0.5)  # Wait 500ms before retrying
+
+shm = mmap.mmap(shm_fd, os.fstat(shm_fd).st_size, mmap.MAP_SHARED, mmap.PROT_READ)
+header = PsdShmHeader.from_buffer_copy(shm, 0)
+if header.magic != PSD_SHM_MAGIC or header.version != PSD_SHM_VERSION:
+    raise SystemExit(f"{shm_name} is not a version {PSD_SHM_VERSION} PSD segment")
+bins = header.bins
+frame_offset = ctypes.sizeof(PsdShmHeader)
+freqs_mhz = (np.arange(bins) - bins // 2) * header.binHz / 1e6
+
+def read_frame():
+    """seqlock read of the newest frame, None while the writer is mid-update"""
+    before = PsdShmHeader.from_buffer_copy(shm, 0)
+    if before.seq == 0 or before.seq & 1:
+        return None
+    psd = np.frombuffer(shm, dtype=np.float32, count=bins, offset=frame_offset).copy()
+    if PsdShmHeader.from_buffer_copy(shm, 0).seq != before.seq:
+        return None
+    return before.frame, psd
+
+# Set up real-time plotting
+plt.ion()
+fig, ax = plt.subplots(figsize=(10, 6))
+line, = ax.plot(freqs_mhz, np.full(bins, -200.0), label="Welch PSD")
+ax.set_title("Real-Time Power Spectral Density")
+ax.set_xlabel("Offset from LO (MHz)")
+ax.set_ylabel("dBFS/Hz")
+ax.set_ylim(-160, -40)
+ax.grid(True)
+ax.legend()
+
+last_frame = None
+try:
+    while True:
+        latest = read_frame()
+        if latest is not None and latest[0] != last_frame:
+            last_frame, psd = latest
+            line.set_ydata(psd)
+            ax.set_title(f"Real-Time Power Spectral Density (frame {last_frame}, {header.averages} averages)")
+            plt.draw()
+        plt.pause(0.05)  # ~20 redraws per second at most
+except KeyboardInterrupt:
+    print("Stopping plotter...")
+finally:
+    shm.close()
+    os.close(shm_fd)
@@ -0,0 +1,67 @@
+// example consumer of the provider's broadcast queue; run as many as you like
+//
+// usage: queueConsumer [delayMs] [--oldest] [--quiet]
+// delayMs slows this consumer down to see the producer's policy at work
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "broadcastQueue.h"
+
+#define SHM_NAME "/live_data"
+#define TEXT_SIZE 64
+
+// must match provider.cpp
+struct QueueEntry {
+    int64_t timestamp;
+    char text[TEXT_SIZE];
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void onSignal(int)
+{
+    stop_requested = 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned delay_ms = 0;
+    bool from_oldest = false;
+    bool quiet = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--oldest") == 0) from_oldest = true;
+        else if (strcmp(argv[i], "--quiet") == 0) quiet = true;
+        else delay_ms = atoi(argv[i]);
+    }
+
+    BroadcastConsumer<QueueEntry> queue;
+    for (int attempt = 0; queue.open(SHM_NAME, from_oldest) != 0; ++attempt) {
+        if (attempt == 10) return 1;
+        std::cout << "Waiting for " << SHM_NAME << " to be created..." << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    std::cout << "Consumer " << getpid() << " attached, policy " << bqPolicyName(queue.policy()) << std::endl;
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    QueueEntry entry;
+    BqReadInfo info;
+    uint64_t received = 0;
+    while (!stop_requested) {
+        if (!queue.wait(&entry, 500, &info)) continue;
+        received++;
+        if (!quiet) {
+            std::cout << "#" << info.sequence << " Timestamp: " << entry.timestamp << ", Text: " << entry.text;
+            if (info.lost) std::cout << " (" << info.lost << " missed)";
+            std::cout << std::endl;
+        }
+        if (delay_ms) std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    }
+    std::cout << "Received " << received << " entries, missed " << queue.dropped() << std::endl;
+    return 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+// opt-in real-time setup for the capture process: SCHED_FIFO priorities,
+// locked and prefaulted memory, and a wakeup jitter self-test
+//
+// none of this is needed for correctness; it takes the scheduler and page
+// faults out of the receive loop's latency so a loaded box does not turn
+// them into FIFO overruns. SCHED_FIFO and mlockall need CAP_SYS_NICE and
+// CAP_IPC_LOCK (or rtprio / memlock limits in limits.conf); without them
+// every call here fails with the reason and the process carries on as before.
+//
+// the self-test is a cyclictest-style loop: sleep to an absolute deadline
+// every periodUs, record how late the wakeup was, report the worst case.
+
+#include <iostream>
+#include <algorithm>
+#include <alloca.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "statsPage.h"
+#include "threadAffinity.h"
+
+// SCHED_FIFO at priority (1..99) for the calling thread, 0 for SCHED_OTHER.
+// returns 0 or the error number; the caller logs it, this may run on a
+// thread that must not print
+inline int setThreadPriority(int priority)
+{
+    sched_param param = {};
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+}
+
+inline std::string realtimeError(int err)
+{
+    return std::string(strerror(err)) + (err == EPERM ? " (needs CAP_SYS_NICE or an rtprio limit)" : "");
+}
+
+// lock everything mapped now and later, so no page of a buffer faults in
+// from the receive loop
+inline int lockMemory()
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "realtime: mlockall failed: " << strerror(errno)
+                  << (errno == ENOMEM || errno == EPERM ? " (needs CAP_IPC_LOCK or a memlock limit)" : "") << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// write every page once so it is backed before the hot path touches it
+inline void prefault(void *base, size_t size)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    volatile uint8_t *p = static_cast<volatile uint8_t *>(base);
+    for (size_t off = 0; off < size; off += size_t(page))
+        p[off] = p[off];
+}
+
+// fault in stack pages the calling thread will grow into
+inline void prefaultStack(size_t bytes = 256 * 1024)
+{
+    volatile uint8_t *stack = static_cast<volatile uint8_t *>(alloca(bytes));
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < bytes; off += size_t(page))
+        stack[off] = 0;
+}
+
+struct JitterResult {
+    uint64_t wakeups;
+    uint64_t meanNs;
+    uint64_t p99Ns;
+    uint64_t maxNs;
+};
+
+// wake every periodUs for seconds on cpu at priority, as the capture thread
+// would be set up, and measure how late each wakeup is
+inline JitterResult jitterSelfTest(double seconds, unsigned periodUs = 100, int cpu = -1, int priority = 0)
+{
+    JitterResult result = {0, 0, 0, 0};
+    StatsMetric *hist = new StatsMetric();
+    std::thread worker([&] {
+        if (cpu >= 0) pinThisThread(cpu);
+        int err = priority > 0 ? setThreadPriority(priority) : 0;
+        if (err) std::cerr << "jitter: SCHED_FIFO " << priority << ": " << realtimeError(err) << std::endl;
+        prefaultStack();
+        timespec next;
+        clock_gettime(CLOCK_MONOTONIC, &next);
+        uint64_t sum = 0;
+        uint64_t wakeups = uint64_t(seconds * 1e6 / periodUs);
+        for (uint64_t i = 0; i < wakeups; ++i) {
+            next.tv_nsec += long(periodUs) * 1000;
+            while (next.tv_nsec >= 1000000000L) {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int64_t late = (now.tv_sec - next.tv_sec) * 1000000000LL + (now.tv_nsec - next.tv_nsec);
+            uint64_t ns = late > 0 ? uint64_t(late) : 0;
+            hist->record(ns);
+            sum += ns;
+            result.maxNs = std::max(result.maxNs, ns);
+        }
+        result.wakeups = wakeups;
+        result.meanNs = wakeups ? sum / wakeups : 0;
+    });
+    worker.join();
+    result.p99Ns = statsPercentile(*hist, 0.99);
+    delete hist;
+    return result;
+}
+
+inline void reportJitter(std::ostream &os, const JitterResult &r, unsigned periodUs)
+{
+    os << "jitter: " << r.wakeups << " wakeups every " << periodUs << " us, late by mean " << r.meanNs / 1e3
+       << " us, p99 " << r.p99Ns / 1e3 << " us, worst " << r.maxNs / 1e3 << " us" << std::endl;
+}
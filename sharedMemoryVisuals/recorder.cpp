@@ -0,0 +1,51 @@
+// file-backed recorder test: streams synthetic 12-bit IQ through IqRecorder
+// as fast as possible (or paced at the sample rate) and reports the
+// sustained write rate. needs no LimeSDR.
+//
+// usage: recorder <basePath> [megabytes] [--paced]
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "iqRecorder.h"
+#include "syntheticRxSource.h"
+
+#define BLOCK_SAMPLES 16384
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <basePath> [megabytes] [--paced]" << std::endl;
+        return 1;
+    }
+    uint64_t megabytes = argc > 2 && argv[2][0] != '-' ? strtoull(argv[2], nullptr, 10) : 2048;
+    bool paced = argc > 2 && strcmp(argv[argc - 1], "--paced") == 0;
+    const double sample_rate = 30.72e6;
+
+    SyntheticRxSource source(sample_rate, 100e3, 0.5f, 0.01f, paced, 1 << 16, IQ_FMT_I16);
+    IqRecorder recorder;
+    RecordingInfo info = {IQ_FMT_I16, sample_rate, 2.4e9, 20, 0, "synthetic"};
+    if (recorder.open(argv[1], info) != 0) return 1;
+
+    std::vector<int16_t> block(2 * BLOCK_SAMPLES);
+    uint64_t target = megabytes << 20;
+    uint64_t written = 0;
+    RxMeta meta;
+    auto start = std::chrono::steady_clock::now();
+    while (written < target) {
+        int received = source.recv(block.data(), BLOCK_SAMPLES, &meta, 1000);
+        recorder.writeBlock(block.data(), uint32_t(received), meta.timestamp);
+        written += size_t(received) * 2 * sizeof(int16_t);
+    }
+    recorder.close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const RecorderStats &stats = recorder.stats();
+    std::cout << "backend " << recorder.backend() << ": " << stats.bytes / seconds / 1e6 << " MB/s, "
+              << stats.writes << " writes, " << stats.stalls << " stalls, " << stats.errors << " errors, "
+              << stats.lostBytes << " bytes lost" << std::endl;
+    std::cout << "needed for 30.72 MSPS int16: " << sample_rate * 4 / 1e6 << " MB/s" << std::endl;
+    return stats.errors ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+// compares the copy relay (receive into a local buffer, memcpy into the ring)
+// with the zero-copy relay (receive straight into a claimed ring slot)
+// using the synthetic source, so no LimeSDR is needed
+//
+// usage: relayBench [blocks] [blockSamples]
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include "iqRing.h"
+#include "syntheticRxSource.h"
+
+#define BENCH_SHM_NAME "/limesuite_relay_bench"
+
+static double run(bool zeroCopy, uint64_t blocks, uint32_t blockSamples)
+{
+    IqRingWriter ring;
+    if (ring.create(BENCH_SHM_NAME, 256, blockSamples, IQ_FMT_F32, 30.72e6) != 0) exit(1);
+    SyntheticRxSource source(30.72e6, 100e3);
+    std::vector<float> samples(2 * blockSamples);
+    RxMeta meta;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t b = 0; b < blocks; ++b) {
+        if (zeroCopy) {
+            int received = source.recv(ring.claim(), blockSamples, &meta, 1000);
+            ring.publish(received, meta.timestamp);
+        } else {
+            int received = source.recv(samples.data(), blockSamples, &meta, 1000);
+            ring.write(samples.data(), received, meta.timestamp);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t blocks = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    uint32_t blockSamples = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1024;
+    double bytes = double(blocks) * blockSamples * 2 * sizeof(float);
+
+    for (bool zeroCopy : {false, true}) {
+        double seconds = run(zeroCopy, blocks, blockSamples);
+        std::cout << (zeroCopy ? "zero-copy: " : "copy:      ")
+                  << double(blocks) * blockSamples / seconds / 1e6 << " MS/s, "
+                  << bytes / seconds / 1e9 << " GB/s relayed" << std::endl;
+    }
+    return 0;
+}
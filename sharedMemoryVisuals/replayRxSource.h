@@ -0,0 +1,227 @@
+#pragma once
+// RxSource that replays a recorded IQ file, so the processing side can run
+// without a LimeSDR and faster than real time
+//
+// the file is mmap'd read-only and recv() copies out of the mapping, the
+// same way LMS_RecvStream copies out of the driver FIFO. format and sample
+// rate come from the SigMF sidecar written by IqRecorder when there is one.
+// timestamps jump where the recording starts a new capture, as they did
+// live, and continue across loops as if the stream never stopped.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include "iqRing.h"
+#include "rxSource.h"
+
+// a SigMF capture: first sample in the file and its stream timestamp
+struct ReplayCapture {
+    uint64_t sampleStart;
+    uint64_t timestamp;
+};
+
+// fields of a .sigmf-meta file the replay needs
+struct ReplayInfo {
+    IqSampleFormat format;
+    double sampleRate;
+    double frequency;
+    uint64_t timestamp;    // stream timestamp of the first sample
+    std::vector<ReplayCapture> captures;
+};
+
+// pull a value out of flat SigMF JSON; good enough for what IqRecorder writes
+inline bool sigmfField(const std::string &json, const char *key, std::string *value)
+{
+    std::string quoted = std::string("\"") + key + "\"";
+    size_t pos = json.find(quoted);
+    if (pos == std::string::npos) return false;
+    pos = json.find(':', pos + quoted.size());
+    if (pos == std::string::npos) return false;
+    size_t start = json.find_first_not_of(" \t\"", pos + 1);
+    size_t end = json.find_first_of(",\"\n}", start);
+    if (start == std::string::npos || end == std::string::npos) return false;
+    *value = json.substr(start, end - start);
+    return true;
+}
+
+// returns false if the sidecar is missing, info keeps its defaults then
+inline bool readSigmfMeta(const std::string &metaPath, ReplayInfo *info)
+{
+    std::ifstream in(metaPath);
+    if (!in) return false;
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string json = ss.str(), v;
+    if (sigmfField(json, "core:datatype", &v)) {
+        if (v == "ci16_le") info->format = IQ_FMT_I16;
+        else if (v == "cf32_le") info->format = IQ_FMT_F32;
+        else std::cerr << metaPath << ": unsupported datatype " << v << std::endl;
+    }
+    if (sigmfField(json, "core:sample_rate", &v) && atof(v.c_str()) > 0) info->sampleRate = atof(v.c_str());
+    if (sigmfField(json, "core:frequency", &v)) info->frequency = atof(v.c_str());
+    if (sigmfField(json, "lime:timestamp", &v)) info->timestamp = strtoull(v.c_str(), nullptr, 10);
+
+    // one object per capture, in sample_start order
+    info->captures.clear();
+    size_t pos = json.find("\"captures\"");
+    size_t end = pos == std::string::npos ? pos : json.find(']', pos);
+    while (pos != std::string::npos && (pos = json.find('{', pos)) < end) {
+        size_t close = json.find('}', pos);
+        std::string capture = json.substr(pos, close - pos), start, timestamp;
+        if (sigmfField(capture, "core:sample_start", &start) && sigmfField(capture, "lime:timestamp", &timestamp))
+            info->captures.push_back({strtoull(start.c_str(), nullptr, 10), strtoull(timestamp.c_str(), nullptr, 10)});
+        pos = close;
+    }
+    return true;
+}
+
+class ReplayRxSource : public RxSource {
+public:
+    ~ReplayRxSource() { close(); }
+
+    // path is the data file, or the base path of a SigMF recording.
+    // info supplies format and rate for raw files without a sidecar
+    int open(const std::string &path, const ReplayInfo &info, bool paced = false, bool loop = true)
+    {
+        info_ = info;
+        paced_ = paced;
+        loop_ = loop;
+        std::string dataPath = path;
+        std::string base = path;
+        const std::string ext = ".sigmf-data";
+        if (base.size() > ext.size() && base.compare(base.size() - ext.size(), ext.size(), ext) == 0)
+            base.erase(base.size() - ext.size());
+        else if (access(path.c_str(), R_OK) != 0)
+            dataPath = path + ext;
+        readSigmfMeta(base + ".sigmf-meta", &info_);
+
+        int fd = ::open(dataPath.c_str(), O_RDONLY);
+        if (fd == -1) {
+            std::cerr << "replay: cannot open " << dataPath << ": " << strerror(errno) << std::endl;
+            return -1;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            ::close(fd);
+            return -1;
+        }
+        bytesPerSample_ = iqBytesPerSample(info_.format);
+        samples_ = st.st_size / bytesPerSample_;
+        if (samples_ == 0) {
+            std::cerr << "replay: " << dataPath << " holds no samples" << std::endl;
+            ::close(fd);
+            return -1;
+        }
+        size_ = st.st_size;
+        base_ = static_cast<uint8_t *>(mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0));
+        ::close(fd);
+        if (base_ == MAP_FAILED) {
+            base_ = nullptr;
+            std::cerr << "replay: mmap failed: " << strerror(errno) << std::endl;
+            return -1;
+        }
+        // advice values are not flags, one call each
+        madvise(base_, size_, MADV_SEQUENTIAL);
+        madvise(base_, size_, MADV_WILLNEED);
+        timestamp_ = info_.timestamp;
+        std::vector<ReplayCapture> &caps = info_.captures;
+        caps.erase(std::remove_if(caps.begin(), caps.end(), [&](const ReplayCapture &c) { return c.sampleStart >= samples_; }),
+                   caps.end());
+        segment_ = 0;
+        return 0;
+    }
+
+    int recv(void *samples, size_t count, RxMeta *meta, unsigned) override
+    {
+        if (!base_) return -1;
+        if (!loop_) {
+            if (pos_ == samples_ && served_ > 0) {
+                error_ = "end of replay file";
+                return -1;
+            }
+            count = std::min(count, samples_ - pos_);
+        }
+        // one capture per call, its timestamp jump applied when it starts
+        const std::vector<ReplayCapture> &caps = info_.captures;
+        if (caps.size() > 1) {
+            if (pos_ == samples_) {
+                pos_ = 0;
+                loops_++;
+                segment_ = 0;
+            }
+            while (segment_ + 1 < caps.size() && pos_ >= caps[segment_ + 1].sampleStart) {
+                const ReplayCapture &prev = caps[segment_++];
+                timestamp_ += caps[segment_].timestamp - (prev.timestamp + caps[segment_].sampleStart - prev.sampleStart);
+            }
+            uint64_t end = segment_ + 1 < caps.size() ? caps[segment_ + 1].sampleStart : samples_;
+            count = std::min<uint64_t>(count, end - pos_);
+        }
+        if (paced_) pace(count);
+        if (meta) meta->timestamp = timestamp_;
+        uint8_t *out = static_cast<uint8_t *>(samples);
+        size_t done = 0;
+        while (done < count) {
+            if (pos_ == samples_) {
+                pos_ = 0;
+                loops_++;
+            }
+            size_t n = std::min(count - done, samples_ - pos_);
+            memcpy(out + done * bytesPerSample_, base_ + pos_ * bytesPerSample_, n * bytesPerSample_);
+            done += n;
+            pos_ += n;
+        }
+        timestamp_ += count;
+        served_ += count;
+        return int(count);
+    }
+
+    const char *lastError() const override { return error_.c_str(); }
+
+    void close()
+    {
+        if (base_) munmap(base_, size_);
+        base_ = nullptr;
+    }
+
+    IqSampleFormat format() const { return info_.format; }
+    double sampleRate() const { return info_.sampleRate; }
+    double frequency() const { return info_.frequency; }
+    uint64_t fileSamples() const { return samples_; }
+    uint64_t loops() const { return loops_; }
+
+private:
+    // block until the wall clock has caught up with the samples handed out
+    void pace(size_t count)
+    {
+        if (served_ == 0) start_ = std::chrono::steady_clock::now();
+        auto due = start_ + std::chrono::duration<double>((served_ + count) / info_.sampleRate);
+        std::this_thread::sleep_until(std::chrono::time_point_cast<std::chrono::steady_clock::duration>(due));
+    }
+
+    ReplayInfo info_ = {};
+    bool paced_ = false;
+    bool loop_ = true;
+    uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    size_t bytesPerSample_ = 0;
+    uint64_t samples_ = 0;
+    uint64_t pos_ = 0;
+    uint64_t served_ = 0;
+    uint64_t loops_ = 0;
+    uint64_t timestamp_ = 0;
+    size_t segment_ = 0;                 // capture pos_ is in
+    std::string error_;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,32 @@
+#pragma once
+// receive-side source abstraction so the relay and processing code can run
+// against a LimeSDR stream or a device-free stand-in
+
+#include <cstddef>
+#include <cstdint>
+
+// subset of lms_stream_meta_t the receive path needs
+struct RxMeta {
+    uint64_t timestamp; // sample counter of the first returned sample
+};
+
+// subset of lms_stream_status_t used for backlog/drop reporting
+struct RxStatus {
+    uint32_t fifoFilledCount;
+    uint32_t fifoSize;
+    uint32_t underrun;
+    uint32_t overrun;
+    uint32_t droppedPackets;
+    double linkRate;    // bytes/s over the device link
+};
+
+class RxSource {
+public:
+    virtual ~RxSource() {}
+    // same contract as LMS_RecvStream: fill up to count IQ pairs into samples,
+    // return the number received or -1 on error
+    virtual int recv(void *samples, size_t count, RxMeta *meta, unsigned timeoutMs) = 0;
+    // fill in stream health counters, -1 if the source has none
+    virtual int status(RxStatus *) { return -1; }
+    virtual const char *lastError() const { return ""; }
+};
@@ -0,0 +1,116 @@
+#pragma once
+// int16 IQ -> scaled float conversion with runtime SIMD dispatch
+//
+// the wire and shared memory carry the device's native 12/16-bit samples;
+// only consumers that really need floats pay for the conversion.
+// kernels are compiled with target attributes so the header builds with
+// default flags and the best one is picked on the running CPU.
+
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SAMPLE_CONVERT_X86 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SAMPLE_CONVERT_NEON 1
+#endif
+
+// full scale of the LimeSuite integer formats
+#define LMS_I12_FULL_SCALE 2048.0f
+#define LMS_I16_FULL_SCALE 32768.0f
+
+// n is the number of int16 values (2 per IQ pair)
+typedef void (*I16ToF32Fn)(const int16_t *in, float *out, size_t n, float scale);
+
+inline void i16ToF32Scalar(const int16_t *in, float *out, size_t n, float scale)
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = in[i] * scale;
+}
+
+#ifdef SAMPLE_CONVERT_X86
+__attribute__((target("sse2"))) inline void i16ToF32Sse2(const int16_t *in, float *out, size_t n, float scale)
+{
+    const __m128 k = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        // sign extend by unpacking into the high half and shifting back down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+    }
+    i16ToF32Scalar(in + i, out + i, n - i, scale);
+}
+
+__attribute__((target("avx2"))) inline void i16ToF32Avx2(const int16_t *in, float *out, size_t n, float scale)
+{
+    const __m256 k = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), k));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)), k));
+    }
+    i16ToF32Scalar(in + i, out + i, n - i, scale);
+}
+#endif
+
+#ifdef SAMPLE_CONVERT_NEON
+inline void i16ToF32Neon(const int16_t *in, float *out, size_t n, float scale)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+    i16ToF32Scalar(in + i, out + i, n - i, scale);
+}
+#endif
+
+struct I16ToF32Kernel {
+    const char *name;
+    I16ToF32Fn fn;
+    bool supported;
+};
+
+// every kernel built into this binary, best last
+inline const I16ToF32Kernel *i16ToF32Kernels(size_t *count)
+{
+    static const I16ToF32Kernel kernels[] = {
+        {"scalar", i16ToF32Scalar, true},
+#ifdef SAMPLE_CONVERT_X86
+        {"sse2", i16ToF32Sse2, bool(__builtin_cpu_supports("sse2"))},
+        {"avx2", i16ToF32Avx2, bool(__builtin_cpu_supports("avx2"))},
+#endif
+#ifdef SAMPLE_CONVERT_NEON
+        {"neon", i16ToF32Neon, true},
+#endif
+    };
+    *count = sizeof(kernels) / sizeof(kernels[0]);
+    return kernels;
+}
+
+inline const I16ToF32Kernel &bestI16ToF32Kernel()
+{
+    static const I16ToF32Kernel *best = [] {
+        size_t count;
+        const I16ToF32Kernel *kernels = i16ToF32Kernels(&count);
+        const I16ToF32Kernel *pick = &kernels[0];
+        for (size_t i = 0; i < count; ++i)
+            if (kernels[i].supported) pick = &kernels[i];
+        return pick;
+    }();
+    return *best;
+}
+
+// convert n int16 values to floats in [-1, 1) given the format's full scale
+inline void i16ToF32(const int16_t *in, float *out, size_t n, float fullScale)
+{
+    bestI16ToF32Kernel().fn(in, out, n, 1.0f / fullScale);
+}
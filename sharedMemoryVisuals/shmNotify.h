@@ -0,0 +1,91 @@
+#pragma once
+// publish/wait notification for the shared memory transports, built on a
+// futex on a sequence word that lives in the shared segment itself
+//
+// the producer bumps seq on every publish, which is just an atomic add. it
+// only enters the kernel (FUTEX_WAKE) when a consumer has announced itself
+// as sleeping in waiters, and then at most once per wakeBatch publishes, so
+// a producer running ahead of attentive consumers never makes a syscall.
+// consumers re-check their own data after registering as a waiter and sleep
+// on the value of seq they saw, so a publish between the check and the
+// FUTEX_WAIT is never missed.
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct ShmNotifier {
+    std::atomic<uint32_t> seq;       // bumped on every publish, the futex word
+    std::atomic<uint32_t> waiters;   // consumers sleeping (or about to) on seq
+};
+
+static_assert(sizeof(ShmNotifier) == 8, "ShmNotifier is part of shared layouts");
+
+// shared (not FUTEX_PRIVATE) futex calls: the word is mapped by several processes
+inline int shmFutexWait(std::atomic<uint32_t> *word, uint32_t expected, unsigned timeoutMs)
+{
+    timespec ts = {time_t(timeoutMs / 1000), long(timeoutMs % 1000) * 1000000L};
+    return int(syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected, &ts, nullptr, 0));
+}
+
+inline int shmFutexWake(std::atomic<uint32_t> *word, int count)
+{
+    return int(syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, count, nullptr, nullptr, 0));
+}
+
+// producer side, one per shared segment
+class NotifyPublisher {
+public:
+    void attach(ShmNotifier *n) { n_ = n; }
+
+    // wake sleepers at most once per batch publishes (1 wakes on every one)
+    void setWakeBatch(uint32_t batch) { batch_ = batch ? batch : 1; }
+
+    // call after the data is published
+    void notify()
+    {
+        // seq_cst pairs with the waiter's increment: either we see the waiter or
+        // it sees the new seq and FUTEX_WAIT returns straight away
+        n_->seq.fetch_add(1, std::memory_order_seq_cst);
+        if (++pending_ < batch_) return;
+        flush();
+    }
+
+    // wake any sleeper now, e.g. at shutdown or after the last publish of a burst
+    void flush()
+    {
+        pending_ = 0;
+        if (n_->waiters.load(std::memory_order_seq_cst) == 0) return;
+        shmFutexWake(&n_->seq, INT32_MAX);
+        wakes_++;
+    }
+
+    uint64_t wakes() const { return wakes_; }
+
+private:
+    ShmNotifier *n_ = nullptr;
+    uint32_t batch_ = 1;
+    uint32_t pending_ = 0;
+    uint64_t wakes_ = 0;
+};
+
+// consumer side: block until ready() holds, a publish arrives or timeoutMs passes
+// ready is checked again after registering as a waiter, before sleeping
+template <typename Ready>
+bool notifyWait(ShmNotifier *n, Ready ready, unsigned timeoutMs)
+{
+    if (ready()) return true;
+    uint32_t seen = n->seq.load(std::memory_order_acquire);
+    n->waiters.fetch_add(1, std::memory_order_seq_cst);
+    bool ok = ready();
+    if (!ok) {
+        shmFutexWait(&n->seq, seen, timeoutMs);
+        ok = ready();
+    }
+    n->waiters.fetch_sub(1, std::memory_order_release);
+    return ok;
+}
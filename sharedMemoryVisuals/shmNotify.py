@@ -0,0 +1,80 @@
+# consumer side of the futex notification in the shared segments, mirrors
+# shmNotify.h
+#
+# a waiter registers in the waiters word, re-checks its data and then sleeps
+# in FUTEX_WAIT on the value of seq it saw before registering, so a publish in
+# between is never missed; the producer only wakes anyone while waiters is
+# non-zero. python has no atomic add on shared memory, so waiters is bumped
+# with FUTEX_WAKE_OP, which adds to its second word atomically in the kernel
+# (and wakes nobody here).
+import ctypes
+import mmap
+import os
+import platform
+import time
+
+SYS_FUTEX = {"x86_64": 202, "aarch64": 98, "riscv64": 98, "armv7l": 240, "i686": 240}.get(platform.machine())
+FUTEX_WAIT = 0
+FUTEX_WAKE_OP = 5
+FUTEX_OP_ADD = 1
+FUTEX_OP_CMP_EQ = 0
+
+_libc = ctypes.CDLL(None, use_errno=True)
+_libc.syscall.restype = ctypes.c_long
+
+class Timespec(ctypes.Structure):
+    _fields_ = [("tv_sec", ctypes.c_long), ("tv_nsec", ctypes.c_long)]
+
+class ShmNotifier:
+    """the seq/waiters pair at offset of the shared segment at path"""
+
+    def __init__(self, path, offset):
+        # a small writable mapping of the header only, the data stays read-only
+        self.shm = None
+        self.seq = self.waiters = None
+        if SYS_FUTEX is None:
+            print(f"no futex syscall number for {platform.machine()}, polling {path}")
+            return
+        try:
+            fd = os.open(path, os.O_RDWR)
+        except OSError as e:
+            print(f"cannot open {path} for writing ({e}), polling instead of waiting")
+            return
+        try:
+            self.shm = mmap.mmap(fd, offset + 8, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+        finally:
+            os.close(fd)
+        self.seq = ctypes.c_uint32.from_buffer(self.shm, offset)
+        self.waiters = ctypes.c_uint32.from_buffer(self.shm, offset + 4)
+
+    def _add_waiters(self, n):
+        op = (FUTEX_OP_ADD << 28) | (FUTEX_OP_CMP_EQ << 24) | ((n & 0xfff) << 12)
+        _libc.syscall(ctypes.c_long(SYS_FUTEX), ctypes.byref(self.seq), ctypes.c_int(FUTEX_WAKE_OP), ctypes.c_int(0),
+                      ctypes.c_long(0), ctypes.byref(self.waiters), ctypes.c_int(op))
+
+    def wait(self, ready, timeout_ms):
+        """block until ready() holds, a publish arrives or timeout_ms passes"""
+        if ready():
+            return True
+        if self.seq is None:
+            time.sleep(0.01)
+            return ready()
+        seen = self.seq.value
+        self._add_waiters(1)
+        try:
+            ok = ready()
+            if not ok:
+                ts = Timespec(timeout_ms // 1000, (timeout_ms % 1000) * 1000000)
+                _libc.syscall(ctypes.c_long(SYS_FUTEX), ctypes.byref(self.seq), ctypes.c_int(FUTEX_WAIT),
+                              ctypes.c_uint32(seen), ctypes.byref(ts), None, ctypes.c_int(0))
+                ok = ready()
+        finally:
+            self._add_waiters(-1)
+        return ok
+
+    def close(self):
+        # the ctypes views hold exports on the mapping, drop them first
+        self.seq = self.waiters = None
+        if self.shm is not None:
+            self.shm.close()
+            self.shm = None
@@ -0,0 +1,83 @@
+#pragma once
+// small helpers for fixed-size POSIX shared memory segments, and a seqlock
+// record for publishing a struct that readers copy out without locking
+
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+
+// create (replacing any stale one) and map a zeroed segment of size bytes
+inline void *shmCreate(const char *name, size_t size)
+{
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+    if (fd == -1) {
+        std::cerr << name << ": shm_open failed: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    if (ftruncate(fd, size) == -1) {
+        std::cerr << name << ": ftruncate failed: " << strerror(errno) << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << name << ": mmap failed: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    return base;
+}
+
+// map an existing segment, its size is returned in size
+inline void *shmOpen(const char *name, size_t *size, bool writable = false)
+{
+    int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, 0666);
+    if (fd == -1) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return nullptr;
+    }
+    void *base = mmap(nullptr, st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return nullptr;
+    *size = st.st_size;
+    return base;
+}
+
+// single writer, any number of readers; seq is odd while value is changing
+template <typename T>
+struct SeqlockRecord {
+    std::atomic<uint64_t> seq;
+    T value;
+
+    void store(const T &v)
+    {
+        uint64_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&value, &v, sizeof(T));
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // false if nothing was stored yet or the writer kept interfering
+    bool load(T *out, int attempts = 16) const
+    {
+        for (int i = 0; i < attempts; ++i) {
+            uint64_t s1 = seq.load(std::memory_order_acquire);
+            if (s1 == 0) return false;
+            if (s1 & 1) continue;
+            memcpy(out, &value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s1) return true;
+        }
+        return false;
+    }
+};
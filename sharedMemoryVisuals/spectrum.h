@@ -0,0 +1,250 @@
+#pragma once
+// spectral estimation for the RX stream: radix-2 FFT plans, window tables and
+// a streaming Welch PSD that turns interleaved IQ into fixed-size frames.
+//
+// everything that can be precomputed (twiddles, bit reversal, windows) is
+// built once in the constructors so the per-segment work is just the window
+// multiply, the FFT and the |X|^2 accumulation.
+
+#include <iostream>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "shmSegment.h"
+
+#define PSD_SHM_NAME "/limesuite_psd"
+#define PSD_SHM_MAGIC 0x46445350u // "PSDF"
+#define PSD_SHM_VERSION 1
+
+typedef std::complex<float> cfloat;
+
+// in-place complex FFT of a fixed power-of-two size
+class FftPlan {
+public:
+    explicit FftPlan(size_t size) : size_(size), bitrev_(size), twiddles_(size > 1 ? size - 1 : 1)
+    {
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < size) ++bits;
+        if ((size_t(1) << bits) != size) std::cerr << "FftPlan: size " << size << " is not a power of two" << std::endl;
+        for (size_t i = 0; i < size; ++i) {
+            size_t r = 0;
+            for (unsigned b = 0; b < bits; ++b)
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            bitrev_[i] = uint32_t(r);
+        }
+        // twiddles stored stage after stage so every butterfly pass reads
+        // its table contiguously: stage with half-size h starts at h - 1
+        for (size_t half = 1; half < size; half *= 2)
+            for (size_t k = 0; k < half; ++k)
+                twiddles_[half - 1 + k] = std::polar(1.0, -M_PI * k / half);
+    }
+
+    size_t size() const { return size_; }
+
+    // forward transform
+    void execute(cfloat *data) const
+    {
+        for (size_t i = 0; i < size_; ++i)
+            if (bitrev_[i] > i) std::swap(data[i], data[bitrev_[i]]);
+        for (size_t half = 1; half < size_; half *= 2) {
+            const cfloat *w = &twiddles_[half - 1];
+            for (size_t start = 0; start < size_; start += 2 * half) {
+                cfloat *a = data + start;
+                cfloat *b = a + half;
+                for (size_t k = 0; k < half; ++k) {
+                    cfloat t = mul(b[k], w[k]);
+                    b[k] = a[k] - t;
+                    a[k] = a[k] + t;
+                }
+            }
+        }
+    }
+
+    // unscaled inverse through conj(FFT(conj(x)))
+    void inverse(cfloat *data) const
+    {
+        for (size_t i = 0; i < size_; ++i)
+            data[i] = std::conj(data[i]);
+        execute(data);
+        for (size_t i = 0; i < size_; ++i)
+            data[i] = std::conj(data[i]);
+    }
+
+private:
+    // plain complex multiply, std::complex's operator* adds NaN/inf handling
+    static cfloat mul(cfloat x, cfloat y)
+    {
+        return cfloat(x.real() * y.real() - x.imag() * y.imag(), x.real() * y.imag() + x.imag() * y.real());
+    }
+
+    size_t size_;
+    std::vector<uint32_t> bitrev_;
+    std::vector<cfloat> twiddles_;
+};
+
+enum WindowType {
+    WINDOW_RECT = 0,
+    WINDOW_HANN,
+    WINDOW_BLACKMAN_HARRIS,
+};
+
+inline std::vector<float> makeWindow(WindowType type, size_t n)
+{
+    std::vector<float> w(n, 1.0f);
+    for (size_t i = 0; i < n; ++i) {
+        double x = 2 * M_PI * i / n; // periodic form, as used for spectral analysis
+        if (type == WINDOW_HANN)
+            w[i] = float(0.5 - 0.5 * std::cos(x));
+        else if (type == WINDOW_BLACKMAN_HARRIS)
+            w[i] = float(0.35875 - 0.48829 * std::cos(x) + 0.14128 * std::cos(2 * x) - 0.01168 * std::cos(3 * x));
+    }
+    return w;
+}
+
+// Welch averaging of overlapped, windowed segments
+// frames are PSD in dBFS/Hz, DC in the middle bin (fft-shifted)
+class WelchPsd {
+public:
+    // averages: segments per frame, overlap: fraction of a segment reused
+    WelchPsd(size_t fftSize, size_t averages, double sampleRate, double overlap = 0.5, WindowType window = WINDOW_HANN)
+        : plan_(fftSize), window_(makeWindow(window, fftSize)), averages_(averages), sampleRate_(sampleRate),
+          segment_(fftSize), work_(fftSize), accum_(fftSize, 0.0f), frame_(fftSize, -200.0f)
+    {
+        size_t keep = size_t(overlap * fftSize);
+        hop_ = keep < fftSize ? fftSize - keep : 1;
+        double sumSquares = 0;
+        for (float w : window_)
+            sumSquares += double(w) * w;
+        // density scaling: |X|^2 / (fs * sum(w^2)), averaged over the span
+        scale_ = 1.0 / (sampleRate_ * sumSquares * averages_);
+    }
+
+    // feed interleaved float IQ; returns the number of frames completed
+    int push(const float *iq, size_t pairs)
+    {
+        int frames = 0;
+        size_t n = plan_.size();
+        for (size_t i = 0; i < pairs; ++i) {
+            segment_[fill_++] = cfloat(iq[2 * i], iq[2 * i + 1]);
+            if (fill_ < n) continue;
+            accumulate();
+            // keep the overlapping tail as the start of the next segment
+            memmove(segment_.data(), segment_.data() + hop_, (n - hop_) * sizeof(cfloat));
+            fill_ = n - hop_;
+            if (++segments_ == averages_) {
+                finishFrame();
+                ++frames;
+            }
+        }
+        return frames;
+    }
+
+    // drop the partial segment, e.g. after samples were lost
+    void restartSegment() { fill_ = 0; }
+
+    const std::vector<float> &frame() const { return frame_; }
+    size_t bins() const { return plan_.size(); }
+    double binHz() const { return sampleRate_ / plan_.size(); }
+    uint64_t framesDone() const { return framesDone_; }
+
+private:
+    void accumulate()
+    {
+        size_t n = plan_.size();
+        for (size_t i = 0; i < n; ++i)
+            work_[i] = segment_[i] * window_[i];
+        plan_.execute(work_.data());
+        for (size_t i = 0; i < n; ++i)
+            accum_[i] += std::norm(work_[i]);
+    }
+
+    void finishFrame()
+    {
+        size_t n = plan_.size();
+        for (size_t i = 0; i < n; ++i) {
+            double p = accum_[(i + n / 2) % n] * scale_;
+            frame_[i] = p > 0 ? float(10.0 * std::log10(p)) : -200.0f;
+        }
+        std::fill(accum_.begin(), accum_.end(), 0.0f);
+        segments_ = 0;
+        ++framesDone_;
+    }
+
+    FftPlan plan_;
+    std::vector<float> window_;
+    size_t averages_;
+    double sampleRate_;
+    size_t hop_;
+    double scale_;
+    std::vector<cfloat> segment_;
+    std::vector<cfloat> work_;
+    std::vector<float> accum_;
+    std::vector<float> frame_;
+    size_t fill_ = 0;
+    size_t segments_ = 0;
+    uint64_t framesDone_ = 0;
+};
+
+// layout of PSD_SHM_NAME: this header followed by bins floats.
+// seq is odd while a frame is being written (seqlock)
+struct PsdShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t bins;
+    uint32_t averages;
+    double sampleRate;
+    double binHz;
+    std::atomic<uint64_t> seq;
+    uint64_t frame;        // frames published so far
+    uint64_t timestamp;    // sample timestamp of the block that completed the frame
+};
+
+class PsdPublisher {
+public:
+    ~PsdPublisher() { close(); }
+
+    int create(size_t bins, size_t averages, double sampleRate, const char *name = PSD_SHM_NAME)
+    {
+        size_ = sizeof(PsdShmHeader) + bins * sizeof(float);
+        hdr_ = static_cast<PsdShmHeader *>(shmCreate(name, size_));
+        if (!hdr_) return -1;
+        name_ = name;
+        hdr_->version = PSD_SHM_VERSION;
+        hdr_->bins = bins;
+        hdr_->averages = averages;
+        hdr_->sampleRate = sampleRate;
+        hdr_->binHz = sampleRate / bins;
+        hdr_->magic = PSD_SHM_MAGIC;
+        return 0;
+    }
+
+    void publish(const std::vector<float> &frame, uint64_t timestamp)
+    {
+        if (!hdr_) return;
+        uint64_t s = hdr_->seq.load(std::memory_order_relaxed);
+        hdr_->seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(reinterpret_cast<uint8_t *>(hdr_) + sizeof(PsdShmHeader), frame.data(), hdr_->bins * sizeof(float));
+        hdr_->frame++;
+        hdr_->timestamp = timestamp;
+        hdr_->seq.store(s + 2, std::memory_order_release);
+    }
+
+    void close()
+    {
+        if (hdr_) {
+            munmap(hdr_, size_);
+            shm_unlink(name_.c_str());
+            hdr_ = nullptr;
+        }
+    }
+
+private:
+    PsdShmHeader *hdr_ = nullptr;
+    size_t size_ = 0;
+    std::string name_;
+};
@@ -0,0 +1,91 @@
+// startup time with and without the calibration cache, against a fake device
+// that takes as long to calibrate as a LimeSDR does. runs a cold start (empty
+// cache), a warm start, a start after the chip warmed up into the next
+// temperature bucket, a forced recalibration and a start on another board,
+// and checks each one calibrated or loaded as it should. the cache lives in a
+// fresh directory under parentDir (default /tmp) that is removed at exit.
+//
+// usage: startupBench [calibrateMs] [parentDir]
+
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <dirent.h>
+#include <unistd.h>
+#include "calibrationCache.h"
+#include "fakeCalibrationDevice.h"
+
+struct Step {
+    const char *label;
+    FakeCalibrationDevice *device;
+    double celsius;
+    bool force;
+    CalOutcome expect;
+};
+
+// the cache directory holds only files: the index and the config files
+struct ScratchDir {
+    std::string path;
+
+    ~ScratchDir()
+    {
+        if (path.empty()) return;
+        if (DIR *d = opendir(path.c_str())) {
+            while (dirent *e = readdir(d))
+                if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0)
+                    unlink((path + "/" + e->d_name).c_str());
+            closedir(d);
+        }
+        rmdir(path.c_str());
+    }
+};
+
+int main(int argc, char **argv)
+{
+    unsigned calibrateMs = argc > 1 ? atoi(argv[1]) : 1500;
+    std::string templ = std::string(argc > 2 ? argv[2] : "/tmp") + "/startupBench.XXXXXX";
+    if (!mkdtemp(&templ[0])) {
+        std::cerr << "cannot create " << templ << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    ScratchDir scratch = {templ};
+    const std::string &dir = scratch.path;
+
+    FakeCalibrationDevice board("1d40c4e5c12c3a", 40.0, calibrateMs);
+    FakeCalibrationDevice other("1d40c4e5c1ffff", 40.0, calibrateMs);
+    Step steps[] = {
+        {"cold start", &board, 40.0, false, CAL_MISS},
+        {"warm start", &board, 41.5, false, CAL_HIT},
+        {"warmed up 6 C", &board, 46.0, false, CAL_MISS},
+        {"back to 41 C", &board, 41.0, false, CAL_HIT},
+        {"forced recal", &board, 41.0, true, CAL_MISS},
+        {"other board", &other, 41.0, false, CAL_MISS},
+    };
+
+    int failures = 0;
+    for (const Step &step : steps) {
+        // a fresh cache object each time, as a restarted process would have
+        CalibrationCache cache;
+        if (cache.open(dir) != 0) return 1;
+        cache.setForce(step.force);
+        step.device->setTemperature(step.celsius);
+
+        StartupReport startup;
+        CalKey key;
+        CalOutcome outcome;
+        if (cache.key(*step.device, 2.4e9, 15.36e6, 20, &key) != 0 ||
+            cache.apply(*step.device, key, 15.36e6, &outcome) != 0) {
+            std::cerr << step.label << ": " << step.device->lastError() << std::endl;
+            return 1;
+        }
+        startup.mark(calOutcomeName(outcome));
+        bool ok = outcome == step.expect;
+        failures += !ok;
+        std::cout << step.label << " (" << cache.size() << " cached" << (ok ? "" : ", UNEXPECTED") << ") ";
+        startup.report(std::cout);
+    }
+    std::cout << (failures ? "FAILED" : "all starts as expected") << std::endl;
+    return failures ? 1 : 0;
+}
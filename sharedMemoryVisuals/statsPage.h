@@ -0,0 +1,184 @@
+#pragma once
+// lock-free telemetry exported through a small shared memory page
+//
+// every metric is owned by one thread (the capture thread or a stage worker)
+// and holds event/item/drop counters plus an HDR-style latency histogram:
+// 8 linear sub-buckets per power of two of nanoseconds, so any recorded
+// value lands in a bucket no more than 12.5% wide from 1 ns up to ~18 min.
+// the owner updates with relaxed load+store (no locked instructions on the
+// hot path), viewers copy the counters out whenever they like. the latest
+// stream status sits next to them in a seqlock record.
+//
+// layout of STATS_SHM_NAME: [StatsPageHeader][StatsMetric 0]...[StatsMetric N-1]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "rxSource.h"
+#include "shmSegment.h"
+
+#define STATS_SHM_NAME "/limesuite_stats"
+#define STATS_SHM_MAGIC 0x54415453u // "STAT"
+#define STATS_SHM_VERSION 1
+#define STATS_MAX_METRICS 32
+#define STATS_NAME_SIZE 32
+#define STATS_SUB_BUCKET_BITS 3
+#define STATS_BUCKETS 304           // covers 2^40 ns with 8 sub-buckets per octave
+
+inline uint64_t statsNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// value -> bucket: exact below 8, then (octave, top 3 bits below the msb)
+inline uint32_t statsBucket(uint64_t ns)
+{
+    const uint32_t sub = 1u << STATS_SUB_BUCKET_BITS;
+    if (ns < sub) return uint32_t(ns);
+    uint32_t e = 63 - __builtin_clzll(ns);
+    uint32_t idx = (e - STATS_SUB_BUCKET_BITS + 1) * sub + uint32_t((ns >> (e - STATS_SUB_BUCKET_BITS)) & (sub - 1));
+    return idx < STATS_BUCKETS ? idx : STATS_BUCKETS - 1;
+}
+
+// smallest value that falls in bucket idx
+inline uint64_t statsBucketFloor(uint32_t idx)
+{
+    const uint32_t sub = 1u << STATS_SUB_BUCKET_BITS;
+    if (idx < sub) return idx;
+    uint32_t e = idx / sub + STATS_SUB_BUCKET_BITS - 1;
+    return uint64_t(sub + idx % sub) << (e - STATS_SUB_BUCKET_BITS);
+}
+
+// stream health sampled off the hot path
+struct StatsStreamSample {
+    uint64_t sampledNs;
+    RxStatus status;
+};
+
+struct StatsPageHeader {
+    std::atomic<uint32_t> magic;     // written last by the creator
+    uint32_t version;
+    uint32_t metricSize;             // sizeof(StatsMetric)
+    uint32_t buckets;                // STATS_BUCKETS
+    uint32_t subBucketBits;          // STATS_SUB_BUCKET_BITS
+    std::atomic<uint32_t> metricCount; // metrics registered so far
+    uint64_t startNs;                // steady clock at creation
+    SeqlockRecord<StatsStreamSample> stream;
+};
+
+struct StatsMetric {
+    char name[STATS_NAME_SIZE];
+    std::atomic<uint64_t> events;    // calls or blocks
+    std::atomic<uint64_t> items;     // IQ samples through
+    std::atomic<uint64_t> drops;     // blocks lost, short reads, errors
+    std::atomic<uint64_t> latencySum; // ns
+    std::atomic<uint64_t> latencyMax; // ns
+    std::atomic<uint64_t> buckets[STATS_BUCKETS];
+
+    // single writer: relaxed load+store instead of a locked add
+    static void bump(std::atomic<uint64_t> &c, uint64_t n)
+    {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void record(uint64_t ns, uint64_t itemCount = 0)
+    {
+        bump(events, 1);
+        if (itemCount) bump(items, itemCount);
+        bump(latencySum, ns);
+        if (ns > latencyMax.load(std::memory_order_relaxed)) latencyMax.store(ns, std::memory_order_relaxed);
+        bump(buckets[statsBucket(ns)], 1);
+    }
+
+    void drop(uint64_t n = 1) { bump(drops, n); }
+};
+
+// lower edge of the bucket holding the p-th fraction of the recorded values
+inline uint64_t statsPercentile(const StatsMetric &m, double p)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < STATS_BUCKETS; ++i)
+        total += m.buckets[i].load(std::memory_order_relaxed);
+    if (!total) return 0;
+    uint64_t target = uint64_t(p * total), seen = 0;
+    for (uint32_t i = 0; i < STATS_BUCKETS; ++i) {
+        seen += m.buckets[i].load(std::memory_order_relaxed);
+        if (seen > target || seen == total) return statsBucketFloor(i);
+    }
+    return 0;
+}
+
+// times a scope into a metric; a null metric costs one branch
+class StatsTimer {
+public:
+    explicit StatsTimer(StatsMetric *m, uint64_t items = 0) : m_(m), items_(items), t0_(m ? statsNowNs() : 0) {}
+    ~StatsTimer() { if (m_) m_->record(statsNowNs() - t0_, items_); }
+    void setItems(uint64_t items) { items_ = items; }
+
+private:
+    StatsMetric *m_;
+    uint64_t items_;
+    uint64_t t0_;
+};
+
+class StatsPage {
+public:
+    ~StatsPage() { close(); }
+
+    int create(const char *name = STATS_SHM_NAME)
+    {
+        size_ = sizeof(StatsPageHeader) + STATS_MAX_METRICS * sizeof(StatsMetric);
+        base_ = static_cast<uint8_t *>(shmCreate(name, size_));
+        if (!base_) return -1;
+        name_ = name;
+        hdr_ = reinterpret_cast<StatsPageHeader *>(base_);
+        hdr_->version = STATS_SHM_VERSION;
+        hdr_->metricSize = sizeof(StatsMetric);
+        hdr_->buckets = STATS_BUCKETS;
+        hdr_->subBucketBits = STATS_SUB_BUCKET_BITS;
+        hdr_->startNs = statsNowNs();
+        hdr_->magic.store(STATS_SHM_MAGIC, std::memory_order_release);
+        return 0;
+    }
+
+    // register a metric before its owner thread starts; nullptr when full
+    StatsMetric *addMetric(const std::string &name)
+    {
+        if (!hdr_) return nullptr;
+        uint32_t n = hdr_->metricCount.load(std::memory_order_relaxed);
+        if (n == STATS_MAX_METRICS) return nullptr;
+        StatsMetric *m = metric(n);
+        strncpy(m->name, name.c_str(), STATS_NAME_SIZE - 1);
+        hdr_->metricCount.store(n + 1, std::memory_order_release);
+        return m;
+    }
+
+    void publishStream(const RxStatus &status)
+    {
+        if (hdr_) hdr_->stream.store({statsNowNs(), status});
+    }
+
+    StatsMetric *metric(uint32_t i) const
+    {
+        return reinterpret_cast<StatsMetric *>(base_ + sizeof(StatsPageHeader) + i * sizeof(StatsMetric));
+    }
+
+    void close()
+    {
+        if (base_) {
+            munmap(base_, size_);
+            shm_unlink(name_.c_str());
+            base_ = nullptr;
+            hdr_ = nullptr;
+        }
+    }
+
+private:
+    uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    StatsPageHeader *hdr_ = nullptr;
+    std::string name_;
+};
@@ -0,0 +1,138 @@
+import mmap
+import ctypes
+import os
+import sys
+import time
+
+# Shared memory name
+shm_name = "/dev/shm/limesuite_stats"
+
+# layout, mirrors statsPage.h
+STATS_SHM_MAGIC = 0x54415453
+STATS_SHM_VERSION = 1
+STATS_MAX_METRICS = 32
+STATS_NAME_SIZE = 32
+STATS_BUCKETS = 304
+
+class RxStatus(ctypes.Structure):
+    _fields_ = [
+        ("fifoFilledCount", ctypes.c_uint32),
+        ("fifoSize", ctypes.c_uint32),
+        ("underrun", ctypes.c_uint32),
+        ("overrun", ctypes.c_uint32),
+        ("droppedPackets", ctypes.c_uint32),
+        ("linkRate", ctypes.c_double),
+    ]
+
+class StatsPageHeader(ctypes.Structure):
+    _fields_ = [
+        ("magic", ctypes.c_uint32),
+        ("version", ctypes.c_uint32),
+        ("metricSize", ctypes.c_uint32),
+        ("buckets", ctypes.c_uint32),
+        ("subBucketBits", ctypes.c_uint32),
+        ("metricCount", ctypes.c_uint32),
+        ("startNs", ctypes.c_uint64),
+        ("streamSeq", ctypes.c_uint64),
+        ("sampledNs", ctypes.c_uint64),
+        ("status", RxStatus),
+    ]
+
+class StatsMetric(ctypes.Structure):
+    _fields_ = [
+        ("name", ctypes.c_char * STATS_NAME_SIZE),
+        ("events", ctypes.c_uint64),
+        ("items", ctypes.c_uint64),
+        ("drops", ctypes.c_uint64),
+        ("latencySum", ctypes.c_uint64),
+        ("latencyMax", ctypes.c_uint64),
+        ("buckets", ctypes.c_uint64 * STATS_BUCKETS),
+    ]
+
+def bucket_floor(idx, sub_bits):
+    """smallest latency in ns that lands in bucket idx, as statsBucketFloor()"""
+    sub = 1 << sub_bits
+    if idx < sub:
+        return idx
+    e = idx // sub + sub_bits - 1
+    return (sub + idx % sub) << (e - sub_bits)
+
+def percentile(counts, total, p, sub_bits):
+    if total == 0:
+        return 0
+    target = p * total
+    seen = 0
+    for idx, n in enumerate(counts):
+        seen += n
+        if seen >= target:
+            return bucket_floor(idx, sub_bits)
+    return bucket_floor(len(counts) - 1, sub_bits)
+
+def read_status(shm):
+    """seqlock read of the stream status, None while the writer is mid-update"""
+    for _ in range(16):
+        snapshot = StatsPageHeader.from_buffer_copy(shm, 0)
+        if snapshot.streamSeq == 0 or snapshot.streamSeq & 1:
+            continue
+        if StatsPageHeader.from_buffer_copy(shm, 0).streamSeq == snapshot.streamSeq:
+            return snapshot.status
+    return None
+
+def fmt_ns(ns):
+    if ns >= 1000000:
+        return f"{ns / 1e6:7.2f}ms"
+    if ns >= 1000:
+        return f"{ns / 1e3:7.2f}us"
+    return f"{ns:7d}ns"
+
+# Open shared memory with retry
+shm_fd = None
+while shm_fd is None:
+    try:
+        shm_fd = os.open(shm_name, os.O_RDONLY)
+    except FileNotFoundError:
+        print(f"Waiting for shared memory {shm_name} to be created...")
+        time.sleep(0.5)  # Wait 500ms before retrying
+
+size = os.fstat(shm_fd).st_size
+shm = mmap.mmap(shm_fd, size, mmap.MAP_SHARED, mmap.PROT_READ)
+header = StatsPageHeader.from_buffer_copy(shm, 0)
+if header.magic != STATS_SHM_MAGIC or header.version != STATS_SHM_VERSION or header.metricSize != ctypes.sizeof(StatsMetric):
+    raise SystemExit(f"{shm_name} is not a version {STATS_SHM_VERSION} stats page")
+sub_bits = header.subBucketBits
+interval = float(sys.argv[1]) if len(sys.argv) > 1 else 1.0
+
+# counters are cumulative: rates and percentiles cover the last interval
+previous = {}
+try:
+    while True:
+        count = StatsPageHeader.from_buffer_copy(shm, 0).metricCount
+        lines = []
+        for i in range(min(count, STATS_MAX_METRICS)):
+            m = StatsMetric.from_buffer_copy(shm, ctypes.sizeof(StatsPageHeader) + i * header.metricSize)
+            name = m.name.decode("utf-8").rstrip(chr(0))
+            counts = list(m.buckets)
+            last = previous.get(name)
+            if last is None:
+                delta_counts, events, items, drops = counts, m.events, m.items, m.drops
+            else:
+                delta_counts = [a - b for a, b in zip(counts, last.buckets)]
+                events, items, drops = m.events - last.events, m.items - last.items, m.drops - last.drops
+            previous[name] = m
+            total = sum(delta_counts)
+            mean = m.latencySum // m.events if m.events else 0
+            lines.append(f"{name:16s} {events / interval:9.0f}/s {items / interval / 1e6:8.2f} MS/s "
+                         f"drops {drops:6d}  p50 {fmt_ns(percentile(delta_counts, total, 0.5, sub_bits))} "
+                         f"p99 {fmt_ns(percentile(delta_counts, total, 0.99, sub_bits))} "
+                         f"mean {fmt_ns(mean)} max {fmt_ns(m.latencyMax)}")
+        status = read_status(shm)
+        if status is not None:
+            lines.append(f"stream fifo {status.fifoFilledCount}/{status.fifoSize}  underrun {status.underrun}  "
+                         f"overrun {status.overrun}  dropped {status.droppedPackets}  link {status.linkRate / 1e6:.1f} MB/s")
+        print("\n".join(lines) + "\n", flush=True)
+        time.sleep(interval)
+except KeyboardInterrupt:
+    print("Stopping viewer...")
+finally:
+    shm.close()
+    os.close(shm_fd)
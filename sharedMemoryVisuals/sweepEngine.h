@@ -0,0 +1,248 @@
+#pragma once
+// stepped-frequency sweep: retune the LO through a list of points while the
+// RX stream stays up, keep dwellSamples of settled samples per point and hand
+// them, tagged with the point index, to a processing thread
+//
+// the capture thread owns both the stream and the tuner. once a point has its
+// samples it retunes straight away and goes back to draining the stream, so
+// tuning point N+1 overlaps the processing of point N. the LO switch lands
+// somewhere in samples that are not received yet: everything up to the
+// received timestamp plus the FIFO fill reported after tune() returns is
+// treated as old LO, and settleSamples after that as PLL settling; both are
+// discarded by timestamp. blocks reach the processing thread through a
+// preallocated SPSC queue; if processing falls that far behind, blocks are
+// dropped and counted instead of stalling capture.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "asyncLog.h"
+#include "iqRing.h"
+#include "rxSource.h"
+#include "shmNotify.h"
+#include "tuner.h"
+
+#define SWEEP_QUEUE_BLOCKS 64            // power of two
+
+struct SweepPoint {
+    double hz;
+    uint32_t dwellSamples;               // settled samples kept at this frequency
+};
+
+// tag carried by every block handed to the processor
+struct SweepBlock {
+    uint64_t sweep;                      // pass over the point list
+    uint32_t point;                      // index into the point list
+    uint32_t count;
+    uint64_t timestamp;                  // RX timestamp of the first sample
+    bool last;                           // final block of this point's dwell
+};
+
+typedef std::function<void(const void *samples, const SweepBlock &block)> SweepFn;
+
+struct SweepStats {
+    std::atomic<uint64_t> points{0};     // dwells completed
+    std::atomic<uint64_t> sweeps{0};
+    std::atomic<uint64_t> discarded{0};  // samples before the switch or settling
+    std::atomic<uint64_t> dropped{0};    // blocks the processing thread had no room for
+    std::atomic<uint64_t> tunes{0};
+    std::atomic<uint64_t> tuneNs{0};     // time spent in tune()
+    std::atomic<uint64_t> tuneNsMax{0};
+};
+
+class SweepEngine {
+public:
+    SweepEngine(RxSource *source, Tuner *tuner, double sampleRate, IqSampleFormat fmt, uint32_t blockSamples = 1024)
+        : source_(source), tuner_(tuner), sampleRate_(sampleRate), bytesPerSample_(iqBytesPerSample(fmt)),
+          blockSamples_(blockSamples)
+    {
+    }
+    ~SweepEngine() { stop(); }
+
+    void setPoints(const std::vector<SweepPoint> &points) { points_ = points; }
+    void setSettleSamples(uint32_t samples) { settle_ = samples; }
+    void setProcessor(SweepFn fn) { process_ = fn; }
+
+    int start()
+    {
+        if (points_.empty()) {
+            error_ = "no sweep points";
+            return -1;
+        }
+        for (auto &slot : slots_)
+            slot.samples.resize(size_t(blockSamples_) * bytesPerSample_);
+        publisher_.attach(&notifier_);
+        running_ = true;
+        startTime_ = std::chrono::steady_clock::now();
+        worker_ = std::thread([this] { processLoop(); });
+        capture_ = std::thread([this] { captureLoop(); });
+        return 0;
+    }
+
+    void stop()
+    {
+        running_ = false;
+        if (capture_.joinable()) capture_.join();
+        if (notifier_.waiters.load()) publisher_.flush();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    bool running() const { return running_; }
+    const std::string &error() const { return error_; }
+    const SweepStats &stats() const { return stats_; }
+
+    double pointsPerSecond() const
+    {
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime_).count();
+        return s > 0 ? stats_.points.load() / s : 0;
+    }
+
+    void report(std::ostream &os) const
+    {
+        uint64_t tunes = stats_.tunes.load();
+        os << "sweep: " << stats_.sweeps.load() << " sweeps, " << stats_.points.load() << " points, "
+           << pointsPerSecond() << " points/s, tune mean " << (tunes ? stats_.tuneNs.load() / tunes / 1e3 : 0)
+           << " us max " << stats_.tuneNsMax.load() / 1e3 << " us, discarded "
+           << stats_.discarded.load() / sampleRate_ * 1e3 << " ms of samples, dropped " << stats_.dropped.load()
+           << " blocks\n";
+    }
+
+private:
+    struct Slot {
+        SweepBlock tag;
+        std::vector<uint8_t> samples;
+    };
+
+    // everything received before this timestamp predates the switch or is settling
+    uint64_t settledFrom(uint64_t receivedEnd)
+    {
+        RxStatus status;
+        uint64_t buffered = source_->status(&status) == 0 ? status.fifoFilledCount : 0;
+        return receivedEnd + buffered + settle_;
+    }
+
+    int tune(uint32_t point)
+    {
+        uint64_t t0 = logNowNs();
+        int ret = tuner_->tune(points_[point].hz);
+        uint64_t ns = logNowNs() - t0;
+        stats_.tunes.fetch_add(1, std::memory_order_relaxed);
+        stats_.tuneNs.fetch_add(ns, std::memory_order_relaxed);
+        if (ns > stats_.tuneNsMax.load(std::memory_order_relaxed)) stats_.tuneNsMax.store(ns, std::memory_order_relaxed);
+        return ret;
+    }
+
+    void push(const uint8_t *samples, const SweepBlock &tag)
+    {
+        uint64_t h = head_.load(std::memory_order_relaxed);
+        if (h - tail_.load(std::memory_order_acquire) == SWEEP_QUEUE_BLOCKS) {
+            stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+            ALOG_RATE(LOG_WARN, 1, "sweep: processing behind, dropped block of point {}", tag.point);
+            return;
+        }
+        Slot &slot = slots_[h & (SWEEP_QUEUE_BLOCKS - 1)];
+        slot.tag = tag;
+        memcpy(slot.samples.data(), samples, size_t(tag.count) * bytesPerSample_);
+        head_.store(h + 1, std::memory_order_release);
+        publisher_.notify();
+    }
+
+    void captureLoop()
+    {
+        logAttachThread();
+        std::vector<uint8_t> block(size_t(blockSamples_) * bytesPerSample_);
+        RxMeta meta;
+        uint32_t point = 0;
+        uint64_t sweep = 0, collected = 0, validFrom = 0, receivedEnd = 0;
+        bool placed = false;             // validFrom known for the current point
+        if (tune(point) != 0) {
+            error_ = tuner_->lastError();
+            running_ = false;
+            return;
+        }
+        while (running_) {
+            int received = source_->recv(block.data(), blockSamples_, &meta, 1000);
+            if (received < 0) {
+                error_ = source_->lastError();
+                running_ = false;
+                break;
+            }
+            uint64_t t0 = meta.timestamp, end = t0 + received;
+            // first tune happened before any sample: settle from the first one
+            if (!placed) {
+                validFrom = receivedEnd ? settledFrom(receivedEnd) : t0 + settle_;
+                placed = true;
+            }
+            receivedEnd = end;
+            uint64_t from = std::max(t0, validFrom);
+            if (from >= end) {
+                stats_.discarded.fetch_add(received, std::memory_order_relaxed);
+                continue;
+            }
+            stats_.discarded.fetch_add(from - t0, std::memory_order_relaxed);
+            uint32_t dwell = points_[point].dwellSamples;
+            uint32_t take = uint32_t(std::min<uint64_t>(end - from, dwell - collected));
+            collected += take;
+            SweepBlock tag = {sweep, point, take, from, collected == dwell};
+            push(block.data() + (from - t0) * bytesPerSample_, tag);
+            if (collected < dwell) continue;
+
+            // point done: retune now, processing of it carries on meanwhile
+            stats_.discarded.fetch_add(end - from - take, std::memory_order_relaxed);
+            stats_.points.fetch_add(1, std::memory_order_relaxed);
+            collected = 0;
+            if (++point == points_.size()) {
+                point = 0;
+                sweep++;
+                stats_.sweeps.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (tune(point) != 0) {
+                error_ = tuner_->lastError();
+                running_ = false;
+                break;
+            }
+            validFrom = settledFrom(receivedEnd);
+        }
+    }
+
+    void processLoop()
+    {
+        for (;;) {
+            uint64_t t = tail_.load(std::memory_order_relaxed);
+            auto ready = [&] { return head_.load(std::memory_order_acquire) != t; };
+            if (!notifyWait(&notifier_, ready, 100)) {
+                if (!running_) break;
+                continue;
+            }
+            Slot &slot = slots_[t & (SWEEP_QUEUE_BLOCKS - 1)];
+            if (process_) process_(slot.samples.data(), slot.tag);
+            tail_.store(t + 1, std::memory_order_release);
+        }
+    }
+
+    RxSource *source_;
+    Tuner *tuner_;
+    double sampleRate_;
+    uint32_t bytesPerSample_;
+    uint32_t blockSamples_;
+    uint32_t settle_ = 0;
+    std::vector<SweepPoint> points_;
+    SweepFn process_;
+    SweepStats stats_;
+    Slot slots_[SWEEP_QUEUE_BLOCKS];
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    ShmNotifier notifier_{};             // in-process here, same futex protocol
+    NotifyPublisher publisher_;
+    std::atomic<bool> running_{false};
+    std::string error_;
+    std::chrono::steady_clock::time_point startTime_;
+    std::thread capture_;
+    std::thread worker_;
+};
@@ -0,0 +1,141 @@
+#pragma once
+// device-free stand-in for a retunable receiver, to exercise the sweep engine
+//
+// the RX side is paced on the wall clock like SyntheticRxSource and returns
+// a tone plus noise whose amplitude follows a resonance around resonanceHz,
+// evaluated at the current LO. tune() costs tuneUs of host time (the USB
+// control transfers of LMS_SetLOFrequency) and then switches the LO at the
+// sample the wall clock has reached; for settleSamples after that the output
+// is junk, as while the PLL locks. status() reports the samples captured but
+// not yet received as the FIFO fill, so callers can place the switch the same
+// way they would on hardware.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "iqRing.h"
+#include "rxSource.h"
+#include "tuner.h"
+#include "waveform.h"
+
+class SweepSimulator {
+public:
+    SweepSimulator(double sampleRate, double toneHz, IqSampleFormat fmt, uint32_t tuneUs = 300,
+                   uint32_t settleSamples = 2048, double resonanceHz = 2.45e9, double resonanceBw = 40e6)
+        : rx(this), tuner(this), sampleRate_(sampleRate), fmt_(fmt), tuneUs_(tuneUs), settle_(settleSamples),
+          resonanceHz_(resonanceHz), resonanceBw_(resonanceBw), tone_(toneHz, sampleRate), noise_(1 << 16)
+    {
+        // noise is cycled from a table so the simulation keeps up with real time
+        std::mt19937 rng(1);
+        std::normal_distribution<float> gauss(0.0f, 0.01f);
+        for (auto &n : noise_)
+            n = {gauss(rng), gauss(rng)};
+    }
+
+    // amplitude of the simulated tissue response at an LO frequency
+    float response(double hz) const
+    {
+        double x = (hz - resonanceHz_) / resonanceBw_;
+        return float(0.05 + 0.45 / (1 + x * x));
+    }
+
+    class Rx : public RxSource {
+    public:
+        explicit Rx(SweepSimulator *sim) : sim_(sim) {}
+        int recv(void *samples, size_t count, RxMeta *meta, unsigned) override { return sim_->recv(samples, count, meta); }
+        int status(RxStatus *status) override { return sim_->status(status); }
+
+    private:
+        SweepSimulator *sim_;
+    };
+
+    class Tune : public Tuner {
+    public:
+        explicit Tune(SweepSimulator *sim) : sim_(sim) {}
+        int tune(double hz) override { return sim_->tune(hz); }
+
+    private:
+        SweepSimulator *sim_;
+    };
+
+    Rx rx;
+    Tune tuner;
+
+private:
+    uint64_t wallSamples()
+    {
+        return uint64_t(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count() * sampleRate_);
+    }
+
+    int recv(void *samples, size_t count, RxMeta *meta)
+    {
+        if (timestamp_ == 0) start_ = std::chrono::steady_clock::now();
+        auto due = start_ + std::chrono::duration<double>((timestamp_ + count) / sampleRate_);
+        std::this_thread::sleep_until(std::chrono::time_point_cast<std::chrono::steady_clock::duration>(due));
+        if (meta) meta->timestamp = timestamp_;
+        if (block_.size() < count) block_.resize(count);
+        tone_.generate(block_.data(), count);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // old LO, PLL settling, new LO
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t t = timestamp_ + i;
+                float gain = t < switchAt_ ? response(oldLo_) : t < switchAt_ + settle_ ? 0 : response(lo_);
+                block_[i] = gain * block_[i] + noise_[t & (noise_.size() - 1)];
+                if (t >= switchAt_ && t < switchAt_ + settle_) block_[i] += std::polar(0.3f, float(t % 977));
+            }
+        }
+        if (fmt_ == IQ_FMT_F32) {
+            std::copy(block_.begin(), block_.begin() + count, static_cast<std::complex<float> *>(samples));
+        } else {
+            int16_t *out = static_cast<int16_t *>(samples);
+            for (size_t i = 0; i < count; ++i) {
+                out[2 * i] = int16_t(std::max(-2048.0f, std::min(2047.0f, std::round(block_[i].real() * 2048.0f))));
+                out[2 * i + 1] = int16_t(std::max(-2048.0f, std::min(2047.0f, std::round(block_[i].imag() * 2048.0f))));
+            }
+        }
+        timestamp_ += count;
+        return int(count);
+    }
+
+    int status(RxStatus *status)
+    {
+        *status = {};
+        uint64_t wall = timestamp_ ? wallSamples() : 0;
+        status->fifoFilledCount = uint32_t(wall > timestamp_ ? wall - timestamp_ : 0);
+        status->fifoSize = 1 << 20;
+        return 0;
+    }
+
+    int tune(double hz)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(tuneUs_));
+        std::lock_guard<std::mutex> lock(mutex_);
+        oldLo_ = lo_;
+        lo_ = hz;
+        switchAt_ = timestamp_ ? wallSamples() : 0;
+        return 0;
+    }
+
+    double sampleRate_;
+    IqSampleFormat fmt_;
+    uint32_t tuneUs_;
+    uint32_t settle_;
+    double resonanceHz_;
+    double resonanceBw_;
+    Nco tone_;                           // RX thread only
+    std::vector<std::complex<float>> block_;
+    std::vector<std::complex<float>> noise_;
+    std::mutex mutex_;                   // LO state, between the tuning and RX threads
+    double lo_ = 2.4e9;
+    double oldLo_ = 2.4e9;
+    uint64_t switchAt_ = 0;
+    std::atomic<uint64_t> timestamp_{0};
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,103 @@
+#pragma once
+// device-free RxSource producing a tone plus noise, as floats or as
+// 12-bit integers like LMS_FMT_I12
+//
+// the waveform is precomputed into a table that the receive call copies out
+// of, the same way LMS_RecvStream copies out of the driver FIFO, so relay
+// benchmarks see the memory traffic a real stream would cause.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "iqRing.h"
+#include "rxSource.h"
+
+class SyntheticRxSource : public RxSource {
+public:
+    // toneHz is rounded so the table wraps without a phase jump
+    // paced=false returns samples as fast as they can be copied
+    SyntheticRxSource(double sampleRate, double toneHz, float amplitude = 0.5f, float noise = 0.01f,
+                      bool paced = false, size_t tableSamples = 1 << 16, IqSampleFormat fmt = IQ_FMT_F32)
+        : sampleRate_(sampleRate), paced_(paced), bytesPerSample_(iqBytesPerSample(fmt)),
+          tableSamples_(tableSamples), table_(tableSamples * bytesPerSample_)
+    {
+        double cycles = std::round(toneHz / sampleRate * tableSamples);
+        toneHz_ = cycles * sampleRate / tableSamples;
+        std::mt19937 rng(1);
+        std::normal_distribution<float> gauss(0.0f, noise);
+        float *f32 = reinterpret_cast<float *>(table_.data());
+        int16_t *i16 = reinterpret_cast<int16_t *>(table_.data());
+        for (size_t i = 0; i < tableSamples; ++i) {
+            double phase = 2 * M_PI * cycles * i / tableSamples;
+            float re = amplitude * std::cos(phase) + gauss(rng);
+            float im = amplitude * std::sin(phase) + gauss(rng);
+            if (fmt == IQ_FMT_I16) {
+                i16[2 * i] = toI12(re);
+                i16[2 * i + 1] = toI12(im);
+            } else {
+                f32[2 * i] = re;
+                f32[2 * i + 1] = im;
+            }
+        }
+    }
+
+    // lose samples in front of every calls-th block, as dropped packets would
+    void setDropEvery(uint32_t calls, uint32_t samples)
+    {
+        dropEvery_ = calls;
+        dropSamples_ = samples;
+    }
+
+    int recv(void *samples, size_t count, RxMeta *meta, unsigned) override
+    {
+        if (dropEvery_ && ++calls_ % dropEvery_ == 0) {
+            timestamp_ += dropSamples_;
+            pos_ = (pos_ + dropSamples_) % tableSamples_;
+        }
+        if (paced_) pace(count);
+        if (meta) meta->timestamp = timestamp_;
+        uint8_t *out = static_cast<uint8_t *>(samples);
+        size_t done = 0;
+        while (done < count) {
+            size_t n = std::min(count - done, tableSamples_ - pos_);
+            memcpy(out + done * bytesPerSample_, &table_[pos_ * bytesPerSample_], n * bytesPerSample_);
+            done += n;
+            pos_ = (pos_ + n) % tableSamples_;
+        }
+        timestamp_ += count;
+        return int(count);
+    }
+
+    double toneHz() const { return toneHz_; }
+
+private:
+    static int16_t toI12(float v)
+    {
+        return int16_t(std::max(-2048.0f, std::min(2047.0f, std::round(v * 2048.0f))));
+    }
+
+    // block until the wall clock has caught up with the samples handed out
+    void pace(size_t count)
+    {
+        if (timestamp_ == 0) start_ = std::chrono::steady_clock::now();
+        auto due = start_ + std::chrono::duration<double>((timestamp_ + count) / sampleRate_);
+        std::this_thread::sleep_until(std::chrono::time_point_cast<std::chrono::steady_clock::duration>(due));
+    }
+
+    double sampleRate_;
+    double toneHz_;
+    bool paced_;
+    size_t bytesPerSample_;
+    size_t tableSamples_;
+    std::vector<uint8_t> table_;
+    size_t pos_ = 0;
+    uint64_t timestamp_ = 0;
+    uint32_t dropEvery_ = 0;
+    uint32_t dropSamples_ = 0;
+    uint64_t calls_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,34 @@
+#pragma once
+// pin the calling thread to one CPU, so capture threads of separate streams
+// stop migrating onto each other's cores
+
+#include <iostream>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+inline int onlineCpus()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? int(n) : 1;
+}
+
+// a cpu outside the online CPUs is refused, callers sharing fewer cores
+// between more threads pick the core themselves
+inline int pinThisThread(int cpu)
+{
+    if (cpu < 0 || cpu >= onlineCpus() || cpu >= CPU_SETSIZE) {
+        std::cerr << "pinThisThread: cpu " << cpu << " out of range, " << onlineCpus() << " online" << std::endl;
+        return -1;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        std::cerr << "pinThisThread: cpu " << cpu << ": " << strerror(err) << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+// LO retuning abstraction for the sweep engine, so it can run against a
+// LimeSDR or a simulated device
+
+class Tuner {
+public:
+    virtual ~Tuner() {}
+    // move the LO to hz while the stream keeps running, -1 on error
+    virtual int tune(double hz) = 0;
+    virtual const char *lastError() const { return ""; }
+};
@@ -0,0 +1,24 @@
+#pragma once
+// transmit-side counterpart of RxSource, so the duplex engine can drive a
+// LimeSDR TX stream or a simulated loopback
+
+#include <cstddef>
+#include <cstdint>
+
+// subset of lms_stream_meta_t the transmit path needs
+struct TxMeta {
+    uint64_t timestamp;              // RX sample counter the first sample goes out at
+    bool waitForTimestamp;           // hold the burst until timestamp (else send now)
+    bool endOfBurst;                 // flush the partial packet after the last sample
+};
+
+class TxSink {
+public:
+    virtual ~TxSink() {}
+    // same contract as LMS_SendStream: queue up to count IQ pairs, return the
+    // number accepted or -1 on error
+    virtual int send(const void *samples, size_t count, const TxMeta *meta, unsigned timeoutMs) = 0;
+    // bursts the sink discarded because their timestamp had already passed
+    virtual uint64_t late() const { return 0; }
+    virtual const char *lastError() const { return ""; }
+};
@@ -0,0 +1,207 @@
+#pragma once
+// phase-accumulator NCO and a waveform generator for continuous TX streaming
+//
+// the NCO keeps a 32-bit phase accumulator (fs / 2^32 frequency steps, exact
+// wraparound, so phase is continuous across buffers by construction) and a
+// Q32.32 frequency word that can ramp by a fixed amount per sample for
+// linear chirps. samples come from a 4096-entry complex table indexed by the
+// top 12 phase bits; the remaining 20 bits give a first-order correction,
+// e^{j(a+d)} ~ e^{ja} (1 + jd), which keeps the error around -118 dB of the
+// amplitude for the cost of one complex multiply and no sin/cos per sample.
+//
+// WaveformGenerator builds tones, multitone sums, repeating linear chirps and
+// stepped-frequency patterns out of NCOs and fills caller buffers or its own
+// preallocated one. nothing allocates once a waveform is set up.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#define NCO_TABLE_BITS 12
+#define NCO_TABLE_SIZE (1u << NCO_TABLE_BITS)
+
+// e^{j 2 pi k / NCO_TABLE_SIZE}, built once
+inline const std::complex<float> *ncoTable()
+{
+    static const std::vector<std::complex<float>> table = [] {
+        std::vector<std::complex<float>> t(NCO_TABLE_SIZE);
+        for (uint32_t k = 0; k < NCO_TABLE_SIZE; ++k)
+            t[k] = std::polar(1.0f, float(2 * M_PI * k / NCO_TABLE_SIZE));
+        return t;
+    }();
+    return table.data();
+}
+
+class Nco {
+public:
+    Nco(double freqHz = 0, double sampleRate = 1, float amplitude = 1.0f, double phaseRad = 0)
+        : sampleRate_(sampleRate), amplitude_(amplitude), table_(ncoTable())
+    {
+        setFrequency(freqHz);
+        setPhase(phaseRad);
+    }
+
+    // takes effect on the next sample, the phase carries on from where it is
+    void setFrequency(double hz)
+    {
+        double cycles = std::remainder(hz / sampleRate_, 1.0);
+        freq_ = uint64_t(std::llround(cycles * 4294967296.0)) << 32;
+    }
+    void setPhase(double rad) { phase_ = uint32_t(int64_t(std::llround(rad / (2 * M_PI) * 4294967296.0))); }
+    // frequency ramp for linear chirps, 0 for a fixed tone
+    void setSweepRate(double hzPerSecond)
+    {
+        sweep_ = uint64_t(std::llround(hzPerSecond / (sampleRate_ * sampleRate_) * 4294967296.0 * 4294967296.0));
+    }
+    void setAmplitude(float amplitude) { amplitude_ = amplitude; }
+
+    double frequency() const { return double(int64_t(freq_)) / (4294967296.0 * 4294967296.0) * sampleRate_; }
+    uint32_t phase() const { return phase_; }
+
+    // write n samples, or add them to what is in out already
+    void generate(std::complex<float> *out, size_t n, bool accumulate = false)
+    {
+        const float fracScale = float(2 * M_PI / 4294967296.0);
+        const uint32_t fracMask = (1u << (32 - NCO_TABLE_BITS)) - 1;
+        uint32_t phase = phase_;
+        uint64_t freq = freq_;
+        float *o = reinterpret_cast<float *>(out);
+        for (size_t i = 0; i < n; ++i) {
+            const std::complex<float> t = table_[phase >> (32 - NCO_TABLE_BITS)];
+            float d = float(phase & fracMask) * fracScale;
+            float re = amplitude_ * (t.real() - t.imag() * d);
+            float im = amplitude_ * (t.imag() + t.real() * d);
+            if (accumulate) {
+                o[2 * i] += re;
+                o[2 * i + 1] += im;
+            } else {
+                o[2 * i] = re;
+                o[2 * i + 1] = im;
+            }
+            phase += uint32_t(freq >> 32);
+            freq += sweep_;
+        }
+        phase_ = phase;
+        freq_ = freq;
+    }
+
+private:
+    double sampleRate_;
+    float amplitude_;
+    const std::complex<float> *table_;
+    uint32_t phase_ = 0;
+    uint64_t freq_ = 0;                  // Q32.32 cycles per sample, wraps like the phase
+    uint64_t sweep_ = 0;                 // added to freq_ every sample
+};
+
+enum WaveformKind {
+    WAVE_TONE,
+    WAVE_MULTITONE,
+    WAVE_CHIRP,                          // f0 -> f1 over one period, then again
+    WAVE_STEPPED,                        // f0, f0 + step, ... for dwell samples each
+};
+
+class WaveformGenerator {
+public:
+    explicit WaveformGenerator(double sampleRate, size_t bufferSamples = 0)
+        : sampleRate_(sampleRate), buffer_(bufferSamples) {}
+
+    void setTone(double hz, float amplitude = 1.0f)
+    {
+        reset(WAVE_TONE, 1);
+        ncos_[0] = Nco(hz, sampleRate_, amplitude);
+    }
+
+    // tones summed with their own amplitudes and start phases (radians),
+    // the caller keeps the sum inside full scale
+    void setMultitone(const std::vector<double> &hz, const std::vector<float> &amplitudes,
+                      const std::vector<double> &phases = {})
+    {
+        reset(WAVE_MULTITONE, hz.size());
+        for (size_t k = 0; k < hz.size(); ++k)
+            ncos_[k] = Nco(hz[k], sampleRate_, amplitudes[k], k < phases.size() ? phases[k] : 0);
+    }
+
+    void setChirp(double f0, double f1, double seconds, float amplitude = 1.0f)
+    {
+        reset(WAVE_CHIRP, 1);
+        f0_ = f0;
+        segment_ = std::max<uint64_t>(1, uint64_t(std::llround(seconds * sampleRate_)));
+        ncos_[0] = Nco(f0, sampleRate_, amplitude);
+        ncos_[0].setSweepRate((f1 - f0) / seconds);
+    }
+
+    void setStepped(double f0, double stepHz, uint32_t steps, uint32_t dwellSamples, float amplitude = 1.0f)
+    {
+        reset(WAVE_STEPPED, 1);
+        f0_ = f0;
+        stepHz_ = stepHz;
+        steps_ = std::max<uint32_t>(1, steps);
+        segment_ = std::max<uint32_t>(1, dwellSamples);
+        ncos_[0] = Nco(f0, sampleRate_, amplitude);
+    }
+
+    // next n samples of the waveform, phase continuous with the previous call
+    void fill(std::complex<float> *out, size_t n)
+    {
+        size_t done = 0;
+        while (done < n) {
+            size_t k = n - done;
+            if (segment_) k = size_t(std::min<uint64_t>(k, segment_ - inSegment_));
+            for (size_t t = 0; t < ncos_.size(); ++t)
+                ncos_[t].generate(out + done, k, t > 0);
+            done += k;
+            total_ += k;
+            inSegment_ += k;
+            if (segment_ && inSegment_ == segment_) nextSegment();
+        }
+    }
+
+    // fill the generator's own buffer, allocated at construction or on the
+    // first call that needs more room
+    const std::complex<float> *next(size_t n)
+    {
+        if (buffer_.size() < n) buffer_.resize(n);
+        fill(buffer_.data(), n);
+        return buffer_.data();
+    }
+
+    WaveformKind kind() const { return kind_; }
+    uint64_t samples() const { return total_; }
+
+private:
+    void reset(WaveformKind kind, size_t tones)
+    {
+        kind_ = kind;
+        ncos_.assign(tones, Nco());
+        segment_ = 0;
+        inSegment_ = 0;
+        step_ = 0;
+    }
+
+    // chirp wraps back to f0, stepped moves on a step; the phase carries on
+    void nextSegment()
+    {
+        inSegment_ = 0;
+        if (kind_ == WAVE_CHIRP) {
+            ncos_[0].setFrequency(f0_);
+        } else if (kind_ == WAVE_STEPPED) {
+            step_ = (step_ + 1) % steps_;
+            ncos_[0].setFrequency(f0_ + step_ * stepHz_);
+        }
+    }
+
+    double sampleRate_;
+    WaveformKind kind_ = WAVE_TONE;
+    std::vector<Nco> ncos_;
+    std::vector<std::complex<float>> buffer_;
+    double f0_ = 0;
+    double stepHz_ = 0;
+    uint32_t steps_ = 1;
+    uint32_t step_ = 0;
+    uint64_t segment_ = 0;               // samples per chirp / step, 0 for none
+    uint64_t inSegment_ = 0;
+    uint64_t total_ = 0;
+};